@@ -313,7 +313,10 @@ SeraP Acd1Chart::sera() const
 
 TitersP Acd1Chart::titers() const
 {
-    return std::make_shared<Acd1Titers>(data_.get("table", "titers"), data_.get("table", "antigens").size(), data_.get("table", "sera").size());
+    std::lock_guard<std::mutex> lock{titers_access_};
+    if (!titers_)
+        titers_ = std::make_shared<Acd1Titers>(data_.get("table", "titers"), data_.get("table", "antigens").size(), data_.get("table", "sera").size());
+    return titers_;
 
 } // Acd1Chart::titers
 
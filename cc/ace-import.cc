@@ -122,7 +122,10 @@ const rjson::value& AceChart::extension_fields() const
 
 TitersP AceChart::titers() const
 {
-    return std::make_shared<AceTiters>(data_.get("c", "t"), data_.get("c", "a").size(), data_.get("c", "s").size());
+    std::lock_guard<std::mutex> lock{titers_access_};
+    if (!titers_)
+        titers_ = std::make_shared<AceTiters>(data_.get("c", "t"), data_.get("c", "a").size(), data_.get("c", "s").size());
+    return titers_;
 
 } // AceChart::titers
 
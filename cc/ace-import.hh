@@ -38,6 +38,8 @@ namespace acmacs::chart
         rjson::value data_;
         mutable ace::name_index_t mAntigenNameIndex;
         mutable ProjectionsP projections_;
+        mutable TitersP titers_; // kept to reuse Titers::encoded() cache
+        mutable std::mutex titers_access_;
 
     }; // class AceChart
 
@@ -98,7 +98,7 @@ void alglib::lbfgs_optimize(acmacs::chart::optimization_status& status, acmacs::
         minlbfgscreate(1, x, state);
         minlbfgssetcond(state, epsg, epsf, epsx, max_iterations);
         minlbfgssetstpmax(state, stpmax);
-        minlbfgssetxrep(state, callback_data.intermediate_layouts != nullptr);
+        minlbfgssetxrep(state, callback_data.report_iterations());
         minlbfgsoptimize(state, &lbfgs_optimize_grad, &lbfgs_optimize_step, reinterpret_cast<void*>(&callback_data));
         minlbfgsreport rep;
         minlbfgsresultsbuf(state, x, rep);
@@ -125,6 +125,7 @@ void alglib::lbfgs_optimize_grad(const alglib::real_1d_array& x, double& func, a
 {
     auto* callback_data = reinterpret_cast<acmacs::chart::OptimiserCallbackData*>(ptr);
     func = callback_data->stress.value_gradient(x.getcontent(), x.getcontent() + x.length(), grad.getcontent());
+    callback_data->set_gradient_norm(grad.getcontent(), static_cast<size_t>(grad.length()));
       //std::cout << "grad " << ++called << ' ' << func << '\n';
 
       // terminate optimization (need to pass state in ptr)
@@ -137,7 +138,7 @@ void alglib::lbfgs_optimize_grad(const alglib::real_1d_array& x, double& func, a
 void alglib::lbfgs_optimize_step(const alglib::real_1d_array& x, double func, void* ptr) // callback at each iteration
 {
     auto* callback_data = reinterpret_cast<acmacs::chart::OptimiserCallbackData*>(ptr);
-    callback_data->intermediate_layouts->emplace_back(callback_data->stress.number_of_dimensions(), x.getcontent(), x.length(), func);
+    callback_data->iteration_done(x.getcontent(), static_cast<size_t>(x.length()), func);
 
 } // alglib::lbfgs_optimize_step
 
@@ -157,7 +158,7 @@ void alglib::cg_optimize(acmacs::chart::optimization_status& status, acmacs::cha
         mincgstate state;
         mincgcreate(x, state);
         mincgsetcond(state, epsg, epsf, epsx, max_iterations);
-        mincgsetxrep(state, callback_data.intermediate_layouts != nullptr);
+        mincgsetxrep(state, callback_data.report_iterations());
         mincgoptimize(state, &lbfgs_optimize_grad, &lbfgs_optimize_step, reinterpret_cast<void*>(&callback_data));
         mincgreport rep;
         mincgresultsbuf(state, x, rep);
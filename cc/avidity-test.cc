@@ -1,34 +1,177 @@
+#include <numeric>
+#include <optional>
+
 #include "acmacs-base/range-v3.hh"
+#include "acmacs-base/enumerate.hh"
+#include "acmacs-base/omp.hh"
 #include "acmacs-chart-2/avidity-test.hh"
 #include "acmacs-chart-2/chart-modify.hh"
 #include "acmacs-chart-2/optimize.hh"
 #include "acmacs-chart-2/procrustes.hh"
+#include "acmacs-chart-2/stress.hh"
+
+// ----------------------------------------------------------------------
+
+namespace acmacs::chart::avidity::internal
+{
+    // low avidity first, then high avidity
+    static inline std::vector<double> logged_adjusts(const Settings& settings)
+    {
+        std::vector<double> adjusts;
+        for (double adjust = settings.step; adjust <= settings.max_adjust; adjust += settings.step)
+            adjusts.push_back(adjust);
+        for (double adjust = - settings.step; adjust >= settings.min_adjust; adjust -= settings.step)
+            adjusts.push_back(adjust);
+        return adjusts;
+    }
+
+    // Stress of the original projection and, for each antigen, positions of its entries in the table distances.
+    // Changing avidity adjust of one antigen changes just its table distances, they are patched in a copy of the base stress
+    // instead of making stress for a projection clone (stress_factory goes through the whole titer table).
+    class AdjustedStress
+    {
+      public:
+        AdjustedStress(const ChartModify& chart, const ProjectionModify& original_projection, multiply_antigen_titer_until_column_adjust mult);
+
+        const Stress& base() const { return base_; }
+        // stress must be a copy of base(), entries of other antigens are not touched
+        void patch(Stress& stress, size_t antigen_no, double logged_adjust) const;
+        void restore(Stress& stress, size_t antigen_no) const;
+
+      private:
+        struct entry_ref_t
+        {
+            bool less_than;
+            size_t index;
+            double distance_without_antigen_adjust; // column basis - logged titer - serum adjust
+        };
+
+        Stress base_;
+        std::vector<std::vector<entry_ref_t>> entries_; // per antigen
+
+        TableDistances::entries_t& entries(Stress& stress, bool less_than) const { return less_than ? stress.table_distances_modify().less_than() : stress.table_distances_modify().regular(); }
+        const TableDistances::entries_t& base_entries(bool less_than) const { return less_than ? base_.table_distances().less_than() : base_.table_distances().regular(); }
+    };
+
+    // avidity test summary for the layout optimized with the antigen adjust
+    static PerAdjust make_per_adjust(const ChartModify& chart, const ProjectionModify& original_projection, double original_stress, const std::vector<CommonAntigensSera::common_t>& common,
+                                     size_t antigen_no, double logged_adjust, double final_stress, const acmacs::Layout& layout);
+
+    // every (antigen, adjust) pair is a separate job, jobs are run in parallel, results are stored in the order of antigens_to_test and logged_adjusts()
+    static Results test(ChartModify& chart, size_t projection_no, const std::vector<size_t>& antigens_to_test, const Settings& settings, const optimization_options& options);
+
+} // namespace acmacs::chart::avidity::internal
+
+// ----------------------------------------------------------------------
+
+acmacs::chart::avidity::internal::AdjustedStress::AdjustedStress(const ChartModify& chart, const ProjectionModify& original_projection, multiply_antigen_titer_until_column_adjust mult)
+    : base_{stress_factory(original_projection, mult)}, entries_(chart.number_of_antigens())
+{
+    auto column_bases = original_projection.forced_column_bases();
+    if (!column_bases)
+        column_bases = chart.column_bases(original_projection.minimum_column_basis());
+    auto titers = chart.titers();
+    const auto number_of_antigens = chart.number_of_antigens();
+    const auto point_adjusts = base_.parameters().avidity_adjusts.logged(chart.number_of_points());
+
+    const auto collect = [&](bool less_than) {
+        for (const auto [index, entry] : acmacs::enumerate(base_entries(less_than))) {
+            // Titers::update puts antigen into point_1
+            const auto serum_no = entry.point_2 - number_of_antigens;
+            entries_[entry.point_1].push_back(
+                entry_ref_t{less_than, index, column_bases->column_basis(serum_no) - titers->titer(entry.point_1, serum_no).logged() - point_adjusts[entry.point_2]});
+        }
+    };
+    collect(false);
+    collect(true);
+
+} // acmacs::chart::avidity::internal::AdjustedStress::AdjustedStress
+
+// ----------------------------------------------------------------------
+
+void acmacs::chart::avidity::internal::AdjustedStress::patch(Stress& stress, size_t antigen_no, double logged_adjust) const
+{
+    const auto mult = base_.parameters().mult;
+    for (const auto& ref : entries_[antigen_no]) {
+        auto distance = ref.distance_without_antigen_adjust - logged_adjust;
+        if (distance < 0 && mult == multiply_antigen_titer_until_column_adjust::yes) // see TableDistances::update()
+            distance = 0;
+        entries(stress, ref.less_than)[ref.index].distance = distance;
+    }
+
+} // acmacs::chart::avidity::internal::AdjustedStress::patch
+
+// ----------------------------------------------------------------------
+
+void acmacs::chart::avidity::internal::AdjustedStress::restore(Stress& stress, size_t antigen_no) const
+{
+    for (const auto& ref : entries_[antigen_no])
+        entries(stress, ref.less_than)[ref.index].distance = base_entries(ref.less_than)[ref.index].distance;
+
+} // acmacs::chart::avidity::internal::AdjustedStress::restore
 
 // ----------------------------------------------------------------------
 
 acmacs::chart::avidity::Results acmacs::chart::avidity::test(ChartModify& chart, size_t projection_no, const Settings& settings, const optimization_options& options)
 {
-    auto projection = chart.projection_modify(projection_no);
-    Results results{.original_stress = projection->stress()};
-    for (size_t ag_no{0}; ag_no < chart.number_of_antigens(); ++ag_no)
-        results.results.push_back(test(chart, *projection, ag_no, settings, options));
-    results.post_process();
-    return results;
+    std::vector<size_t> antigens_to_test(chart.number_of_antigens());
+    std::iota(antigens_to_test.begin(), antigens_to_test.end(), 0UL);
+    return internal::test(chart, projection_no, antigens_to_test, settings, options);
 
 } // acmacs::chart::avidity::test
 
 // ----------------------------------------------------------------------
 
 acmacs::chart::avidity::Results acmacs::chart::avidity::test(ChartModify& chart, size_t projection_no, const std::vector<size_t>& antigens_to_test, const Settings& settings, const optimization_options& options)
+{
+    return internal::test(chart, projection_no, antigens_to_test, settings, options);
+
+} // acmacs::chart::avidity::test
+
+// ----------------------------------------------------------------------
+
+acmacs::chart::avidity::Results acmacs::chart::avidity::internal::test(ChartModify& chart, size_t projection_no, const std::vector<size_t>& antigens_to_test, const Settings& settings, const optimization_options& options)
 {
     auto projection = chart.projection_modify(projection_no);
+    // values cached by chart and projection are calculated before parallel jobs start
     Results results{.original_stress = projection->stress()};
-    for (size_t ag_no : antigens_to_test)
-        results.results.push_back(test(chart, *projection, ag_no, settings, options));
+    const auto original_layout = projection->layout();
+    projection->transformed_layout();
+    const auto common = CommonAntigensSera{chart}.points();
+    const AdjustedStress adjusted_stress{chart, *projection, options.mult};
+
+    const auto adjusts = logged_adjusts(settings);
+    std::vector<std::optional<PerAdjust>> per_adjust(antigens_to_test.size() * adjusts.size());
+
+#ifdef _OPENMP
+    const int num_threads = settings.threads == 0 ? omp_get_max_threads() : static_cast<int>(settings.threads);
+#endif
+#pragma omp parallel default(shared) num_threads(num_threads)
+    {
+        // per thread scratch, no projections are cloned
+        Stress stress{adjusted_stress.base()};
+        acmacs::Layout layout{*original_layout};
+#pragma omp for schedule(dynamic, 1)
+        for (size_t job_no = 0; job_no < per_adjust.size(); ++job_no) {
+            const auto antigen_no = antigens_to_test[job_no / adjusts.size()];
+            const auto logged_adjust = adjusts[job_no % adjusts.size()];
+            adjusted_stress.patch(stress, antigen_no, logged_adjust);
+            std::copy(original_layout->data(), original_layout->data() + original_layout->size(), layout.data());
+            const auto status = optimize(options.method, stress, layout.data(), layout.data() + layout.size(), options.precision);
+            per_adjust[job_no] = make_per_adjust(chart, *projection, results.original_stress, common, antigen_no, logged_adjust, status.final_stress, layout);
+            adjusted_stress.restore(stress, antigen_no);
+        }
+    }
+
+    for (size_t index{0}; index < antigens_to_test.size(); ++index) {
+        auto& result = results.results.emplace_back(Result{.antigen_no = antigens_to_test[index], .best_logged_adjust = 0.0, .original = original_layout->at(antigens_to_test[index])});
+        for (size_t adjust_no{0}; adjust_no < adjusts.size(); ++adjust_no)
+            result.adjusts.push_back(std::move(*per_adjust[index * adjusts.size() + adjust_no]));
+    }
     results.post_process();
     return results;
 
-} // acmacs::chart::avidity::test
+} // acmacs::chart::avidity::internal::test
 
 // ----------------------------------------------------------------------
 
@@ -36,13 +179,18 @@ acmacs::chart::avidity::Result acmacs::chart::avidity::test(ChartModify& chart,
                                                             const optimization_options& options)
 {
     Result result{.antigen_no = antigen_no, .best_logged_adjust = 0.0, .original = original_projection.layout()->at(antigen_no)};
-    // low avidity
-    for (double adjust = settings.step; adjust <= settings.max_adjust; adjust += settings.step)
-        result.adjusts.push_back(test(chart, original_projection, antigen_no, adjust, options));
-    // high avidity
-    for (double adjust = - settings.step; adjust >= settings.min_adjust; adjust -= settings.step)
-        result.adjusts.push_back(test(chart, original_projection, antigen_no, adjust, options));
-
+    const auto original_stress = original_projection.stress();
+    const auto common = CommonAntigensSera{chart}.points();
+    const internal::AdjustedStress adjusted_stress{chart, original_projection, options.mult};
+    Stress stress{adjusted_stress.base()};
+    const auto original_layout = original_projection.layout();
+    acmacs::Layout layout{*original_layout};
+    for (const auto adjust : internal::logged_adjusts(settings)) {
+        adjusted_stress.patch(stress, antigen_no, adjust);
+        std::copy(original_layout->data(), original_layout->data() + original_layout->size(), layout.data());
+        const auto status = optimize(options.method, stress, layout.data(), layout.data() + layout.size(), options.precision);
+        result.adjusts.push_back(internal::make_per_adjust(chart, original_projection, original_stress, common, antigen_no, adjust, status.final_stress, layout));
+    }
     return result;
 
 } // acmacs::chart::avidity::test
@@ -51,19 +199,26 @@ acmacs::chart::avidity::Result acmacs::chart::avidity::test(ChartModify& chart,
 
 acmacs::chart::avidity::PerAdjust acmacs::chart::avidity::test(ChartModify& chart, const ProjectionModify& original_projection, size_t antigen_no, double logged_adjust, const optimization_options& options, bool add_new_projection_to_chart)
 {
-    const auto original_stress = original_projection.stress();
     auto projection = chart.projections_modify().new_by_cloning(original_projection, add_new_projection_to_chart);
     auto& avidity_adjusts = projection->avidity_adjusts_modify();
     avidity_adjusts.resize(chart.number_of_antigens() + chart.number_of_sera());
     avidity_adjusts.set_logged(antigen_no, logged_adjust);
     projection->comment(fmt::format("avidity {:+.1f} AG {}", logged_adjust, antigen_no));
     auto stress = stress_factory(*projection, options.mult);
-    // auto stress = stress_factory(*projection, antigen_no, logged_adjust, options.mult);
     auto layout = projection->layout_modified();
     const auto status = optimize(options.method, stress, layout->data(), layout->data() + layout->size(), options.precision);
     // AD_DEBUG("avidity relax AG {} adjust:{:4.1f} stress: {:10.4f} diff: {:8.4f}", antigen_no, logged_adjust, status.final_stress, status.final_stress - original_stress);
+    return internal::make_per_adjust(chart, original_projection, original_projection.stress(), CommonAntigensSera{chart}.points(), antigen_no, logged_adjust, status.final_stress, *layout);
 
-    const auto pc_data = procrustes(original_projection, *projection, CommonAntigensSera{chart}.points(), procrustes_scaling_t::no);
+} // acmacs::chart::avidity::test
+
+// ----------------------------------------------------------------------
+
+acmacs::chart::avidity::PerAdjust acmacs::chart::avidity::internal::make_per_adjust(const ChartModify& chart, const ProjectionModify& original_projection, double original_stress,
+                                                                                    const std::vector<CommonAntigensSera::common_t>& common, size_t antigen_no, double logged_adjust,
+                                                                                    double final_stress, const acmacs::Layout& layout)
+{
+    const auto pc_data = procrustes(original_projection, layout, common, procrustes_scaling_t::no);
     // AD_DEBUG("AG {} pc-rms:{}", antigen_no, pc_data.rms);
     const auto summary = procrustes_summary(*original_projection.layout(), *pc_data.secondary_transformed,
                                             ProcrustesSummaryParameters{.number_of_antigens = chart.number_of_antigens(), .antigen_being_tested = antigen_no});
@@ -72,8 +227,8 @@ acmacs::chart::avidity::PerAdjust acmacs::chart::avidity::test(ChartModify& char
                      .distance_test_antigen = summary.antigen_distances[antigen_no],
                      .angle_test_antigen = summary.test_antigen_angle,
                      .average_procrustes_distances_except_test_antigen = summary.average_distance,
-                     .final_coordinates = layout->at(antigen_no),
-                     .stress_diff = status.final_stress - original_stress};
+                     .final_coordinates = layout.at(antigen_no),
+                     .stress_diff = final_stress - original_stress};
     size_t most_moved_no{0};
     for (const auto ag_no : summary.antigens_by_distance) {
         if (ag_no != antigen_no) { // do not put antigen being tested into the most moved list
@@ -89,7 +244,7 @@ acmacs::chart::avidity::PerAdjust acmacs::chart::avidity::test(ChartModify& char
     // }
     return result;
 
-} // acmacs::chart::avidity::test
+} // acmacs::chart::avidity::internal::make_per_adjust
 
 // ----------------------------------------------------------------------
 
@@ -129,6 +284,22 @@ void acmacs::chart::avidity::Results::post_process()
 
 // ----------------------------------------------------------------------
 
+size_t acmacs::chart::avidity::add_best_adjust_projections(ChartModify& chart, size_t projection_no, const Results& avidity_results, const optimization_options& options)
+{
+    auto original_projection = chart.projection_modify(projection_no);
+    size_t added{0};
+    for (const auto& result : avidity_results.results) {
+        if (!float_zero(result.best_logged_adjust)) {
+            test(chart, *original_projection, result.antigen_no, result.best_logged_adjust, options, true);
+            ++added;
+        }
+    }
+    return added;
+
+} // acmacs::chart::avidity::add_best_adjust_projections
+
+// ----------------------------------------------------------------------
+
 std::shared_ptr<acmacs::chart::ProjectionModify> acmacs::chart::avidity::move_antigens(ChartModify& chart, size_t projection_no, const Results& avidity_results)
 {
     auto projection = chart.projections_modify().new_by_cloning(*chart.projection_modify(projection_no));
@@ -77,6 +77,10 @@ namespace acmacs::chart
         // test some antigens
         Results test(ChartModify& chart, size_t projection_no, const std::vector<size_t>& antigens_to_test, const Settings& settings, const optimization_options& options);
 
+        // test() does not add projections to the chart, this adds a projection for the best adjust of each antigen that has it (antigen is re-optimized with that adjust)
+        // returns number of projections added
+        size_t add_best_adjust_projections(ChartModify& chart, size_t projection_no, const Results& avidity_results, const optimization_options& options);
+
         // adds new projection with antigens moved to their better positions and avidity data changed
         // returns new projection
         std::shared_ptr<ProjectionModify> move_antigens(ChartModify& chart, size_t projection_no, const Results& avidity_results);
@@ -0,0 +1,187 @@
+#include <random>
+#include <mutex>
+#include <cmath>
+#include <numeric>
+#include <algorithm>
+
+#include "acmacs-base/omp.hh"
+#include "acmacs-chart-2/basin-hopping.hh"
+#include "acmacs-chart-2/chart-modify.hh"
+#include "acmacs-chart-2/stress.hh"
+#include "acmacs-chart-2/log.hh"
+
+// ----------------------------------------------------------------------
+
+namespace acmacs::chart::basin_hopping_internal
+{
+    // moves points of a map cluster: seed point and its nearest movable neighbours, each point by a random vector within perturbation_radius
+    class Perturber
+    {
+      public:
+        Perturber(const Stress& stress, const basin_hopping_options& bh_options, const std::vector<size_t>& movable, const std::vector<bool>& movable_in_the_last_dimension)
+            : stress_{stress}, options_{bh_options}, movable_{movable}, movable_in_the_last_dimension_{movable_in_the_last_dimension}, num_dim_{static_cast<size_t>(stress.number_of_dimensions())}
+        {
+        }
+
+        void operator()(std::vector<double>& layout, size_t hop_no, std::mt19937& generator) const
+        {
+            const auto seed_point = select_seed_point(layout, hop_no, generator);
+            const auto* seed_coordinates = layout.data() + seed_point * num_dim_;
+            std::vector<std::pair<double, size_t>> by_distance(movable_.size());
+            std::transform(movable_.begin(), movable_.end(), by_distance.begin(), [&layout, seed_coordinates, this](size_t point_no) {
+                double dist{0};
+                for (size_t dim = 0; dim < num_dim_; ++dim)
+                    dist += (layout[point_no * num_dim_ + dim] - seed_coordinates[dim]) * (layout[point_no * num_dim_ + dim] - seed_coordinates[dim]);
+                return std::pair{dist, point_no};
+            });
+            const auto cluster_size = std::min(std::max(options_.points_to_perturb, 1UL), by_distance.size());
+            std::nth_element(by_distance.begin(), by_distance.begin() + static_cast<long>(cluster_size) - 1, by_distance.end());
+
+            std::normal_distribution<double> direction_distribution;
+            std::uniform_real_distribution<double> radius_distribution{0.0, 1.0};
+            std::vector<double> direction(num_dim_);
+            for (auto cluster_point = by_distance.begin(); cluster_point != by_distance.begin() + static_cast<long>(cluster_size); ++cluster_point) {
+                const auto point_no = cluster_point->second;
+                const auto dims = movable_in_the_last_dimension_[point_no] ? num_dim_ : (num_dim_ - 1);
+                std::generate_n(direction.begin(), dims, [&]() { return direction_distribution(generator); });
+                const auto norm = std::sqrt(std::inner_product(direction.begin(), direction.begin() + static_cast<long>(dims), direction.begin(), 0.0));
+                if (norm <= 0.0)
+                    continue;
+                // uniform within ball of perturbation_radius
+                const auto scale = options_.perturbation_radius * std::pow(radius_distribution(generator), 1.0 / static_cast<double>(dims)) / norm;
+                for (size_t dim = 0; dim < dims; ++dim)
+                    layout[point_no * num_dim_ + dim] += direction[dim] * scale;
+            }
+        }
+
+      private:
+        const Stress& stress_;
+        const basin_hopping_options& options_;
+        const std::vector<size_t>& movable_;
+        const std::vector<bool>& movable_in_the_last_dimension_;
+        const size_t num_dim_;
+
+        size_t select_seed_point(const std::vector<double>& layout, size_t hop_no, std::mt19937& generator) const
+        {
+            const bool worst = options_.perturbation == basin_hopping_perturbation::worst_contribution || (options_.perturbation == basin_hopping_perturbation::mixed && (hop_no % 2) == 0);
+            if (worst) {
+                const auto contributions = stress_.contributions(layout.data());
+                std::vector<size_t> candidates(movable_);
+                const auto top = std::min(std::max(options_.worst_points, 1UL), candidates.size());
+                std::partial_sort(candidates.begin(), candidates.begin() + static_cast<long>(top), candidates.end(), [&contributions](size_t p1, size_t p2) { return contributions[p1] > contributions[p2]; });
+                return candidates[std::uniform_int_distribution<size_t>{0, top - 1}(generator)];
+            }
+            else
+                return movable_[std::uniform_int_distribution<size_t>{0, movable_.size() - 1}(generator)];
+        }
+    };
+
+} // namespace acmacs::chart::basin_hopping_internal
+
+// ----------------------------------------------------------------------
+
+acmacs::chart::basin_hopping_status acmacs::chart::basin_hopping(ProjectionModify& projection, const optimization_options& options, const basin_hopping_options& bh_options)
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+    auto layout = projection.layout_modified();
+    const auto stress = stress_factory(projection, options.mult);
+    const auto num_dim = static_cast<size_t>(stress.number_of_dimensions());
+    const auto number_of_points = layout->number_of_points();
+
+    std::vector<double> global_best(layout->data(), layout->data() + layout->size());
+    stress.set_coordinates_of_disconnected(global_best.data(), global_best.size(), 0.0, stress.number_of_dimensions());
+
+    std::vector<bool> movable_flag(number_of_points, true), movable_in_the_last_dimension(number_of_points, true);
+    for (const auto p_no : stress.parameters().unmovable)
+        movable_flag[p_no] = false;
+    for (const auto p_no : stress.parameters().disconnected)
+        movable_flag[p_no] = false;
+    for (const auto p_no : stress.parameters().unmovable_in_the_last_dimension)
+        movable_in_the_last_dimension[p_no] = false;
+    std::vector<size_t> movable;
+    for (size_t point_no = 0; point_no < number_of_points; ++point_no) {
+        if (movable_flag[point_no] && std::isfinite(global_best[point_no * num_dim]))
+            movable.push_back(point_no);
+    }
+
+    basin_hopping_status status;
+    status.initial_stress = status.final_stress = stress.value(global_best.data());
+    if (movable.size() < 2) {
+        AD_WARNING("basin hopping: too few movable points: {}", movable.size());
+        return status;
+    }
+
+#ifdef _OPENMP
+    const int num_threads = bh_options.threads <= 0 ? omp_get_max_threads() : bh_options.threads;
+#else
+    const int num_threads = 1;
+#endif
+    const size_t chains = bh_options.chains > 0 ? bh_options.chains : static_cast<size_t>(num_threads);
+    const auto base_seed = bh_options.seed ? *bh_options.seed : std::random_device{}();
+    const basin_hopping_internal::Perturber perturb{stress, bh_options, movable, movable_in_the_last_dimension};
+    double global_best_stress = status.initial_stress;
+    std::mutex global_best_access;
+
+#pragma omp parallel for default(shared) num_threads(num_threads) schedule(static, 1)
+    for (size_t chain_no = 0; chain_no < chains; ++chain_no) {
+        std::mt19937 generator{static_cast<std::mt19937::result_type>(base_seed + chain_no)};
+        std::uniform_real_distribution<double> acceptance_distribution{0.0, 1.0};
+        std::vector<double> current, candidate;
+        double current_stress;
+        {
+            std::lock_guard<std::mutex> lock{global_best_access};
+            current = global_best;
+            current_stress = global_best_stress;
+        }
+        size_t accepted{0}, improved{0}, rejected_in_row{0};
+        for (size_t hop_no = 0; hop_no < bh_options.hops; ++hop_no) {
+            candidate = current;
+            perturb(candidate, hop_no + chain_no, generator);
+            const auto hop_status = acmacs::chart::optimize(options.method, stress, candidate.data(), candidate.data() + candidate.size(), bh_options.hop_precision);
+            const auto candidate_stress = hop_status.final_stress;
+            if (std::isnan(candidate_stress)) {
+                ++rejected_in_row;
+                continue;
+            }
+            if (candidate_stress < current_stress || (bh_options.temperature > 0.0 && acceptance_distribution(generator) < std::exp((current_stress - candidate_stress) / bh_options.temperature))) {
+                current.swap(candidate);
+                current_stress = candidate_stress;
+                ++accepted;
+                rejected_in_row = 0;
+            }
+            else
+                ++rejected_in_row;
+
+            std::lock_guard<std::mutex> lock{global_best_access};
+            if (current_stress < global_best_stress) {
+                global_best = current;
+                global_best_stress = current_stress;
+                ++improved;
+                AD_LOG(acmacs::log::relax, "basin hopping chain {} hop {}: {:.6f}", chain_no, hop_no, global_best_stress);
+            }
+            else if (rejected_in_row >= bh_options.restart_after && global_best_stress < current_stress) {
+                // restart chain from the best layout found by all chains
+                current = global_best;
+                current_stress = global_best_stress;
+                rejected_in_row = 0;
+            }
+        }
+        std::lock_guard<std::mutex> lock{global_best_access};
+        status.hops += bh_options.hops;
+        status.accepted += accepted;
+        status.improved += improved;
+    }
+
+    if (global_best_stress < status.initial_stress) {
+        std::copy(global_best.begin(), global_best.end(), layout->data());
+        status.final_stress = projection.relax(options).final_stress; // polish with the requested precision, disconnected points get NaN coordinates back
+    }
+    status.time = std::chrono::duration_cast<decltype(status.time)>(std::chrono::high_resolution_clock::now() - start);
+    return status;
+
+} // acmacs::chart::basin_hopping
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "acmacs-chart-2/optimize.hh"
+#include "acmacs-chart-2/randomizer.hh"
+
+// ----------------------------------------------------------------------
+
+namespace acmacs::chart
+{
+    class ProjectionModify;
+
+    enum class basin_hopping_perturbation {
+        worst_contribution, // cluster around one of the points having the highest stress contribution
+        random_cluster,     // cluster around a random point
+        mixed               // alternate the above
+    };
+
+    struct basin_hopping_options
+    {
+        size_t chains{0};                                                // number of parallel chains, 0 - number of threads
+        size_t hops{100};                                                // per chain
+        size_t points_to_perturb{5};                                     // cluster size: seed point and its nearest (in the map) neighbours
+        double perturbation_radius{1.0};                                 // max displacement of a perturbed point, in map units
+        size_t worst_points{20};                                         // for worst_contribution: seed is chosen among this number of points with the highest contribution
+        basin_hopping_perturbation perturbation{basin_hopping_perturbation::mixed};
+        optimization_precision hop_precision{optimization_precision::rough}; // re-optimization budget after each hop
+        double temperature{0.0};                                         // Metropolis acceptance of worse layouts, 0 - accept improvements only
+        size_t restart_after{10};                                        // chain restarts from the global best after this number of consecutive rejected hops
+        LayoutRandomizer::seed_t seed{};                                 // chain_no is added to seed, random if not set
+        int threads{0};                                                  // 0 - autodetect
+    };
+
+    struct basin_hopping_status
+    {
+        double initial_stress{0.0};
+        double final_stress{0.0};
+        size_t hops{0};
+        size_t accepted{0};
+        size_t improved{0}; // number of times the global best was improved
+        std::chrono::microseconds time{0};
+    };
+
+    // perturbs subsets of points of the current layout in several chains sharing the global best,
+    // re-optimizes each perturbed layout with hop_precision and accepts or rejects it by stress.
+    // Global best layout is relaxed with options.precision and stored into the projection if it is better than the original one.
+    basin_hopping_status basin_hopping(ProjectionModify& projection, const optimization_options& options, const basin_hopping_options& bh_options);
+
+} // namespace acmacs::chart
+
+// ----------------------------------------------------------------------
+
+template <> struct fmt::formatter<acmacs::chart::basin_hopping_status> : fmt::formatter<acmacs::fmt_helper::default_formatter> {
+    template <typename FormatCtx> auto format(const acmacs::chart::basin_hopping_status& status, FormatCtx& ctx)
+    {
+        return fmt::format_to(ctx.out(), "basin hopping {:.12f} <- {:.12f}\n time: {}\n hops: {}\n accepted: {}\n improved: {}", status.final_stress, status.initial_stress, status.time,
+                              status.hops, status.accepted, status.improved);
+    }
+};
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -2,7 +2,7 @@
 #include "acmacs-base/string.hh"
 #include "acmacs-base/timeit.hh"
 #include "acmacs-chart-2/factory-import.hh"
-// #include "acmacs-chart-2/factory-export.hh"
+#include "acmacs-chart-2/factory-export.hh"
 #include "acmacs-chart-2/avidity-test.hh"
 #include "acmacs-chart-2/chart-modify.hh"
 #include "acmacs-chart-2/optimize.hh"
@@ -22,12 +22,13 @@ struct Options : public argv
     option<double> max_adjust{*this, "max-adjust", dflt{6.0}};
     option<size_t> projection{*this, "projection", dflt{0ul}};
     option<bool>   rough{*this, "rough"};
-    option<str>    method{*this, "method", dflt{"alglib-cg"}, desc{"method: alglib-lbfgs, alglib-cg, optim-bfgs, optim-differential-evolution"}};
+    option<str>    method{*this, "method", dflt{"alglib-cg"}, desc{"method: alglib-lbfgs, alglib-cg, sgd-adam, newton-block, optim-bfgs, optim-differential-evolution"}};
+    option<size_t> threads{*this, "threads", dflt{0ul}, desc{"number of threads to use for (antigen, adjust) jobs (omp): 0 - autodetect, 1 - sequential"}};
 
     option<str_array> verbose{*this, 'v', "verbose", desc{"comma separated list (or multiple switches) of enablers"}};
 
     argument<str>  source_chart{*this, arg_name{"source-chart"}, mandatory};
-    // argument<str>  output_chart{*this, arg_name{"output-chart"}};
+    argument<str>  output_chart{*this, arg_name{"output-chart"}, desc{"chart with projections for the best adjust of each antigen"}};
 };
 
 int main(int argc, char* const argv[])
@@ -50,10 +51,13 @@ int main(int argc, char* const argv[])
 
         using namespace acmacs::chart;
         using namespace acmacs::chart::avidity;
-        const auto results = test(chart, opt.projection, Settings{.step = opt.adjust_step, .min_adjust = opt.min_adjust, .max_adjust = opt.max_adjust},
-             optimization_options{optimization_method_from_string(opt.method), opt.rough ? optimization_precision::rough : optimization_precision::fine});
+        const auto results = test(chart, opt.projection, Settings{.step = opt.adjust_step, .min_adjust = opt.min_adjust, .max_adjust = opt.max_adjust, .threads = opt.threads}, opt_opt);
         // AD_PRINT(fmt::runtime("{}"), results);
         AD_PRINT("{}", results);
+        if (opt.output_chart.has_value()) {
+            add_best_adjust_projections(chart, opt.projection, results, opt_opt);
+            export_factory(chart, opt.output_chart, opt.program_name());
+        }
     }
     catch (std::exception& err) {
         AD_ERROR("{}", err);
@@ -1,24 +1,33 @@
 #include <iostream>
+#include <mutex>
+#include <atomic>
+#include <limits>
 
 #include "acmacs-base/argc-argv.hh"
 #include "acmacs-base/timeit.hh"
 #include "acmacs-base/filesystem.hh"
+#include "acmacs-base/omp.hh"
 #include "acmacs-chart-2/chart-modify.hh"
 #include "acmacs-chart-2/randomizer.hh"
+#include "acmacs-chart-2/optimize.hh"
 #include "acmacs-chart-2/factory-import.hh"
 #include "acmacs-chart-2/factory-export.hh"
 #include "acmacs-chart-2/serum-line.hh"
+#include "acmacs-chart-2/procrustes.hh"
+#include "acmacs-chart-2/common.hh"
 
 // ----------------------------------------------------------------------
 
 struct Options
 {
-    Options(size_t a_number_of_attempts, double a_serum_line_sd_threshold, double a_rms_threshold)
-        : number_of_attempts{a_number_of_attempts}, serum_line_sd_threshold{a_serum_line_sd_threshold}, rms_threshold{a_rms_threshold} {}
+    Options(size_t a_number_of_attempts, double a_serum_line_sd_threshold, double a_rms_threshold, double a_prune_stress_ratio, int a_threads)
+        : number_of_attempts{a_number_of_attempts}, serum_line_sd_threshold{a_serum_line_sd_threshold}, rms_threshold{a_rms_threshold}, prune_stress_ratio{a_prune_stress_ratio}, threads{a_threads} {}
 
     size_t number_of_attempts;
     double serum_line_sd_threshold;
     double rms_threshold;
+    double prune_stress_ratio; // recursive: branch is not descended if its stress is higher than the best found stress multiplied by this ratio
+    int threads;
     size_t max_levels_in_randomization_descent = 20;
 };
 
@@ -43,8 +52,38 @@ struct SplitData
     acmacs::chart::PointIndexList on_the_wrong_side;
 };
 
+// Attempt: clone of the parent projection (scratch, not added to the chart) with antigens found on the wrong side of the serum line randomized
+// and relaxed (rough). Attempts are omp tasks. In the recursive search an attempt far (rms) from its parent spawns attempts of the next level,
+// attempts at all levels run concurrently. Chart is not modified, stress and common points are made once before tasks are started.
+class Resolver
+{
+  public:
+    Resolver(acmacs::chart::ChartModify& chart, acmacs::chart::ProjectionModifyP original_projection, const Options& options);
+
+    acmacs::chart::ProjectionModifyP recursive();
+    acmacs::chart::ProjectionModifyP random();
+
+  private:
+    using ScratchP = std::shared_ptr<acmacs::chart::ProjectionModifyNew>;
+
+    const Options& options_;
+    const acmacs::chart::optimization_options rough_{acmacs::chart::optimization_precision::rough};
+    const std::vector<acmacs::chart::CommonAntigensSera::common_t> common_;
+    const acmacs::chart::Stress stress_;
+    const ScratchP root_;
+    std::mutex access_; // best_, error_, reporting
+    ScratchP best_;
+    std::atomic<double> best_stress_{std::numeric_limits<double>::max()};
+    std::string error_;
+
+    // returns projection and its stress, stress is not stored in the projection: comment() and transformation() would reset it
+    std::pair<ScratchP, double> attempt(const acmacs::chart::ProjectionModify& parent, const SplitData& split_data) const;
+    void spawn(ScratchP parent, size_t level, std::string level_path);
+    void offer(ScratchP candidate);
+    void set_error(const std::exception& err);
+};
+
 static acmacs::chart::ProjectionModifyP flip_relax(acmacs::chart::ChartModify& chart, acmacs::chart::ProjectionModifyP original_projection, const Options& options);
-static acmacs::chart::ProjectionModifyP randomize_found_on_the_wrong_side_of_serum_line_recursive(acmacs::chart::ChartModify& chart, acmacs::chart::ProjectionModifyP original_projection, size_t level, std::string level_path, const Options& options);
 // static acmacs::chart::ProjectionModifyP randomize_found_on_the_wrong_side_of_serum_line(acmacs::chart::ChartModify& chart, acmacs::chart::ProjectionModifyP original_projection, const Options& options);
 static acmacs::chart::ProjectionModifyP randomize_found_on_the_wrong_side_of_serum_line_parallel(acmacs::chart::ChartModify& chart, acmacs::chart::ProjectionModifyP original_projection, const Options& options);
 
@@ -62,6 +101,8 @@ int main(int argc, char* const argv[])
                            {"--no-disconnect-having-few-titers", false, "do not disconnect points having too few numeric titers"},
                            {"--serum-line-sd-threshold", 0.4, "do not run resolver if serum line sd higher than this threshold"},
                            {"--rms-threshold", 0.1, "run resolver until rms between current and previous map bigger than this"},
+                           {"--prune-stress-ratio", 1.1, "recursive: do not descend into a branch if its stress is higher than the best stress found multiplied by this ratio"},
+                           {"--threads", 0, "number of threads to use (omp): 0 - autodetect, 1 - sequential"},
                            {"--time", false, "report time of loading chart"},
                            {"--verbose", false},
                            {"-h", false},
@@ -75,7 +116,7 @@ int main(int argc, char* const argv[])
         else {
             const size_t projection_no = 0;
             const std::string type(args["--type"]);
-            const Options options(args["-n"], args["--serum-line-sd-threshold"], args["--rms-threshold"]);
+            const Options options(args["-n"], args["--serum-line-sd-threshold"], args["--rms-threshold"], args["--prune-stress-ratio"], args["--threads"]);
             // const size_t number_of_attempts = args["-n"];
             // const double rms_threshold = args["--rms-threshold"];
             const auto report = do_report_time(args["--time"]);
@@ -91,7 +132,7 @@ int main(int argc, char* const argv[])
             auto found1 = flip_relax(chart, original_projection, options);
               // std::cerr << found1->make_info() << '\n' << '\n';
             if (type == "recursive") {
-                auto found2 = randomize_found_on_the_wrong_side_of_serum_line_recursive(chart, original_projection, 0, "", options);
+                auto found2 = Resolver{chart, original_projection, options}.recursive();
                 chart.projections_modify().add(found2);
             }
             else if (type == "random") {
@@ -145,67 +186,155 @@ int main(int argc, char* const argv[])
 
 // ----------------------------------------------------------------------
 
-acmacs::chart::ProjectionModifyP randomize_found_on_the_wrong_side_of_serum_line_parallel(acmacs::chart::ChartModify& chart, acmacs::chart::ProjectionModifyP original_projection,
-                                                                                          const Options& options)
+Resolver::Resolver(acmacs::chart::ChartModify& chart, acmacs::chart::ProjectionModifyP original_projection, const Options& options)
+    : options_{options}, common_{acmacs::chart::CommonAntigensSera{chart}.points()}, stress_{acmacs::chart::stress_factory(*original_projection, rough_.mult)},
+      root_{std::make_shared<acmacs::chart::ProjectionModifyNew>(*original_projection)}
+{
+} // Resolver::Resolver
+
+// ----------------------------------------------------------------------
+
+std::pair<Resolver::ScratchP, double> Resolver::attempt(const acmacs::chart::ProjectionModify& parent, const SplitData& split_data) const
+{
+    auto projection = std::make_shared<acmacs::chart::ProjectionModifyNew>(parent);
+    auto randomizer = acmacs::chart::randomizer_border_with_current_layout_area(*projection, 1.0, {split_data.serum_line.line(), split_data.good_side});
+    projection->randomize_layout(split_data.on_the_wrong_side, randomizer);
+    // relax with the shared stress, ProjectionModify::relax() would make stress and access chart for every attempt
+    auto layout = projection->layout_modified();
+    const auto status = acmacs::chart::optimize(rough_.method, stress_, layout->data(), layout->data() + layout->size(), rough_.precision);
+    return {projection, status.final_stress};
+
+} // Resolver::attempt
+
+// ----------------------------------------------------------------------
+
+void Resolver::offer(ScratchP candidate)
+{
+    std::lock_guard<std::mutex> lock{access_};
+    if (!best_ || candidate->stress() < best_->stress()) {
+        best_ = candidate;
+        best_stress_ = candidate->stress();
+    }
+
+} // Resolver::offer
+
+// ----------------------------------------------------------------------
+
+void Resolver::set_error(const std::exception& err)
 {
-    using Entry = std::tuple<acmacs::chart::ProjectionModifyP, size_t>; // projection, on_the_wrong_side
+    std::lock_guard<std::mutex> lock{access_};
+    if (error_.empty())
+        error_ = err.what();
+
+} // Resolver::set_error
+
+// ----------------------------------------------------------------------
+
+acmacs::chart::ProjectionModifyP Resolver::random()
+{
+    using Entry = std::tuple<ScratchP, size_t>; // projection, on_the_wrong_side
     auto entry_compare = [](const auto& e1, const auto& e2) -> bool {
         if (std::get<size_t>(e1) == std::get<size_t>(e2))
-            return std::get<acmacs::chart::ProjectionModifyP>(e1)->stress() < std::get<acmacs::chart::ProjectionModifyP>(e2)->stress();
+            return std::get<ScratchP>(e1)->stress() < std::get<ScratchP>(e2)->stress();
         else
             return std::get<size_t>(e1) < std::get<size_t>(e2);
     };
 
-    std::vector<Entry> results(options.number_of_attempts);
-    const SplitData split_data(*original_projection);
-
-#pragma omp parallel for default(shared) schedule(static, 4)
-    for (size_t attempt = 0; attempt < options.number_of_attempts; ++attempt) {
-        acmacs::chart::ProjectionModifyP new_projection = chart.projections_modify().new_by_cloning(*original_projection, false);
-        auto randomizer = acmacs::chart::randomizer_border_with_current_layout_area(*new_projection, 1.0, {split_data.serum_line.line(), split_data.good_side});
-        new_projection->randomize_layout(split_data.on_the_wrong_side, randomizer);
-        new_projection->relax(acmacs::chart::optimization_options(acmacs::chart::optimization_precision::rough));
-        const SplitData new_split_data(*new_projection);
-        new_projection->comment("resolver random, wrong_side:" + std::to_string(new_split_data.on_the_wrong_side->size()));
-        results[attempt] = {new_projection, new_split_data.on_the_wrong_side->size()};
+    std::vector<Entry> results(options_.number_of_attempts);
+    const SplitData split_data(*root_);
+
+#ifdef _OPENMP
+    const int num_threads = options_.threads <= 0 ? omp_get_max_threads() : options_.threads;
+#endif
+#pragma omp parallel for default(shared) num_threads(num_threads) schedule(dynamic, 1)
+    for (size_t attempt_no = 0; attempt_no < options_.number_of_attempts; ++attempt_no) {
+        try {
+            auto [new_projection, stress] = attempt(*root_, split_data);
+            const SplitData new_split_data(*new_projection);
+            new_projection->comment("resolver random, wrong_side:" + std::to_string(new_split_data.on_the_wrong_side->size()));
+            new_projection->set_stress(stress); // after the last modification, stress() must not recalculate concurrently
+            results[attempt_no] = {new_projection, new_split_data.on_the_wrong_side->size()};
+        }
+        catch (std::exception& err) {
+            set_error(err);
+        }
     }
 
-    auto result = std::get<acmacs::chart::ProjectionModifyP>(*std::min_element(results.begin(), results.end(), entry_compare));
-    result->relax({acmacs::chart::optimization_precision::fine});
-    result->orient_to(*original_projection);
-    return result;
+    if (!error_.empty())
+        throw std::runtime_error{error_};
+    best_ = std::get<ScratchP>(*std::min_element(results.begin(), results.end(), entry_compare));
+    return best_;
 
-} // randomize_found_on_the_wrong_side_of_serum_line_parallel
+} // Resolver::random
 
 // ----------------------------------------------------------------------
 
-acmacs::chart::ProjectionModifyP randomize_found_on_the_wrong_side_of_serum_line_recursive(acmacs::chart::ChartModify& chart, acmacs::chart::ProjectionModifyP original_projection, size_t level, std::string level_path, const Options& options)
+acmacs::chart::ProjectionModifyP Resolver::recursive()
 {
-    std::vector<acmacs::chart::ProjectionModifyP> results(options.number_of_attempts);
-    for (size_t attempt = 0; attempt < options.number_of_attempts; ++attempt) {
-        const std::string sublevel_path = level_path + (level_path.empty() ? "" : "-") + acmacs::to_string(attempt + 1);
-          // std::cerr << sublevel_path << '\n';
-
-        SplitData split_data(*original_projection);
-        acmacs::chart::ProjectionModifyP new_projection = chart.projections_modify().new_by_cloning(*original_projection, false);
-        auto randomizer = acmacs::chart::randomizer_border_with_current_layout_area(*new_projection, 1.0, {split_data.serum_line.line(), split_data.good_side});
-        new_projection->randomize_layout(split_data.on_the_wrong_side, randomizer);
-        new_projection->comment("resolver " + sublevel_path + " wrong-side:" + std::to_string(split_data.on_the_wrong_side->size()));
-        new_projection->relax(acmacs::chart::optimization_options(acmacs::chart::optimization_precision::rough));
-        const auto procrustes_data = new_projection->orient_to(*original_projection);
-        std::cerr << level << ' ' << sublevel_path << " wrong-side: " << split_data.on_the_wrong_side->size() << "  rms: " << procrustes_data.rms << '\n';
-
-        if (procrustes_data.rms > options.rms_threshold && level < options.max_levels_in_randomization_descent) {
-            std::cerr << new_projection->make_info() << '\n';
-            new_projection = randomize_found_on_the_wrong_side_of_serum_line_recursive(chart, new_projection, level + 1, sublevel_path, options);
-        }
+#ifdef _OPENMP
+    const int num_threads = options_.threads <= 0 ? omp_get_max_threads() : options_.threads;
+#endif
+#pragma omp parallel default(shared) num_threads(num_threads)
+#pragma omp single
+    spawn(root_, 0, std::string{});
+    // tasks are complete at the end of the parallel region
+
+    if (!error_.empty())
+        throw std::runtime_error{error_};
+    if (!best_)
+        throw std::runtime_error{"resolver: nothing found"};
+    return best_;
+
+} // Resolver::recursive
 
-        std::cerr << "    " << new_projection->make_info() << '\n';
-        results[attempt] = new_projection;
+// ----------------------------------------------------------------------
+
+void Resolver::spawn(ScratchP parent, size_t level, std::string level_path)
+{
+    const auto split_data = std::make_shared<const SplitData>(*parent);
+    parent->transformed_layout(); // cache it before parent is used as procrustes primary by concurrent attempts
+
+    for (size_t attempt_no = 0; attempt_no < options_.number_of_attempts; ++attempt_no) {
+#pragma omp task default(shared) firstprivate(parent, split_data, level, level_path, attempt_no)
+        {
+            try {
+                const std::string sublevel_path = level_path + (level_path.empty() ? "" : "-") + acmacs::to_string(attempt_no + 1);
+                auto [new_projection, stress] = attempt(*parent, *split_data);
+                new_projection->comment("resolver " + sublevel_path + " wrong-side:" + std::to_string(split_data->on_the_wrong_side->size()));
+                const auto procrustes_data = acmacs::chart::procrustes(*parent, *new_projection, common_, acmacs::chart::procrustes_scaling_t::no);
+                new_projection->transformation(procrustes_data.transformation);
+                new_projection->set_stress(stress); // after the last modification, stress() must not recalculate concurrently
+                const bool descend = procrustes_data.rms > options_.rms_threshold && level < options_.max_levels_in_randomization_descent;
+                const bool prune = descend && stress > best_stress_ * options_.prune_stress_ratio;
+                {
+                    std::lock_guard<std::mutex> lock{access_};
+                    std::cerr << level << ' ' << sublevel_path << " wrong-side: " << split_data->on_the_wrong_side->size() << "  rms: " << procrustes_data.rms << "  stress: " << stress
+                              << (prune ? " pruned" : "") << '\n';
+                }
+                if (!descend)
+                    offer(new_projection);
+                else if (!prune)
+                    spawn(new_projection, level + 1, sublevel_path);
+            }
+            catch (std::exception& err) {
+                set_error(err);
+            }
+        }
     }
-    return *std::min_element(results.begin(), results.end(), [](const auto& p1, const auto& p2) { return p1->stress() < p2->stress(); });
 
-} // randomize_found_on_the_wrong_side_of_serum_line_recursive
+} // Resolver::spawn
+
+// ----------------------------------------------------------------------
+
+acmacs::chart::ProjectionModifyP randomize_found_on_the_wrong_side_of_serum_line_parallel(acmacs::chart::ChartModify& chart, acmacs::chart::ProjectionModifyP original_projection,
+                                                                                          const Options& options)
+{
+    auto result = Resolver{chart, original_projection, options}.random();
+    result->relax({acmacs::chart::optimization_precision::fine});
+    result->orient_to(*original_projection);
+    return result;
+
+} // randomize_found_on_the_wrong_side_of_serum_line_parallel
 
 // ----------------------------------------------------------------------
 
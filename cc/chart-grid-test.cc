@@ -1,9 +1,11 @@
 #include <algorithm>
+#include <optional>
 
 #include "acmacs-base/argv.hh"
 #include "acmacs-base/read-file.hh"
 #include "acmacs-base/string-split.hh"
 #include "acmacs-base/string-from-chars.hh"
+#include "acmacs-base/timeit.hh"
 #include "acmacs-chart-2/grid-test.hh"
 #include "acmacs-chart-2/factory-import.hh"
 #include "acmacs-chart-2/factory-export.hh"
@@ -19,8 +21,14 @@ struct Options : public argv
     option<bool>   relax{*this, "relax", desc{"move trapped points and relax, test again, repeat while there are trapped points"}};
     option<size_t> projection{*this, "projection", dflt{0UL}, desc{"projection number to test"}};
     option<double> grid_step{*this, "step", dflt{0.1}, desc{"grid step"}};
+    option<bool>   adaptive{*this, "adaptive", desc{"coarse scan, then scan with grid step around the best coarse cells only"}};
+    option<bool>   local{*this, "local", desc{"score candidate moves by optimizing the moved point neighbourhood, whole layout for trapped points only"}};
+    option<size_t> local_hops{*this, "local-hops", dflt{1UL}, desc{"--local: neighbourhood size in table distance links"}};
+    option<bool>   retest_incremental{*this, "retest-incremental", desc{"--relax: after the first attempt retest only points affected by the previous move-and-relax and points found trapped, by default all points are tested on every attempt"}};
+    option<bool>   validate_adaptive{*this, "validate-adaptive", desc{"test points using both uniform and adaptive scan, report differences"}};
     option<str>    points_to_test{*this, "points", dflt{"all"}, desc{"comma separated list of point numbers or names to test, \"all\" to test all"}};
     option<str>    grid_json{*this, "json", desc{"export test results into json"}};
+    option<str>    json_lines{*this, "json-lines", desc{"write result of each point as a json line as soon as it is tested"}};
     option<str>    csv{*this, "csv", desc{"export layout and test results into csv"}};
     option<int>    threads{*this, "threads", dflt{0}, desc{"number of threads to use for test (omp): 0 - autodetect, 1 - sequential"}};
     option<bool>   report_time{*this, "time", desc{"report time of loading chart"}};
@@ -30,6 +38,10 @@ struct Options : public argv
     argument<str> output{*this, arg_name{"output-chart"}};
 };
 
+static void validate_adaptive(acmacs::chart::ChartModify& chart, size_t projection_no, double grid_step, int threads);
+
+// ----------------------------------------------------------------------
+
 int main(int argc, char* const argv[])
 {
     int exit_code = 0;
@@ -38,11 +50,17 @@ int main(int argc, char* const argv[])
         const auto report = do_report_time(opt.report_time);
         acmacs::chart::ChartModify chart{acmacs::chart::import_from_file(opt.source, acmacs::chart::Verify::None, report)};
 
+        const auto search = opt.adaptive ? acmacs::chart::grid_search::adaptive : acmacs::chart::grid_search::uniform;
+        const auto refine = opt.local ? acmacs::chart::grid_refine::local : acmacs::chart::grid_refine::full;
         acmacs::chart::GridTest::Results results;
-        if (opt.points_to_test == "all") {
+        if (opt.validate_adaptive) {
+            validate_adaptive(chart, opt.projection, opt.grid_step, opt.threads);
+        }
+        else if (opt.points_to_test == "all") {
             auto master_projection = chart.projection(opt.projection);
             const size_t relax_attempts = 20;
-            const auto [grid_results, grid_projections] = acmacs::chart::grid_test(chart, opt.projection, opt.grid_step, opt.threads, relax_attempts, opt.grid_json);
+            const auto [grid_results, grid_projections] = acmacs::chart::grid_test(chart, opt.projection, opt.grid_step, opt.threads, relax_attempts, opt.grid_json, search, refine, opt.local_hops,
+                                                                                   opt.retest_incremental ? acmacs::chart::grid_retest::incremental : acmacs::chart::grid_retest::all, opt.json_lines);
             AD_PRINT_NEWLINE();
 
             if (opt.output.has_value()) {
@@ -60,6 +78,13 @@ int main(int argc, char* const argv[])
         }
         else {
             acmacs::chart::GridTest test(chart, opt.projection, opt.grid_step);
+            test.search(search);
+            test.refine(refine, opt.local_hops);
+            std::optional<acmacs::chart::GridTestStream> stream;
+            if (opt.json_lines) {
+                stream.emplace(chart, opt.json_lines);
+                test.stream(&*stream);
+            }
             auto antigens = chart.antigens();
             acmacs::chart::Indexes points;
             for (const auto& point_ref : acmacs::string::split(*opt.points_to_test, ",")) {
@@ -96,6 +121,32 @@ int main(int argc, char* const argv[])
     return exit_code;
 }
 
+// ----------------------------------------------------------------------
+
+void validate_adaptive(acmacs::chart::ChartModify& chart, size_t projection_no, double grid_step, int threads)
+{
+    const auto run = [&](acmacs::chart::grid_search search) {
+        const auto start = std::chrono::high_resolution_clock::now();
+        acmacs::chart::GridTest test(chart, projection_no, grid_step);
+        test.search(search);
+        auto results = test.test_all(threads);
+        return std::pair{std::move(results), std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start)};
+    };
+    const auto [uniform, uniform_time] = run(acmacs::chart::grid_search::uniform);
+    const auto [adaptive, adaptive_time] = run(acmacs::chart::grid_search::adaptive);
+
+    size_t differences{0};
+    for (size_t no = 0; no < uniform.size(); ++no) {
+        if (uniform[no].diagnosis != adaptive[no].diagnosis) {
+            ++differences;
+            fmt::print("uniform:  {}\nadaptive: {}\n", uniform[no].report(chart), adaptive[no].report(chart));
+        }
+    }
+    fmt::print("uniform:  {} time: {}\nadaptive: {} time: {}\ndiagnosis differences: {} of {} points\n", uniform.report(), acmacs::format_duration(uniform_time), adaptive.report(),
+               acmacs::format_duration(adaptive_time), differences, uniform.size());
+
+} // validate_adaptive
+
 // ----------------------------------------------------------------------
 /// Local Variables:
 /// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
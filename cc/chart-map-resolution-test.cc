@@ -19,7 +19,10 @@ struct Options : public argv
     option<bool>   fine_optimisation{*this, "fine-optimisation"};
     option<bool>   no_column_bases_from_master{*this, "no-column-bases-from-master", desc{"converting titers to dont-care may change column bases, do not force master chart column bases"}};
     option<bool>   relax_from_full_table{*this, "relax-from-full-table", desc{"additional projection in each replicate, first full table is relaxed, then titers dont-cared and the best projection relaxed again from already found starting coordinates."}};
+    option<bool>   mask{*this, "mask", desc{"replicates hold out titers by a bitmask over master table distances instead of cloning chart (faster, intermediate charts are not saved)"}};
     option<str>    save_charts_to{*this, "save", desc{"save intermediate charts to this directory"}};
+    option<size_t> seed{*this, "seed", desc{"seed for selecting titers to dont-care and randomizing replicate layouts, replicate job number is added"}};
+    option<int>    threads{*this, "threads", dflt{0}, desc{"number of replicates to run concurrently (omp): 0 - autodetect, 1 - sequential"}};
 
     argument<str> source{*this, arg_name{"chart-to-test"}, mandatory};
 };
@@ -41,7 +44,11 @@ int main(int argc, char* const argv[])
         parameters.column_bases_from_master = *opt.no_column_bases_from_master ? acmacs::chart::map_resolution_test_data::column_bases_from_master::no : acmacs::chart::map_resolution_test_data::column_bases_from_master::yes;
         parameters.optimization_precision = *opt.fine_optimisation ? acmacs::chart::optimization_precision::fine : acmacs::chart::optimization_precision::rough;
         parameters.relax_from_full_table = *opt.relax_from_full_table ? acmacs::chart::map_resolution_test_data::relax_from_full_table::yes : acmacs::chart::map_resolution_test_data::relax_from_full_table::no;
+        parameters.dont_care_replicates = *opt.mask ? acmacs::chart::map_resolution_test_data::dont_care_replicates::mask : acmacs::chart::map_resolution_test_data::dont_care_replicates::clone_chart;
         parameters.save_charts_to = *opt.save_charts_to;
+        if (opt.seed.has_value())
+            parameters.seed = static_cast<acmacs::chart::LayoutRandomizer::seed_t::value_type>(*opt.seed);
+        parameters.threads = opt.threads;
 
         fmt::print(stderr, "{}\n", parameters);
 
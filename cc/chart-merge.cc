@@ -63,6 +63,8 @@ int main(int argc, const char* const argv[])
         }
 
         settings.combine_cheating_assays_ = combine_cheating_assays(charts, opt.combine_cheating_assays);
+        if (opt.report_titers.has_value())
+            settings.titer_merge_report_ = acmacs::chart::TitersModify::make_merge_report::yes;
 
         auto [result, merge_report] = acmacs::chart::merge(*charts[0], *charts[1], settings);
 
@@ -1,7 +1,10 @@
 #include <random>
+#include <exception>
+#include <iterator>
 #include <functional>
 #include <limits>
 #include <algorithm>
+#include <numeric>
 
 #include "acmacs-base/log.hh"
 #include "acmacs-base/omp.hh"
@@ -298,12 +301,14 @@ std::pair<optimization_status, ProjectionModifyP> ChartModify::relax(MinimumColu
         throw std::runtime_error{AD_FORMAT("cannot relax projection: too few connected points: {}", num_connected)};
     auto rnd = randomizer_plain_from_sample_optimization(*projection, stress, options.randomization_diameter_multiplier, seed);
     projection->randomize_layout(rnd);
-    auto status = acmacs::chart::optimize(options.method, stress, layout->data(), layout->data() + layout->size(), optimization_precision::rough);
+    const auto trace = make_optimization_trace(options);
+    auto status = acmacs::chart::optimize(options.method, stress, layout->data(), layout->data() + layout->size(), optimization_precision::rough, trace.get());
+    status.trace = trace;
     if (start_num_dim > number_of_dimensions) {
         acmacs::chart::dimension_annealing(options.method, stress, projection->number_of_dimensions(), number_of_dimensions, layout->data(), layout->data() + layout->size());
         layout->change_number_of_dimensions(number_of_dimensions);
         stress.change_number_of_dimensions(number_of_dimensions);
-        const auto status2 = acmacs::chart::optimize(options.method, stress, layout->data(), layout->data() + layout->size(), options.precision);
+        const auto status2 = acmacs::chart::optimize(options.method, stress, layout->data(), layout->data() + layout->size(), options.precision, trace.get());
         status.number_of_iterations += status2.number_of_iterations;
         status.number_of_stress_calculations += status2.number_of_stress_calculations;
         status.termination_report = status2.termination_report;
@@ -320,8 +325,30 @@ std::pair<optimization_status, ProjectionModifyP> ChartModify::relax(MinimumColu
 
 // ----------------------------------------------------------------------
 
-void ChartModify::relax(number_of_optimizations_t number_of_optimizations, MinimumColumnBasis minimum_column_basis, number_of_dimensions_t number_of_dimensions,
-                        use_dimension_annealing dimension_annealing, const optimization_options& options, const DisconnectedPoints& disconnect_points)
+std::vector<optimization_status> ChartModify::relax(number_of_optimizations_t number_of_optimizations, MinimumColumnBasis minimum_column_basis, number_of_dimensions_t number_of_dimensions,
+                        use_dimension_annealing dimension_annealing, const optimization_options& options, const DisconnectedPoints& disconnect_points, LayoutRandomizer::seed_t seed)
+{
+    const auto prepared = relax_prepare(number_of_optimizations, minimum_column_basis, number_of_dimensions, dimension_annealing, options, disconnect_points, seed);
+    std::vector<optimization_status> statuses(prepared.projections.size(), optimization_status{options.method});
+    auto stress = prepared.stress;
+
+#ifdef _OPENMP
+    const int num_threads = options.num_threads <= 0 ? omp_get_max_threads() : options.num_threads;
+    const int slot_size = number_of_antigens() < 1000 ? 4 : 1;
+#endif
+#pragma omp parallel for default(shared) num_threads(num_threads) firstprivate(stress) schedule(static, slot_size)
+    for (size_t p_no = 0; p_no < prepared.projections.size(); ++p_no) {
+        statuses[p_no] = relax_prepared(prepared, p_no, stress, options);
+    }
+    return statuses;
+
+} // ChartModify::relax
+
+// ----------------------------------------------------------------------
+
+ChartModify::relax_prepared_t ChartModify::relax_prepare(number_of_optimizations_t number_of_optimizations, MinimumColumnBasis minimum_column_basis, number_of_dimensions_t number_of_dimensions,
+                                                         use_dimension_annealing dimension_annealing, const optimization_options& options, const DisconnectedPoints& disconnect_points,
+                                                         LayoutRandomizer::seed_t seed)
 {
     const auto start_num_dim = dimension_annealing == use_dimension_annealing::yes && *number_of_dimensions < 5 ? number_of_dimensions_t{5} : number_of_dimensions;
     auto titrs = titers();
@@ -332,7 +359,7 @@ void ChartModify::relax(number_of_optimizations_t number_of_optimizations, Minim
     if (const auto num_connected = number_of_antigens() + number_of_sera() - stress.number_of_disconnected(); num_connected < 3)
         throw std::runtime_error{AD_FORMAT("cannot relax: too few connected points: {}", num_connected)};
     report_disconnected_unmovable(stress.parameters().disconnected, stress.parameters().unmovable);
-    auto rnd = randomizer_plain_from_sample_optimization(*this, stress, start_num_dim, minimum_column_basis, options.randomization_diameter_multiplier);
+    auto rnd = randomizer_plain_from_sample_optimization(*this, stress, start_num_dim, minimum_column_basis, options.randomization_diameter_multiplier, seed);
 
     std::vector<std::shared_ptr<ProjectionModifyNew>> projections(*number_of_optimizations);
     std::transform(projections.begin(), projections.end(), projections.begin(), [start_num_dim, minimum_column_basis, this, &stress](const auto&) {
@@ -341,36 +368,41 @@ void ChartModify::relax(number_of_optimizations_t number_of_optimizations, Minim
         projection->set_unmovable(stress.parameters().unmovable);
         return projection;
     });
+    return relax_prepared_t{std::move(stress), rnd, start_num_dim, number_of_dimensions, std::move(projections)};
 
-#ifdef _OPENMP
-    const int num_threads = options.num_threads <= 0 ? omp_get_max_threads() : options.num_threads;
-    const int slot_size = number_of_antigens() < 1000 ? 4 : 1;
-#endif
-#pragma omp parallel for default(shared) num_threads(num_threads) firstprivate(stress) schedule(static, slot_size)
-    for (size_t p_no = 0; p_no < projections.size(); ++p_no) {
-        auto projection = projections[p_no];
-        projection->randomize_layout(rnd);
-        auto layout = projection->layout_modified();
-        stress.change_number_of_dimensions(start_num_dim);
-        const auto status1 =
-            acmacs::chart::optimize(options.method, stress, layout->data(), layout->data() + layout->size(), start_num_dim > number_of_dimensions ? optimization_precision::rough : options.precision);
-        if (start_num_dim > number_of_dimensions) {
-            acmacs::chart::dimension_annealing(options.method, stress, projection->number_of_dimensions(), number_of_dimensions, layout->data(), layout->data() + layout->size());
-            layout->change_number_of_dimensions(number_of_dimensions);
-            stress.change_number_of_dimensions(number_of_dimensions);
-            const auto status2 = acmacs::chart::optimize(options.method, stress, layout->data(), layout->data() + layout->size(), options.precision);
-            if (!std::isnan(status2.final_stress))
-                projection->stress_ = status2.final_stress;
-        }
-        else {
-            if (!std::isnan(status1.final_stress))
-                projection->stress_ = status1.final_stress;
-        }
-        projection->transformation_reset();
-        AD_LOG(acmacs::log::report_stresses, "{:3d} {:.4f}", p_no, *projection->stress_);
+} // ChartModify::relax_prepare
+
+// ----------------------------------------------------------------------
+
+optimization_status ChartModify::relax_prepared(const relax_prepared_t& prepared, size_t projection_index, Stress& stress, const optimization_options& options)
+{
+    const auto start_num_dim = prepared.start_number_of_dimensions;
+    const auto number_of_dimensions = prepared.number_of_dimensions;
+    auto projection = prepared.projections[projection_index];
+    projection->randomize_layout(prepared.randomizer);
+    auto layout = projection->layout_modified();
+    stress.change_number_of_dimensions(start_num_dim);
+    const auto trace = make_optimization_trace(options);
+    auto status = acmacs::chart::optimize(options.method, stress, layout->data(), layout->data() + layout->size(), start_num_dim > number_of_dimensions ? optimization_precision::rough : options.precision, trace.get());
+    status.trace = trace;
+    if (start_num_dim > number_of_dimensions) {
+        acmacs::chart::dimension_annealing(options.method, stress, projection->number_of_dimensions(), number_of_dimensions, layout->data(), layout->data() + layout->size());
+        layout->change_number_of_dimensions(number_of_dimensions);
+        stress.change_number_of_dimensions(number_of_dimensions);
+        const auto status2 = acmacs::chart::optimize(options.method, stress, layout->data(), layout->data() + layout->size(), options.precision, trace.get());
+        status.number_of_iterations += status2.number_of_iterations;
+        status.number_of_stress_calculations += status2.number_of_stress_calculations;
+        status.termination_report = status2.termination_report;
+        status.final_stress = status2.final_stress;
+        status.time += status2.time;
     }
+    if (!std::isnan(status.final_stress))
+        projection->stress_ = status.final_stress;
+    projection->transformation_reset();
+    AD_LOG(acmacs::log::report_stresses, "{:3d} {:.4f}", projection_index, *projection->stress_);
+    return status;
 
-} // ChartModify::relax
+} // ChartModify::relax_prepared
 
 // ----------------------------------------------------------------------
 
@@ -886,6 +918,261 @@ void SerumModify::update_with(const Serum& main)
 
 // ----------------------------------------------------------------------
 
+SparseTiters::SparseTiters(const SparseTiters& rhs)
+{
+    rhs.apply_pending();
+    entries_ = rhs.entries_;
+    row_offsets_ = rhs.row_offsets_;
+
+} // SparseTiters::SparseTiters
+
+// ----------------------------------------------------------------------
+
+SparseTiters::SparseTiters(SparseTiters&& rhs)
+{
+    rhs.apply_pending();
+    entries_ = std::move(rhs.entries_);
+    row_offsets_ = std::move(rhs.row_offsets_);
+
+} // SparseTiters::SparseTiters
+
+// ----------------------------------------------------------------------
+
+SparseTiters& SparseTiters::operator=(const SparseTiters& rhs)
+{
+    rhs.apply_pending();
+    apply_pending();
+    entries_ = rhs.entries_;
+    row_offsets_ = rhs.row_offsets_;
+    reset_columns();
+    return *this;
+
+} // SparseTiters::operator=
+
+// ----------------------------------------------------------------------
+
+SparseTiters& SparseTiters::operator=(SparseTiters&& rhs)
+{
+    rhs.apply_pending();
+    apply_pending();
+    entries_ = std::move(rhs.entries_);
+    row_offsets_ = std::move(rhs.row_offsets_);
+    reset_columns();
+    return *this;
+
+} // SparseTiters::operator=
+
+// ----------------------------------------------------------------------
+
+Titer SparseTiters::titer(size_t antigen_no, size_t serum_no) const
+{
+    const auto row_entries = row(antigen_no);
+    if (const auto found = std::lower_bound(row_entries.begin(), row_entries.end(), serum_no, [](const auto& e1, size_t sr_no) { return e1.first < sr_no; });
+        found != row_entries.end() && found->first == serum_no)
+        return found->second;
+    return {};
+
+} // SparseTiters::titer
+
+// ----------------------------------------------------------------------
+
+size_t SparseTiters::titrations_for_serum(size_t serum_no) const
+{
+    const auto cols = columns();
+    return serum_no + 1 < cols->offsets.size() ? (cols->offsets[serum_no + 1] - cols->offsets[serum_no]) : 0;
+
+} // SparseTiters::titrations_for_serum
+
+// ----------------------------------------------------------------------
+
+std::shared_ptr<const SparseTiters::Columns> SparseTiters::columns() const
+{
+    apply_pending();
+    std::lock_guard<std::mutex> lock{columns_access_};
+    if (!columns_) {
+        auto cols = std::make_shared<Columns>();
+        const auto number_of_sera = entries_.empty() ? size_t{0} : (std::max_element(entries_.begin(), entries_.end(), [](const auto& e1, const auto& e2) { return e1.first < e2.first; })->first + 1);
+        cols->offsets.assign(number_of_sera + 1, 0);
+        for (const auto& entry : entries_)
+            ++cols->offsets[entry.first + 1];
+        std::partial_sum(cols->offsets.begin(), cols->offsets.end(), cols->offsets.begin());
+        cols->antigens.resize(entries_.size());
+        cols->entries.resize(entries_.size());
+        std::vector<size_t> next(cols->offsets.begin(), cols->offsets.end() - 1);
+        for (size_t antigen_no = 0; antigen_no < number_of_antigens(); ++antigen_no) {
+            for (auto index = row_offsets_[antigen_no]; index < row_offsets_[antigen_no + 1]; ++index) {
+                const auto target = next[entries_[index].first]++;
+                cols->antigens[target] = antigen_no;
+                cols->entries[target] = index;
+            }
+        }
+        columns_ = std::move(cols);
+    }
+    return columns_;
+
+} // SparseTiters::columns
+
+// ----------------------------------------------------------------------
+
+void SparseTiters::reset_columns()
+{
+    std::lock_guard<std::mutex> lock{columns_access_};
+    columns_.reset();
+
+} // SparseTiters::reset_columns
+
+// ----------------------------------------------------------------------
+
+void SparseTiters::merge_pending() const
+{
+    std::lock_guard<std::mutex> lock{pending_access_};
+    if (!has_pending_.load(std::memory_order_relaxed))
+        return;
+
+    // stable: several set() calls for the same titer keep call order, the last one wins
+    std::stable_sort(pending_.begin(), pending_.end(), [](const auto& e1, const auto& e2) { return e1.first < e2.first || (e1.first == e2.first && e1.second.first < e2.second.first); });
+    std::vector<entry_t> entries;
+    entries.reserve(entries_.size() + pending_.size());
+    std::vector<size_t> row_offsets;
+    row_offsets.reserve(row_offsets_.size());
+    row_offsets.push_back(0);
+    auto pending = pending_.begin();
+    for (size_t antigen_no = 0; antigen_no < number_of_antigens(); ++antigen_no) {
+        auto existing = entries_.begin() + offset(antigen_no);
+        const auto last = entries_.begin() + offset(antigen_no + 1);
+        for (; pending != pending_.end() && pending->first == antigen_no; ++pending) {
+            if (const auto next = std::next(pending); next != pending_.end() && next->first == antigen_no && next->second.first == pending->second.first)
+                continue;
+            for (; existing != last && existing->first < pending->second.first; ++existing)
+                entries.push_back(std::move(*existing));
+            if (existing != last && existing->first == pending->second.first)
+                ++existing;
+            if (!pending->second.second.is_dont_care())
+                entries.push_back(std::move(pending->second));
+        }
+        std::move(existing, last, std::back_inserter(entries));
+        row_offsets.push_back(entries.size());
+    }
+    entries_ = std::move(entries);
+    row_offsets_ = std::move(row_offsets);
+    pending_.clear();
+    has_pending_.store(false, std::memory_order_release);
+
+} // SparseTiters::merge_pending
+
+// ----------------------------------------------------------------------
+
+void SparseTiters::resize(size_t number_of_antigens)
+{
+    apply_pending();
+    if (number_of_antigens < this->number_of_antigens()) {
+        entries_.erase(entries_.begin() + offset(number_of_antigens), entries_.end());
+        row_offsets_.resize(number_of_antigens + 1);
+    }
+    else
+        row_offsets_.resize(number_of_antigens + 1, entries_.size());
+    reset_columns();
+
+} // SparseTiters::resize
+
+// ----------------------------------------------------------------------
+
+void SparseTiters::set(size_t antigen_no, size_t serum_no, const Titer& titer)
+{
+    if (!has_pending_.load(std::memory_order_acquire)) {
+        const auto first = entries_.begin() + offset(antigen_no), last = entries_.begin() + offset(antigen_no + 1);
+        const auto found = std::lower_bound(first, last, serum_no, [](const auto& e1, size_t sr_no) { return e1.first < sr_no; });
+        if (found != last && found->first == serum_no) {
+            if (!titer.is_dont_care()) {
+                found->second = titer; // structure is not changed, columns_ is still valid
+                return;
+            }
+        }
+        else if (titer.is_dont_care())
+            return;
+    }
+    // insertion or removal shifts the following rows, stage it to avoid quadratic cost of filling titer by titer
+    pending_.emplace_back(antigen_no, entry_t{serum_no, titer});
+    has_pending_.store(true, std::memory_order_release);
+    reset_columns();
+
+} // SparseTiters::set
+
+// ----------------------------------------------------------------------
+
+void SparseTiters::clear_row(size_t antigen_no)
+{
+    apply_pending();
+    const auto removed = row_offsets_[antigen_no + 1] - row_offsets_[antigen_no];
+    entries_.erase(entries_.begin() + offset(antigen_no), entries_.begin() + offset(antigen_no + 1));
+    std::for_each(row_offsets_.begin() + static_cast<std::ptrdiff_t>(antigen_no) + 1, row_offsets_.end(), [removed](size_t& off) { off -= removed; });
+    reset_columns();
+
+} // SparseTiters::clear_row
+
+// ----------------------------------------------------------------------
+
+void SparseTiters::insert_antigen(size_t before)
+{
+    apply_pending();
+    row_offsets_.insert(row_offsets_.begin() + static_cast<std::ptrdiff_t>(before), row_offsets_[before]);
+    reset_columns();
+
+} // SparseTiters::insert_antigen
+
+// ----------------------------------------------------------------------
+
+void SparseTiters::remove_antigens(const ReverseSortedIndexes& indexes)
+{
+    apply_pending();
+    std::vector<bool> to_remove(number_of_antigens(), false);
+    for (const auto index : indexes)
+        to_remove[index] = true;
+    std::vector<entry_t> entries;
+    entries.reserve(entries_.size());
+    std::vector<size_t> row_offsets{0};
+    for (size_t antigen_no = 0; antigen_no < number_of_antigens(); ++antigen_no) {
+        if (!to_remove[antigen_no]) {
+            std::move(entries_.begin() + offset(antigen_no), entries_.begin() + offset(antigen_no + 1), std::back_inserter(entries));
+            row_offsets.push_back(entries.size());
+        }
+    }
+    entries_ = std::move(entries);
+    row_offsets_ = std::move(row_offsets);
+    reset_columns();
+
+} // SparseTiters::remove_antigens
+
+// ----------------------------------------------------------------------
+
+void SparseTiters::insert_serum(size_t before)
+{
+    modify_if([before](size_t /*antigen_no*/, entry_t& entry) {
+        if (entry.first >= before)
+            ++entry.first;
+        return true;
+    });
+
+} // SparseTiters::insert_serum
+
+// ----------------------------------------------------------------------
+
+void SparseTiters::remove_sera(const ReverseSortedIndexes& indexes)
+{
+    std::vector<size_t> removed(indexes.begin(), indexes.end());
+    std::sort(removed.begin(), removed.end());
+    modify_if([&removed](size_t /*antigen_no*/, entry_t& entry) {
+        const auto found = std::lower_bound(removed.begin(), removed.end(), entry.first);
+        if (found != removed.end() && *found == entry.first)
+            return false;
+        entry.first -= static_cast<size_t>(found - removed.begin());
+        return true;
+    });
+
+} // SparseTiters::remove_sera
+
+// ----------------------------------------------------------------------
+
 TitersModify::TitersModify(size_t number_of_antigens, size_t number_of_sera)
     : number_of_sera_{number_of_sera}, titers_{dense_t(number_of_antigens * number_of_sera)}
 {
@@ -904,19 +1191,17 @@ TitersModify::TitersModify(TitersP main)
         if constexpr (std::is_same_v<T, dense_t>) {
               // Dense ==================================================
             titers.resize(main->number_of_antigens() * this->number_of_sera_);
-            for (const auto &entry : main->titers_existing()) { // order of iterations is not specified!
-                // std::cerr << entry.antigen << ' ' << entry.serum << ' ' << entry.titer << '\n';
-                titers[entry.antigen * this->number_of_sera_ + entry.serum] = entry.titer;
-            }
+            main->for_each_titer_row([&titers, this](size_t antigen_no, const titer_row_t& row) {
+                for (const auto& [serum_no, titer] : row)
+                    titers[antigen_no * this->number_of_sera_ + serum_no] = Titer{titer};
+            });
         }
         else { // Sparse ==================================================
+            main->for_each_titer_row([&titers](size_t antigen_no, const titer_row_t& row) { // rows come in antigen order, entries of a row are ordered by serum
+                titers.resize(antigen_no);
+                titers.push_back_row(row.begin(), row.end());
+            });
             titers.resize(main->number_of_antigens());
-            for (const auto &entry : main->titers_existing()) { // order of iterations is not specified!
-                titers[entry.antigen].emplace_back(entry.serum, entry.titer);
-            }
-              // sort entries by serum no
-            for (auto& row : titers)
-                std::sort(row.begin(), row.end(), [](const auto& e1, const auto& e2) { return e1.first < e2.first; });
         }
     };
 
@@ -974,11 +1259,11 @@ inline acmacs::chart::Titer TitersModify::find_titer_for_serum(const sparse_row_
 
 // ----------------------------------------------------------------------
 
-inline acmacs::chart::Titer TitersModify::titer_in_sparse_t(const sparse_t& aSparse, size_t aAntigenNo, size_t aSerumNo)
+inline acmacs::chart::Titer TitersModify::titer_in_layer(const layer_t& aLayer, size_t aAntigenNo, size_t aSerumNo)
 {
-    return find_titer_for_serum(aSparse[aAntigenNo], aSerumNo);
+    return find_titer_for_serum(aLayer[aAntigenNo], aSerumNo);
 
-} // TitersModify::titer_in_sparse_t
+} // TitersModify::titer_in_layer
 
 // ----------------------------------------------------------------------
 
@@ -989,7 +1274,7 @@ Titer TitersModify::titer(size_t aAntigenNo, size_t aSerumNo) const
         if constexpr (std::is_same_v<T, dense_t>)
             return titers[aAntigenNo * this->number_of_sera_ + aSerumNo];
         else
-            return titer_in_sparse_t(titers, aAntigenNo, aSerumNo);
+            return titers.titer(aAntigenNo, aSerumNo);
     };
     return std::visit(get, titers_);
 
@@ -999,7 +1284,7 @@ Titer TitersModify::titer(size_t aAntigenNo, size_t aSerumNo) const
 
 Titer TitersModify::titer_of_layer(size_t aLayerNo, size_t aAntigenNo, size_t aSerumNo) const
 {
-    return titer_in_sparse_t(layers_[aLayerNo], aAntigenNo, aSerumNo);
+    return titer_in_layer(layers_[aLayerNo], aAntigenNo, aSerumNo);
 
 } // TitersModify::titer_of_layer
 
@@ -1085,9 +1370,9 @@ void TitersModify::create_layers(size_t number_of_layers, size_t number_of_antig
 
 // ----------------------------------------------------------------------
 
-void TitersModify::set_titer(sparse_t& titers, size_t aAntigenNo, size_t aSerumNo, const acmacs::chart::Titer& aTiter)
+void TitersModify::set_titer(layer_t& layer, size_t aAntigenNo, size_t aSerumNo, const acmacs::chart::Titer& aTiter)
 {
-    auto& row = titers[aAntigenNo];
+    auto& row = layer[aAntigenNo];
     if (row.empty()) {
         row.emplace_back(aSerumNo, aTiter);
     }
@@ -1111,7 +1396,7 @@ void TitersModify::titer(size_t aAntigenNo, size_t aSerumNo, size_t aLayerNo, co
 
 // ----------------------------------------------------------------------
 
-std::unique_ptr<TitersModify::titer_merge_report> TitersModify::set_from_layers(ChartModify& chart)
+std::unique_ptr<TitersModify::titer_merge_report> TitersModify::set_from_layers(ChartModify& chart, make_merge_report report)
 {
     // merge titers from layers
     // ~/ac/acmacs/acmacs/core/chart.py:1281
@@ -1123,10 +1408,10 @@ std::unique_ptr<TitersModify::titer_merge_report> TitersModify::set_from_layers(
     MinimumColumnBasis no_column_bases{};
     if (has_morethan_in_layers()) {
           // std::cerr << AD_FORMAT("DEBUG: has_morethan_in_layers");
-        set_titers_from_layers(more_than_thresholded::adjust_to_next);
+        set_titers_from_layers(more_than_thresholded::adjust_to_next, make_merge_report::no);
         column_bases = computed_column_bases(no_column_bases);
     }
-    auto titer_merge_report = set_titers_from_layers(more_than_thresholded::to_dont_care);
+    auto titer_merge_report = set_titers_from_layers(more_than_thresholded::to_dont_care, report);
     if (column_bases) {
         chart.forced_column_bases_modify(*column_bases);
         AD_INFO("forced column bases: {}", *chart.forced_column_bases(no_column_bases));
@@ -1141,31 +1426,56 @@ std::unique_ptr<TitersModify::titer_merge_report> TitersModify::set_from_layers(
 // is 'dont-care', ignore them, if more_than_thresholded is
 // 'adjust-to-next', those titers are converted to the next value,
 // e.g. >5120 to 10240.
-std::unique_ptr<TitersModify::titer_merge_report> TitersModify::set_titers_from_layers(more_than_thresholded mtt)
+std::unique_ptr<TitersModify::titer_merge_report> TitersModify::set_titers_from_layers(more_than_thresholded mtt, make_merge_report report)
 {
       // core/antigenic_table.py:266
       // backend/antigenic-table.hh:892
 
+    invalidate_encoded();
     constexpr double standard_deviation_threshold = 1.0; // lispmds: average-multiples-unless-sd-gt-1-ignore-thresholded-unless-only-entries-then-min-threshold
     const auto number_of_antigens = layers_[0].size();
-    auto titers = std::make_unique<std::vector<titer_merge_data>>();
-    for (auto ag_no : range_from_0_to(number_of_antigens)) {
-        for (auto sr_no : range_from_0_to(number_of_sera_)) {
-            auto [titer, titer_merge_report] = titer_from_layers(ag_no, sr_no, mtt, standard_deviation_threshold);
-            titers->emplace_back(std::move(titer), ag_no, sr_no, titer_merge_report);
+
+    // antigen rows are merged concurrently, merge_titers may throw (dodgy titer in a layer), the first exception is rethrown after the loop
+    std::vector<sparse_row_t> rows(number_of_antigens);
+    std::vector<titer_merge_report> row_reports(report == make_merge_report::yes ? number_of_antigens : 0);
+    std::exception_ptr error;
+#pragma omp parallel for default(shared) schedule(dynamic, 16)
+    for (size_t ag_no = 0; ag_no < number_of_antigens; ++ag_no) {
+        try {
+            titers_from_layers(ag_no, mtt, standard_deviation_threshold, rows[ag_no], row_reports.empty() ? nullptr : &row_reports[ag_no]);
+        }
+        catch (...) {
+#pragma omp critical
+            if (!error)
+                error = std::current_exception();
         }
     }
-
-    if (titers->size() < (number_of_antigens * number_of_sera_ / 2))
-        titers_ = sparse_t(number_of_antigens);
-    else
-        titers_ = dense_t(number_of_antigens * number_of_sera_);
-    // std::cerr << "DEBUG: titers: " << titers.size() << " ag:" << number_of_antigens << " sr: " << number_of_sera_ << '\n';
-    for (const auto& data : *titers) {
-        if (!data.titer.is_dont_care())
-            std::visit([&data,this](auto& target) { this->set_titer(target, data.antigen, data.serum, data.titer); }, titers_);
+    if (error)
+        std::rethrow_exception(error);
+
+    const auto number_of_entries = std::accumulate(rows.begin(), rows.end(), size_t{0}, [](size_t sum, const auto& row) { return sum + row.size(); });
+    if (number_of_entries < (number_of_antigens * number_of_sera_ / 2)) {
+        sparse_t sparse;
+        sparse.reserve(number_of_antigens, number_of_entries);
+        for (const auto& row : rows)
+            sparse.push_back_row(row.begin(), row.end());
+        titers_ = std::move(sparse);
+    }
+    else {
+        dense_t dense(number_of_antigens * number_of_sera_);
+        for (auto ag_no : range_from_0_to(number_of_antigens)) {
+            for (auto& [sr_no, titer] : rows[ag_no])
+                dense[ag_no * number_of_sera_ + sr_no] = std::move(titer);
+        }
+        titers_ = std::move(dense);
     }
 
+    if (row_reports.empty())
+        return nullptr;
+    auto titers = std::make_unique<titer_merge_report>();
+    titers->reserve(std::accumulate(row_reports.begin(), row_reports.end(), size_t{0}, [](size_t sum, const auto& row_report) { return sum + row_report.size(); }));
+    for (auto& row_report : row_reports)
+        std::move(row_report.begin(), row_report.end(), std::back_inserter(*titers));
     return titers;
 
 } // TitersModify::set_titers_from_layers
@@ -1263,18 +1573,40 @@ std::pair<Titer, TitersModify::titer_merge> TitersModify::merge_titers(const std
 
 // ----------------------------------------------------------------------
 
-std::pair<Titer, TitersModify::titer_merge> TitersModify::titer_from_layers(size_t ag_no, size_t sr_no, more_than_thresholded mtt, double standard_deviation_threshold) const
+// merges titers of the antigen for sera present in at least one layer, layer rows are ordered by serum and traversed together
+void TitersModify::titers_from_layers(size_t ag_no, more_than_thresholded mtt, double standard_deviation_threshold, sparse_row_t& row, titer_merge_report* report) const
 {
+    std::vector<std::pair<sparse_row_t::const_iterator, sparse_row_t::const_iterator>> layer_rows;
+    for (const auto& layer : layers_) {
+        if (!layer[ag_no].empty())
+            layer_rows.emplace_back(layer[ag_no].begin(), layer[ag_no].end());
+    }
+
     std::vector<Titer> titers;
-    for (auto layer_no : range_from_0_to(layers_.size())) {
-        if (auto titer = titer_in_sparse_t(layers_[layer_no], ag_no, sr_no); !titer.is_dont_care()) {
-            titers.emplace_back(std::move(titer));
+    for (;;) {
+        auto sr_no = number_of_sera_;
+        for (const auto& [current, last] : layer_rows) {
+            if (current != last)
+                sr_no = std::min(sr_no, current->first);
         }
+        if (sr_no == number_of_sera_)
+            break;
+        titers.clear();
+        for (auto& [current, last] : layer_rows) {
+            if (current != last && current->first == sr_no) {
+                if (!current->second.is_dont_care())
+                    titers.push_back(current->second);
+                ++current;
+            }
+        }
+        auto [titer, merge] = merge_titers(titers, mtt, standard_deviation_threshold);
+        if (report)
+            report->emplace_back(Titer{titer}, ag_no, sr_no, merge);
+        if (!titer.is_dont_care())
+            row.emplace_back(sr_no, std::move(titer));
     }
 
-    return merge_titers(titers, mtt, standard_deviation_threshold);
-
-} // TitersModify::titer_from_layers
+} // TitersModify::titers_from_layers
 
 // ----------------------------------------------------------------------
 
@@ -1363,7 +1695,7 @@ size_t TitersModify::number_of_antigens() const
         if constexpr (std::is_same_v<T, dense_t>)
             return titers.size() / this->number_of_sera_;
         else
-            return titers.size();
+            return titers.number_of_antigens();
     };
     return std::visit(num_ags, titers_);
 
@@ -1378,7 +1710,7 @@ size_t TitersModify::number_of_non_dont_cares() const
         if constexpr (std::is_same_v<T, dense_t>)
             return std::accumulate(titers.begin(), titers.end(), size_t{0}, [](size_t a, const auto& titer) -> size_t { return a + (titer.is_dont_care() ? size_t{0} : size_t{1}); });
         else
-            return std::accumulate(titers.begin(), titers.end(), size_t{0}, [](size_t a, const auto& row) -> size_t { return a + row.size(); });
+            return titers.number_of_entries();
     };
     return std::visit(num_non_dont_cares, titers_);
 
@@ -1386,6 +1718,56 @@ size_t TitersModify::number_of_non_dont_cares() const
 
 // ----------------------------------------------------------------------
 
+void TitersModify::for_each_titer_row(const titer_row_visitor_t& func) const
+{
+    titer_row_t row;
+    auto rows = [&row, &func, this](const auto& titers) {
+        using T = std::decay_t<decltype(titers)>;
+        if constexpr (std::is_same_v<T, dense_t>) {
+            if (this->number_of_sera_ == 0)
+                return;
+            for (size_t antigen_no = 0; antigen_no < (titers.size() / this->number_of_sera_); ++antigen_no) {
+                row.clear();
+                const auto* titer = &titers[antigen_no * this->number_of_sera_];
+                for (size_t serum_no = 0; serum_no < this->number_of_sera_; ++serum_no, ++titer) {
+                    if (!titer->is_dont_care())
+                        row.emplace_back(serum_no, std::string_view{*titer});
+                }
+                if (!row.empty())
+                    func(antigen_no, row);
+            }
+        }
+        else {
+            for (size_t antigen_no = 0; antigen_no < titers.number_of_antigens(); ++antigen_no) {
+                if (const auto source = titers.row(antigen_no); !source.empty()) {
+                    row.clear();
+                    for (const auto& [serum_no, titer] : source)
+                        row.emplace_back(serum_no, std::string_view{titer});
+                    func(antigen_no, row);
+                }
+            }
+        }
+    };
+    std::visit(rows, titers_);
+
+} // TitersModify::for_each_titer_row
+
+// ----------------------------------------------------------------------
+
+PointIndexList TitersModify::having_titers_with(size_t point_no, bool return_point_no) const
+{
+    const auto num_antigens = number_of_antigens();
+    if (point_no < num_antigens || !std::holds_alternative<sparse_t>(titers_))
+        return Titers::having_titers_with(point_no, return_point_no);
+
+    PointIndexList result;
+    std::get<sparse_t>(titers_).for_each_in_column(point_no - num_antigens, [&result](size_t antigen_no, const Titer& /*titer*/) { result.insert(antigen_no); });
+    return result;
+
+} // TitersModify::having_titers_with
+
+// ----------------------------------------------------------------------
+
 size_t TitersModify::titrations_for_antigen(size_t antigen_no) const
 {
     auto num_non_dont_cares = [antigen_no, this](const auto& titers) -> size_t {
@@ -1394,7 +1776,7 @@ size_t TitersModify::titrations_for_antigen(size_t antigen_no) const
             return static_cast<size_t>(
                 std::count_if(&titers[antigen_no * this->number_of_sera_], &titers[(antigen_no + 1) * this->number_of_sera_], [](const Titer& titer) { return !titer.is_dont_care(); }));
         else
-            return titers[antigen_no].size();
+            return titers.row(antigen_no).size();
     };
     return std::visit(num_non_dont_cares, titers_);
 
@@ -1413,14 +1795,8 @@ size_t TitersModify::titrations_for_serum(size_t serum_no) const
                     ++result;
             }
         }
-        else {
-            for (auto& row : titers) {
-                if (auto found = std::lower_bound(row.begin(), row.end(), serum_no, [](const auto& e1, size_t sr_no) { return e1.first < sr_no; }); found != row.end() && found->first == serum_no) {
-                    if (!found->second.is_dont_care())
-                        ++result;
-                }
-            }
-        }
+        else
+            result = titers.titrations_for_serum(serum_no);
         return result;
     };
     return std::visit(num_non_dont_cares, titers_);
@@ -1432,6 +1808,7 @@ size_t TitersModify::titrations_for_serum(size_t serum_no) const
 void TitersModify::titer(size_t aAntigenNo, size_t aSerumNo, const acmacs::chart::Titer& aTiter)
 {
     modifiable_check();
+    invalidate_encoded();
     std::visit([aAntigenNo,aSerumNo,&aTiter,this](auto& titers) { this->set_titer(titers, aAntigenNo, aSerumNo, aTiter); }, titers_);
 
 } // TitersModify::titer
@@ -1441,13 +1818,14 @@ void TitersModify::titer(size_t aAntigenNo, size_t aSerumNo, const acmacs::chart
 void TitersModify::dontcare_for_antigen(size_t aAntigenNo)
 {
     modifiable_check();
+    invalidate_encoded();
     auto set_dontcare = [aAntigenNo, this](auto& titers) {
         using T = std::decay_t<decltype(titers)>;
         if constexpr (std::is_same_v<T, dense_t>) {
             std::fill_n(titers.begin() + static_cast<typename T::difference_type>(aAntigenNo * this->number_of_sera_), this->number_of_sera_, Titer{});
         }
         else {
-            titers[aAntigenNo].clear();
+            titers.clear_row(aAntigenNo);
         }
     };
     return std::visit(set_dontcare, titers_);
@@ -1459,6 +1837,7 @@ void TitersModify::dontcare_for_antigen(size_t aAntigenNo)
 void TitersModify::dontcare_for_serum(size_t aSerumNo)
 {
     modifiable_check();
+    invalidate_encoded();
     auto set_dontcare = [aSerumNo, this](auto& titers) {
         using T = std::decay_t<decltype(titers)>;
         if constexpr (std::is_same_v<T, dense_t>) {
@@ -1466,10 +1845,7 @@ void TitersModify::dontcare_for_serum(size_t aSerumNo)
                 titers[ag_no * this->number_of_sera_ + aSerumNo] = Titer{};
         }
         else {
-            for (auto& row : titers) {
-                if (auto found = std::lower_bound(row.begin(), row.end(), aSerumNo, [](const auto& e1, size_t sr_no) { return e1.first < sr_no; }); found != row.end() && found->first == aSerumNo)
-                    row.erase(found);
-            }
+            titers.modify_if([aSerumNo](size_t /*antigen_no*/, const auto& entry) { return entry.first != aSerumNo; });
         }
     };
     return std::visit(set_dontcare, titers_);
@@ -1481,6 +1857,7 @@ void TitersModify::dontcare_for_serum(size_t aSerumNo)
 void TitersModify::multiply_by_for_antigen(size_t aAntigenNo, double multiply_by)
 {
     modifiable_check();
+    invalidate_encoded();
     auto multiply = [aAntigenNo,multiply_by,this](auto& titers) {
         using T = std::decay_t<decltype(titers)>;
         if constexpr (std::is_same_v<T, dense_t>) {
@@ -1488,7 +1865,7 @@ void TitersModify::multiply_by_for_antigen(size_t aAntigenNo, double multiply_by
             std::for_each(first, first + static_cast<typename T::difference_type>(this->number_of_sera_), [multiply_by](Titer& titer) { titer = titer.multiplied_by(multiply_by); });
         }
         else {
-            std::for_each(titers[aAntigenNo].begin(), titers[aAntigenNo].end(), [multiply_by](sparse_entry_t& entry) { entry.second = entry.second.multiplied_by(multiply_by); });
+            titers.modify_row(aAntigenNo, [multiply_by](Titer& titer) { titer = titer.multiplied_by(multiply_by); });
         }
     };
     return std::visit(multiply, titers_);
@@ -1500,6 +1877,7 @@ void TitersModify::multiply_by_for_antigen(size_t aAntigenNo, double multiply_by
 void TitersModify::multiply_by_for_serum(size_t aSerumNo, double multiply_by)
 {
     modifiable_check();
+    invalidate_encoded();
     const auto multiply = [aSerumNo, multiply_by, this](auto& titers) {
         using T = std::decay_t<decltype(titers)>;
         if constexpr (std::is_same_v<T, dense_t>) {
@@ -1509,10 +1887,11 @@ void TitersModify::multiply_by_for_serum(size_t aSerumNo, double multiply_by)
             }
         }
         else {
-            for (auto& row : titers) {
-                if (auto found = std::lower_bound(row.begin(), row.end(), aSerumNo, [](const auto& e1, size_t sr_no) { return e1.first < sr_no; }); found != row.end() && found->first == aSerumNo)
-                    found->second = found->second.multiplied_by(multiply_by);
-            }
+            titers.modify_if([aSerumNo, multiply_by](size_t /*antigen_no*/, auto& entry) {
+                if (entry.first == aSerumNo)
+                    entry.second = entry.second.multiplied_by(multiply_by);
+                return true;
+            });
         }
     };
     return std::visit(multiply, titers_);
@@ -1524,6 +1903,7 @@ void TitersModify::multiply_by_for_serum(size_t aSerumNo, double multiply_by)
 std::vector<TiterIterator::Data> TitersModify::replace_all(const std::regex& look_for, std::string_view replacement)
 {
     modifiable_check();
+    invalidate_encoded();
     std::vector<TiterIterator::Data> replacements;
     for (const auto& titer_ref : titers_existing()) {
         if (std::smatch match; std::regex_search(titer_ref.titer.get(), match, look_for)) {
@@ -1546,9 +1926,10 @@ std::vector<TiterIterator::Data> TitersModify::replace_all(const std::regex& loo
 // ----------------------------------------------------------------------
 
 // acmacs/backend/antigenic-table.hh setProportionToDontCare()
-void TitersModify::set_proportion_of_titers_to_dont_care(double proportion)
+void TitersModify::set_proportion_of_titers_to_dont_care(double proportion, LayoutRandomizer::seed_t seed)
 {
     modifiable_check();
+    invalidate_encoded();
 
     if (proportion <= 0.0 || proportion > 0.5)
         throw std::invalid_argument(acmacs::string::concat("invalid proportion for set_proportion_of_titers_to_dont_care: ", proportion));
@@ -1559,22 +1940,19 @@ void TitersModify::set_proportion_of_titers_to_dont_care(double proportion)
     for (const auto& titer_ref : titers_existing())
         cells.emplace_back(titer_ref.antigen, titer_ref.serum);
 
-    std::mt19937 generator{std::random_device{}()};
+    std::mt19937 generator{seed ? *seed : std::random_device{}()};
     std::shuffle(cells.begin(), cells.end(), generator);
     const auto entries_to_dont_care = static_cast<size_t>(std::lround(static_cast<double>(cells.size()) * proportion));
     const auto set_to_dont_care = [entries_to_dont_care, &cells, number_of_sera = number_of_sera_](auto& titers) {
-        for (auto index : range_from_0_to(entries_to_dont_care)) {
-            const auto ag_no = cells[index].first, sr_no = cells[index].second;
-            using T = std::decay_t<decltype(titers)>;
-            if constexpr (std::is_same_v<T, dense_t>) {
-                titers[ag_no * number_of_sera + sr_no] = Titer{};
-            }
-            else {
-                if (auto& row = titers[ag_no]; !row.empty()) {
-                    if (auto found = std::lower_bound(row.begin(), row.end(), sr_no, [](const auto& e1, size_t sr_no_1) { return e1.first < sr_no_1; }); found != row.end() && found->first == sr_no)
-                        row.erase(found);
-                }
-            }
+        using T = std::decay_t<decltype(titers)>;
+        if constexpr (std::is_same_v<T, dense_t>) {
+            for (auto index : range_from_0_to(entries_to_dont_care))
+                titers[cells[index].first * number_of_sera + cells[index].second] = Titer{};
+        }
+        else {
+            cells.resize(entries_to_dont_care);
+            std::sort(cells.begin(), cells.end());
+            titers.modify_if([&cells](size_t antigen_no, const auto& entry) { return !std::binary_search(cells.begin(), cells.end(), std::pair{antigen_no, entry.first}); });
         }
     };
     std::visit(set_to_dont_care, titers_);
@@ -1585,7 +1963,8 @@ void TitersModify::set_proportion_of_titers_to_dont_care(double proportion)
 
 void TitersModify::remove_antigens(const ReverseSortedIndexes& indexes)
 {
-    auto do_remove_antigens_sparse = [&indexes](auto& titers) { acmacs::remove(indexes, titers); };
+    invalidate_encoded();
+    auto do_remove_antigens_layer = [&indexes](auto& titers) { acmacs::remove(indexes, titers); };
 
     auto do_remove_antigens_dense = [&indexes, this](auto& titers) {
         for (auto index : indexes) {
@@ -1594,17 +1973,17 @@ void TitersModify::remove_antigens(const ReverseSortedIndexes& indexes)
         }
     };
 
-    auto do_remove_antigens = [&do_remove_antigens_sparse, &do_remove_antigens_dense](auto& titers) {
+    auto do_remove_antigens = [&indexes, &do_remove_antigens_dense](auto& titers) {
         using T = std::decay_t<decltype(titers)>;
         if constexpr (std::is_same_v<T, dense_t>)
             do_remove_antigens_dense(titers);
         else
-            do_remove_antigens_sparse(titers);
+            titers.remove_antigens(indexes);
     };
 
     std::visit(do_remove_antigens, titers_);
     for (auto& layer : layers_)
-        do_remove_antigens_sparse(layer);
+        do_remove_antigens_layer(layer);
 
 } // TitersModify::remove_antigens
 
@@ -1613,19 +1992,18 @@ void TitersModify::remove_antigens(const ReverseSortedIndexes& indexes)
 void TitersModify::insert_antigen(size_t before)
 {
     modifiable_check();
-
-    auto do_insert_antigen_sparse = [before](auto& titers) { titers.insert(titers.begin() + static_cast<Indexes::difference_type>(before), sparse_row_t{}); };
+    invalidate_encoded();
 
     auto do_insert_antigen_dense = [before, this](auto& titers) {
         titers.insert(titers.begin() + static_cast<Indexes::difference_type>(before * this->number_of_sera_), this->number_of_sera_, Titer{});
     };
 
-    auto do_insert_antigen = [&do_insert_antigen_sparse, &do_insert_antigen_dense](auto& titers) {
+    auto do_insert_antigen = [before, &do_insert_antigen_dense](auto& titers) {
         using T = std::decay_t<decltype(titers)>;
         if constexpr (std::is_same_v<T, dense_t>)
             do_insert_antigen_dense(titers);
         else
-            do_insert_antigen_sparse(titers);
+            titers.insert_antigen(before);
     };
 
     std::visit(do_insert_antigen, titers_);
@@ -1636,7 +2014,8 @@ void TitersModify::insert_antigen(size_t before)
 
 void TitersModify::remove_sera(const ReverseSortedIndexes& indexes)
 {
-    auto do_remove_sera_sparse = [&indexes](auto& titers) {
+    invalidate_encoded();
+    auto do_remove_sera_layer = [&indexes](auto& titers) {
         for (auto& row : titers) {
             for (auto index : indexes) {
                   // remove entry for index, then renumber entries for >index
@@ -1658,17 +2037,17 @@ void TitersModify::remove_sera(const ReverseSortedIndexes& indexes)
         }
     };
 
-    auto do_remove_sera = [&do_remove_sera_sparse, &do_remove_sera_dense](auto& titers) {
+    auto do_remove_sera = [&indexes, &do_remove_sera_dense](auto& titers) {
         using T = std::decay_t<decltype(titers)>;
         if constexpr (std::is_same_v<T, dense_t>)
             do_remove_sera_dense(titers);
         else
-            do_remove_sera_sparse(titers);
+            titers.remove_sera(indexes);
     };
 
     std::visit(do_remove_sera, titers_);
     for (auto& layer : layers_)
-        do_remove_sera_sparse(layer);
+        do_remove_sera_layer(layer);
 
     number_of_sera_ -= indexes.size();
 
@@ -1679,14 +2058,7 @@ void TitersModify::remove_sera(const ReverseSortedIndexes& indexes)
 void TitersModify::insert_serum(size_t before)
 {
     modifiable_check();
-
-    auto do_insert_serum_sparse = [before](auto& titers) {
-        // renumber serum entries with indexes >= before
-        for (auto& row : titers) {
-            for (auto it = std::lower_bound(row.begin(), row.end(), before, [](const auto&e1, size_t sr_no) { return e1.first < sr_no; }); it != row.end(); ++it)
-                ++it->first;
-        }
-    };
+    invalidate_encoded();
 
     auto do_insert_serum_dense = [before, this](auto& titers) {
         using diff_t = Indexes::difference_type;
@@ -1694,12 +2066,12 @@ void TitersModify::insert_serum(size_t before)
             titers.insert(titers.begin() + ag_no * static_cast<diff_t>(this->number_of_sera_) + static_cast<diff_t>(before), Titer{});
     };
 
-    auto do_insert_serum = [&do_insert_serum_sparse, &do_insert_serum_dense](auto& titers) {
+    auto do_insert_serum = [before, &do_insert_serum_dense](auto& titers) {
         using T = std::decay_t<decltype(titers)>;
         if constexpr (std::is_same_v<T, dense_t>)
             do_insert_serum_dense(titers);
         else
-            do_insert_serum_sparse(titers);
+            titers.insert_serum(before);
     };
 
     std::visit(do_insert_serum, titers_);
@@ -2052,6 +2424,23 @@ ProcrustesData ProjectionModify::orient_to(const Projection& master)
 
 // ----------------------------------------------------------------------
 
+std::vector<ProcrustesData> ChartModify::orient_projections_to(const Projection& master, int threads)
+{
+    acmacs::chart::CommonAntigensSera common(master.chart(), *this, CommonAntigensSera::match_level_t::automatic);
+    auto& projections = projections_modify();
+    // layouts are obtained sequentially, layout() of modified projection may fill cache
+    std::vector<std::shared_ptr<Layout>> layouts(projections.size());
+    for (size_t projection_no = 0; projection_no < projections.size(); ++projection_no)
+        layouts[projection_no] = projections.at(projection_no)->layout();
+    auto procrustes_data = procrustes(master, layouts, common.points(), procrustes_scaling_t::no, threads);
+    for (size_t projection_no = 0; projection_no < projections.size(); ++projection_no)
+        projections.at(projection_no)->transformation(procrustes_data[projection_no].transformation);
+    return procrustes_data;
+
+} // ChartModify::orient_projections_to
+
+// ----------------------------------------------------------------------
+
 void ProjectionModifyNew::connect(const PointIndexList& to_connect)
 {
     for (auto point_no: to_connect) {
@@ -2,6 +2,8 @@
 
 #include <variant>
 #include <memory>
+#include <mutex>
+#include <atomic>
 
 #include "acmacs-base/regex.hh"
 #include "acmacs-chart-2/chart.hh"
@@ -22,6 +24,7 @@ namespace acmacs::chart
     class TitersModify;
     class ColumnBasesModify;
     class ProjectionModify;
+    class ProjectionModifyNew;
     class ProjectionsModify;
     class PlotSpecModify;
 
@@ -76,11 +79,30 @@ namespace acmacs::chart
         std::pair<optimization_status, ProjectionModifyP> relax(MinimumColumnBasis minimum_column_basis, number_of_dimensions_t number_of_dimensions, use_dimension_annealing dimension_annealing,
                                                                 const optimization_options& options, LayoutRandomizer::seed_t seed = std::nullopt,
                                                                 const DisconnectedPoints& disconnect_points = {});
-        void relax(number_of_optimizations_t number_of_optimizations, MinimumColumnBasis minimum_column_basis, number_of_dimensions_t number_of_dimensions, use_dimension_annealing dimension_annealing,
-                   const optimization_options& options, const DisconnectedPoints& disconnect_points = {});
+        // returns status of each optimization in the order of new projections (before sorting), with trace if options.trace_capacity > 0
+        std::vector<optimization_status> relax(number_of_optimizations_t number_of_optimizations, MinimumColumnBasis minimum_column_basis, number_of_dimensions_t number_of_dimensions, use_dimension_annealing dimension_annealing,
+                   const optimization_options& options, const DisconnectedPoints& disconnect_points = {}, LayoutRandomizer::seed_t seed = std::nullopt);
+
+        // relax(number_of_optimizations_t, ...) split into steps, to schedule optimizations of several charts on one thread pool (see relax-batch.hh)
+        struct relax_prepared_t
+        {
+            Stress stress;
+            std::shared_ptr<LayoutRandomizer> randomizer;
+            number_of_dimensions_t start_number_of_dimensions;
+            number_of_dimensions_t number_of_dimensions;
+            std::vector<std::shared_ptr<ProjectionModifyNew>> projections; // added to the chart, not yet randomized
+        };
+        relax_prepared_t relax_prepare(number_of_optimizations_t number_of_optimizations, MinimumColumnBasis minimum_column_basis, number_of_dimensions_t number_of_dimensions,
+                                       use_dimension_annealing dimension_annealing, const optimization_options& options, const DisconnectedPoints& disconnect_points = {},
+                                       LayoutRandomizer::seed_t seed = std::nullopt);
+        // randomizes and optimizes prepared.projections[projection_index], stress is a thread local copy of prepared.stress (number of dimensions is changed)
+        optimization_status relax_prepared(const relax_prepared_t& prepared, size_t projection_index, Stress& stress, const optimization_options& options);
+
         void relax_incremental(size_t source_projection_no, number_of_optimizations_t number_of_optimizations, const optimization_options& options,
                                remove_source_projection rsp = remove_source_projection::yes, unmovable_non_nan_points unnp = unmovable_non_nan_points::no);
         void relax_projections(const optimization_options& options, size_t first_projection_no, const DisconnectedPoints& disconnect_points = {});
+        // orients all projections to master (procrustes without scaling), projections are processed in parallel, returns procrustes data in the order of projections
+        std::vector<ProcrustesData> orient_projections_to(const Projection& master, int threads = 0);
 
         void remove_layers();
         void remove_antigens(const ReverseSortedIndexes& indexes);
@@ -368,15 +390,132 @@ namespace acmacs::chart
         titers_cannot_be_modified() : std::runtime_error("titers cannot be modified (table has layers?)") {}
     };
 
+    // Titers in compressed sparse row form: entries of antigen ag_no are entries_[row_offsets_[ag_no], row_offsets_[ag_no + 1]), ordered by serum, no dont-care entries.
+    // set() adding or removing entries only stages the change, staged changes are merged into the rows in one pass upon the next access.
+    // Compressed sparse column index (antigens titrated with each serum) is built on the first per serum query and dropped upon structural modification.
+    class SparseTiters
+    {
+      public:
+        using entry_t = std::pair<size_t, Titer>; // serum no, titer
+        using const_iterator = std::vector<entry_t>::const_iterator;
+
+        struct row_t
+        {
+            const_iterator first, last;
+            const_iterator begin() const { return first; }
+            const_iterator end() const { return last; }
+            bool empty() const { return first == last; }
+            size_t size() const { return static_cast<size_t>(last - first); }
+        };
+
+        SparseTiters() : row_offsets_(1, 0) {}
+        explicit SparseTiters(size_t number_of_antigens) : row_offsets_(number_of_antigens + 1, 0) {}
+        SparseTiters(const SparseTiters& rhs);
+        SparseTiters(SparseTiters&& rhs);
+        SparseTiters& operator=(const SparseTiters& rhs);
+        SparseTiters& operator=(SparseTiters&& rhs);
+
+        size_t number_of_antigens() const { return row_offsets_.size() - 1; }
+        size_t number_of_entries() const { apply_pending(); return entries_.size(); }
+        row_t row(size_t antigen_no) const { apply_pending(); return {entries_.begin() + offset(antigen_no), entries_.begin() + offset(antigen_no + 1)}; }
+        Titer titer(size_t antigen_no, size_t serum_no) const;
+        size_t titrations_for_serum(size_t serum_no) const;
+
+        // func(size_t antigen_no, const Titer& titer) for antigens titrated with the serum in antigen order
+        template <typename F> void for_each_in_column(size_t serum_no, F&& func) const
+        {
+            const auto cols = columns();
+            if (serum_no + 1 < cols->offsets.size()) {
+                for (auto index = cols->offsets[serum_no]; index < cols->offsets[serum_no + 1]; ++index)
+                    func(cols->antigens[index], entries_[cols->entries[index]].second);
+            }
+        }
+
+        // appends a row for the next antigen, entries (serum_no, titer) must be ordered by serum, dont-cares are skipped
+        template <typename Iter> void push_back_row(Iter first, Iter last)
+        {
+            apply_pending();
+            for (; first != last; ++first) {
+                if (Titer titer{first->second}; !titer.is_dont_care())
+                    entries_.emplace_back(first->first, std::move(titer));
+            }
+            row_offsets_.push_back(entries_.size());
+            reset_columns();
+        }
+
+        void reserve(size_t number_of_antigens, size_t number_of_entries) { apply_pending(); row_offsets_.reserve(number_of_antigens + 1); entries_.reserve(number_of_entries); }
+        void resize(size_t number_of_antigens); // appends empty rows or removes last rows
+        void set(size_t antigen_no, size_t serum_no, const Titer& titer); // dont-care titer removes entry, the last set() for the same titer wins
+        void clear_row(size_t antigen_no);
+        void insert_antigen(size_t before);
+        void remove_antigens(const ReverseSortedIndexes& indexes);
+        void insert_serum(size_t before);
+        void remove_sera(const ReverseSortedIndexes& indexes);
+
+        // func(Titer& titer), modification must not turn titer into dont-care
+        template <typename F> void modify_row(size_t antigen_no, F&& func)
+        {
+            apply_pending();
+            std::for_each(entries_.begin() + offset(antigen_no), entries_.begin() + offset(antigen_no + 1), [&func](entry_t& entry) { func(entry.second); });
+        }
+
+        // func(size_t antigen_no, entry_t& entry) -> bool: entry is kept if func returns true, func may change serum number keeping order of sera in the row
+        template <typename F> void modify_if(F&& func)
+        {
+            apply_pending();
+            size_t target{0};
+            for (size_t antigen_no = 0; antigen_no < number_of_antigens(); ++antigen_no) {
+                const auto first = row_offsets_[antigen_no], last = row_offsets_[antigen_no + 1];
+                row_offsets_[antigen_no] = target;
+                for (auto index = first; index < last; ++index) {
+                    if (func(antigen_no, entries_[index])) {
+                        if (target != index)
+                            entries_[target] = std::move(entries_[index]);
+                        ++target;
+                    }
+                }
+            }
+            row_offsets_.back() = target;
+            entries_.erase(entries_.begin() + static_cast<std::ptrdiff_t>(target), entries_.end());
+            reset_columns();
+        }
+
+      private:
+        struct Columns
+        {
+            std::vector<size_t> offsets;  // number_of_sera + 1
+            std::vector<size_t> antigens; // antigen of each column entry
+            std::vector<size_t> entries;  // index in entries_ of each column entry
+        };
+
+        mutable std::vector<entry_t> entries_;
+        mutable std::vector<size_t> row_offsets_;
+        mutable std::vector<std::pair<size_t, entry_t>> pending_; // antigen no, entry: set() calls adding or removing entries, in call order
+        mutable std::atomic<bool> has_pending_{false};
+        mutable std::mutex pending_access_;
+        mutable std::mutex columns_access_;
+        mutable std::shared_ptr<const Columns> columns_;
+
+        std::ptrdiff_t offset(size_t antigen_no) const { return static_cast<std::ptrdiff_t>(row_offsets_[antigen_no]); }
+        void apply_pending() const { if (has_pending_.load(std::memory_order_acquire)) merge_pending(); }
+        void merge_pending() const;
+        std::shared_ptr<const Columns> columns() const;
+        void reset_columns();
+
+    }; // class SparseTiters
+
+    // ----------------------------------------------------------------------
+
     class TitersModify : public Titers
     {
       public:
         using dense_t = std::vector<Titer>;
+        using sparse_t = SparseTiters;
         using sparse_entry_t = std::pair<size_t, Titer>; // serum no, titer
         using sparse_row_t = std::vector<sparse_entry_t>;
-        using sparse_t = std::vector<sparse_row_t>; // size = number_of_antigens
+        using layer_t = std::vector<sparse_row_t>; // size = number_of_antigens, layers are filled titer by titer (merging), rows are cheaper to insert into than CSR
         using titers_t = std::variant<dense_t, sparse_t>;
-        using layers_t = std::vector<sparse_t>;
+        using layers_t = std::vector<layer_t>;
 
         enum class titer_merge {
             all_dontcare,
@@ -400,9 +539,10 @@ namespace acmacs::chart
             titer_merge report;
         };
 
-        using titer_merge_report = std::vector<titer_merge_data>;
+        using titer_merge_report = std::vector<titer_merge_data>; // ordered by antigen then serum, cells having no titer in any layer are not reported
 
         enum class more_than_thresholded { adjust_to_next, to_dont_care };
+        enum class make_merge_report { no, yes };
 
         // ----------------------------------------------------------------------
 
@@ -415,6 +555,8 @@ namespace acmacs::chart
         size_t number_of_non_dont_cares() const override;
         size_t titrations_for_antigen(size_t antigen_no) const override;
         size_t titrations_for_serum(size_t serum_no) const override;
+        void for_each_titer_row(const titer_row_visitor_t& func) const override;
+        PointIndexList having_titers_with(size_t point_no, bool return_point_no = true) const override;
 
         bool modifiable() const noexcept { return layers_.empty(); }
         void modifiable_check() const
@@ -428,7 +570,7 @@ namespace acmacs::chart
         void dontcare_for_serum(size_t aSerumNo);
         void multiply_by_for_antigen(size_t aAntigenNo, double multiply_by);
         void multiply_by_for_serum(size_t aSerumNo, double multiply_by);
-        void set_proportion_of_titers_to_dont_care(double proportion);
+        void set_proportion_of_titers_to_dont_care(double proportion, LayoutRandomizer::seed_t seed = std::nullopt); // random selection if seed is not set
         // replace all titers matching look_for (via regex_search) with replacement, replacement may contain substitutions $`, $', $1, etc.
         // returns list of the replacements performed
         std::vector<TiterIterator::Data> replace_all(const std::regex& look_for, std::string_view replacement);
@@ -448,7 +590,8 @@ namespace acmacs::chart
         void remove_layers();
         void create_layers(size_t number_of_layers, size_t number_of_antigens);
         void titer(size_t aAntigenNo, size_t aSerumNo, size_t aLayerNo, const Titer& aTiter);
-        std::unique_ptr<titer_merge_report> set_from_layers(ChartModify& chart);
+        // returns nullptr if report is not requested
+        std::unique_ptr<titer_merge_report> set_from_layers(ChartModify& chart, make_merge_report report = make_merge_report::yes);
 
         static std::pair<Titer, titer_merge> merge_titers(const std::vector<Titer>& titers, more_than_thresholded mtt, double standard_deviation_threshold);
         static std::string titer_merge_report_brief(titer_merge data);
@@ -463,13 +606,14 @@ namespace acmacs::chart
         bool layer_titer_modified_ = false; // force titer recalculation
 
         static Titer find_titer_for_serum(const sparse_row_t& aRow, size_t aSerumNo);
-        static Titer titer_in_sparse_t(const sparse_t& aSparse, size_t aAntigenNo, size_t aSerumNo);
+        static Titer titer_in_layer(const layer_t& aLayer, size_t aAntigenNo, size_t aSerumNo);
 
         void set_titer(dense_t& titers, size_t aAntigenNo, size_t aSerumNo, const Titer& aTiter) { titers[aAntigenNo * number_of_sera_ + aSerumNo] = aTiter; }
-        void set_titer(sparse_t& titers, size_t aAntigenNo, size_t aSerumNo, const Titer& aTiter);
+        void set_titer(sparse_t& titers, size_t aAntigenNo, size_t aSerumNo, const Titer& aTiter) { titers.set(aAntigenNo, aSerumNo, aTiter); }
+        void set_titer(layer_t& layer, size_t aAntigenNo, size_t aSerumNo, const Titer& aTiter);
 
-        std::unique_ptr<titer_merge_report> set_titers_from_layers(more_than_thresholded mtt);
-        std::pair<Titer, titer_merge> titer_from_layers(size_t ag_no, size_t sr_no, more_than_thresholded mtt, double standard_deviation_threshold) const;
+        std::unique_ptr<titer_merge_report> set_titers_from_layers(more_than_thresholded mtt, make_merge_report report);
+        void titers_from_layers(size_t ag_no, more_than_thresholded mtt, double standard_deviation_threshold, sparse_row_t& row, titer_merge_report* report) const;
 
     }; // class TitersModify
 
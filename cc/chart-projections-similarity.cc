@@ -0,0 +1,65 @@
+#include "acmacs-base/argv.hh"
+#include "acmacs-base/timeit.hh"
+#include "acmacs-chart-2/factory-import.hh"
+#include "acmacs-chart-2/chart.hh"
+#include "acmacs-chart-2/procrustes.hh"
+#include "acmacs-chart-2/log.hh"
+
+// ----------------------------------------------------------------------
+
+using namespace acmacs::argv;
+struct Options : public argv
+{
+    Options(int a_argc, const char* const a_argv[], on_error on_err = on_error::exit) : argv() { parse(a_argc, a_argv, on_err); }
+    std::string_view help_pre() const override { return "Computes procrustes rms between all pairs of projections of the chart and clusters projections into basins\n"; }
+
+    option<double> threshold{*this, "threshold", dflt{0.5}, desc{"procrustes rms threshold for projections to be in the same cluster"}};
+    option<bool>   matrix{*this, "matrix", desc{"print rms matrix, otherwise rms calculation for a pair is stopped as soon as it is above threshold"}};
+    option<int>    threads{*this, "threads", dflt{0}, desc{"number of threads to use (omp): 0 - autodetect, 1 - sequential"}};
+    option<str_array> verbose{*this, 'v', "verbose", desc{"comma separated list (or multiple switches) of enablers"}};
+
+    argument<str> chart{*this, arg_name{"chart"}, mandatory};
+};
+
+int main(int argc, char* const argv[])
+{
+    int exit_code = 0;
+    try {
+        Options opt(argc, argv);
+        acmacs::log::enable(opt.verbose);
+        auto chart = acmacs::chart::import_from_file(opt.chart);
+        const auto similarity = [&]() {
+            const Timeit ti{fmt::format("procrustes between {} projections: ", chart->number_of_projections())};
+            return acmacs::chart::projections_similarity(*chart, opt.matrix ? std::numeric_limits<double>::infinity() : *opt.threshold, opt.threads);
+        }();
+
+        if (opt.matrix) {
+            for (size_t p1 = 0; p1 < similarity.number_of_projections; ++p1) {
+                fmt::print("{:4d}", p1);
+                for (size_t p2 = 0; p2 < similarity.number_of_projections; ++p2)
+                    fmt::print(" {:7.4f}", similarity(p1, p2));
+                fmt::print("\n");
+            }
+            fmt::print("\n");
+        }
+
+        const auto clusters = acmacs::chart::projections_clusters(*chart, similarity, opt.threshold);
+        fmt::print("clusters: {} (projections: {} rms threshold: {})\n", clusters.size(), similarity.number_of_projections, *opt.threshold);
+        for (const auto& cluster : clusters) {
+            fmt::print("{:4d} stress: {:10.4f} size: {:4d} projections:", cluster.representative, cluster.stress, cluster.projections.size());
+            for (const auto projection_no : cluster.projections)
+                fmt::print(" {}", projection_no);
+            fmt::print("\n");
+        }
+    }
+    catch (std::exception& err) {
+        AD_ERROR("{}", err);
+        exit_code = 2;
+    }
+    return exit_code;
+}
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
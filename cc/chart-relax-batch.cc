@@ -0,0 +1,52 @@
+#include "acmacs-base/argv.hh"
+#include "acmacs-base/timeit.hh"
+#include "acmacs-chart-2/relax-batch.hh"
+#include "acmacs-chart-2/log.hh"
+
+// ----------------------------------------------------------------------
+
+using namespace acmacs::argv;
+
+struct Options : public argv
+{
+    Options(int a_argc, const char* const a_argv[], on_error on_err = on_error::exit) : argv() { parse(a_argc, a_argv, on_err); }
+
+    option<int>    threads{*this, "threads", dflt{0}, desc{"number of threads to use for loading charts and optimization (omp): 0 - autodetect, 1 - sequential"}};
+    option<str_array> verbose{*this, 'v', "verbose", desc{"comma separated list (or multiple switches) of enablers"}};
+
+    argument<str>  manifest{*this, arg_name{"manifest.json"}, mandatory, desc{"json with the list of jobs, see relax-batch.hh for the format"}};
+};
+
+int main(int argc, char* const argv[])
+{
+    int exit_code = 0;
+    try {
+        Options opt(argc, argv);
+        acmacs::log::enable(opt.verbose);
+
+        Timeit ti("relax batch: ");
+        const auto jobs = acmacs::chart::read_relax_jobs(opt.manifest);
+        const auto results = acmacs::chart::relax_batch(jobs, opt.threads, opt.program_name());
+        for (size_t job_no = 0; job_no < jobs.size(); ++job_no) {
+            const auto& result = results[job_no];
+            if (!result.error.empty()) {
+                AD_ERROR("{}: {}", jobs[job_no].source, result.error);
+                exit_code = 1;
+            }
+            else if (result.best_stress.has_value())
+                fmt::print("{:4d} {:.4f} {} {}\n", job_no, *result.best_stress, jobs[job_no].output, acmacs::format_duration(result.time));
+            else
+                fmt::print("{:4d} no projections {} {}\n", job_no, jobs[job_no].output, acmacs::format_duration(result.time));
+        }
+    }
+    catch (std::exception& err) {
+        AD_ERROR("{}", err);
+        exit_code = 2;
+    }
+    return exit_code;
+}
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -7,6 +7,7 @@
 #include "acmacs-chart-2/factory-import.hh"
 #include "acmacs-chart-2/factory-export.hh"
 #include "acmacs-chart-2/chart-modify.hh"
+#include "acmacs-chart-2/basin-hopping.hh"
 
 // ----------------------------------------------------------------------
 
@@ -19,10 +20,20 @@ struct Options : public argv
     option<int>    projection{*this, "projection", dflt{0}, desc{"-1 to relax all"}};
     option<bool>   rough{*this, "rough"};
     option<bool>   sort{*this, "sort", desc{"sort projections"}};
-    option<str>    method{*this, "method", dflt{"alglib-cg"}, desc{"method: alglib-lbfgs, alglib-cg, optim-bfgs, optim-differential-evolution"}};
+    option<str>    method{*this, "method", dflt{"alglib-cg"}, desc{"method: alglib-lbfgs, alglib-cg, sgd-adam, newton-block, optim-bfgs, optim-differential-evolution"}};
     option<double> max_distance_multiplier{*this, "md", dflt{1.0}, desc{"max distance multiplier"}};
     option<bool>   report_time{*this, "time", desc{"report time of loading chart"}};
 
+    option<bool>   basin_hopping{*this, "basin-hopping", desc{"improve projection by perturbing subsets of points and re-optimizing in parallel chains"}};
+    option<size_t> bh_hops{*this, "bh-hops", dflt{100UL}, desc{"basin hopping: number of hops per chain"}};
+    option<size_t> bh_chains{*this, "bh-chains", dflt{0UL}, desc{"basin hopping: number of chains, 0 - number of threads"}};
+    option<size_t> bh_points{*this, "bh-points", dflt{5UL}, desc{"basin hopping: number of points to perturb in each hop"}};
+    option<double> bh_radius{*this, "bh-radius", dflt{1.0}, desc{"basin hopping: max displacement of a perturbed point"}};
+    option<str>    bh_perturbation{*this, "bh-perturbation", dflt{"mixed"}, desc{"basin hopping: worst (high contribution points), random (random clusters), mixed"}};
+    option<double> bh_temperature{*this, "bh-temperature", dflt{0.0}, desc{"basin hopping: Metropolis temperature, 0 - accept improvements only"}};
+    option<unsigned> seed{*this, "seed", desc{"basin hopping: seed for perturbations"}};
+    option<int>    threads{*this, "threads", dflt{0}, desc{"number of threads to use for basin hopping (omp): 0 - autodetect, 1 - sequential"}};
+
     argument<str>  source_chart{*this, arg_name{"source-chart"}, mandatory};
     argument<str>  output_chart{*this, arg_name{"output-chart"}};
 };
@@ -39,10 +50,35 @@ int main(int argc, char* const argv[])
             throw std::runtime_error("chart has no projections");
         const auto precision = opt.rough ? acmacs::chart::optimization_precision::rough : acmacs::chart::optimization_precision::fine;
         const acmacs::chart::optimization_method method{acmacs::chart::optimization_method_from_string(opt.method)};
-        auto relax = [&chart, method, precision](size_t proj_no) {
+        acmacs::chart::basin_hopping_options bh_options;
+        if (opt.basin_hopping) {
+            bh_options.hops = opt.bh_hops;
+            bh_options.chains = opt.bh_chains;
+            bh_options.points_to_perturb = opt.bh_points;
+            bh_options.perturbation_radius = opt.bh_radius;
+            bh_options.temperature = opt.bh_temperature;
+            bh_options.threads = opt.threads;
+            if (opt.seed.has_value())
+                bh_options.seed = *opt.seed;
+            if (*opt.bh_perturbation == "worst")
+                bh_options.perturbation = acmacs::chart::basin_hopping_perturbation::worst_contribution;
+            else if (*opt.bh_perturbation == "random")
+                bh_options.perturbation = acmacs::chart::basin_hopping_perturbation::random_cluster;
+            else if (*opt.bh_perturbation == "mixed")
+                bh_options.perturbation = acmacs::chart::basin_hopping_perturbation::mixed;
+            else
+                throw std::runtime_error{fmt::format("unrecognized --bh-perturbation: \"{}\", expected: worst, random, mixed", *opt.bh_perturbation)};
+        }
+        auto relax = [&chart, method, precision, &opt, &bh_options](size_t proj_no) {
             auto projection = chart.projection_modify(proj_no);
-            const auto status = projection->relax(acmacs::chart::optimization_options(method, precision));
-            fmt::print("{}\n", status);
+            if (opt.basin_hopping) {
+                const auto status = acmacs::chart::basin_hopping(*projection, acmacs::chart::optimization_options(method, precision), bh_options);
+                fmt::print("{}\n", status);
+            }
+            else {
+                const auto status = projection->relax(acmacs::chart::optimization_options(method, precision));
+                fmt::print("{}\n", status);
+            }
         };
         if (opt.projection >= 0) {
             if (static_cast<size_t>(opt.projection) >= chart.number_of_projections())
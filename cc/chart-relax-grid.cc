@@ -24,7 +24,10 @@ struct Options : public argv
     option<str>    reorient{*this, "reorient", dflt{""}, desc{"chart to re-orient resulting projections to"}};
     option<str>    grid_json{*this, "grid-json", desc{"export grid test results into json"}};
     option<double> grid_step{*this, "step", dflt{0.1}};
-    option<str>    method{*this, "method", dflt{"alglib-cg"}, desc{"method: alglib-lbfgs, alglib-cg, optim-bfgs, optim-differential-evolution"}};
+    option<bool>   grid_adaptive{*this, "grid-adaptive", desc{"grid test: coarse scan, then fine scan around the best coarse cells only"}};
+    option<bool>   grid_local{*this, "grid-local", desc{"grid test: score candidate moves by optimizing the moved point neighbourhood, whole layout for trapped points only"}};
+    option<size_t> grid_local_hops{*this, "grid-local-hops", dflt{1UL}, desc{"--grid-local: neighbourhood size in table distance links"}};
+    option<str>    method{*this, "method", dflt{"alglib-cg"}, desc{"method: alglib-lbfgs, alglib-cg, sgd-adam, newton-block, optim-bfgs, optim-differential-evolution"}};
     option<bool>   dimension_annealing{*this, "dimension-annealing"};
     option<double> max_distance_multiplier{*this, "md", dflt{2.0}, desc{"randomization diameter multiplier"}};
     option<size_t> keep_projections{*this, "keep-projections", dflt{0UL}, desc{"number of projections to keep, 0 - keep all"}};
@@ -77,19 +80,16 @@ int main(int argc, char* const argv[])
         }
 
         const size_t projection_no_to_test = 0, relax_attempts = 20;
-        const auto [grid_results, grid_projections] = acmacs::chart::grid_test(chart, projection_no_to_test, opt.grid_step, opt.threads, relax_attempts, opt.grid_json);
+        const auto [grid_results, grid_projections] = acmacs::chart::grid_test(chart, projection_no_to_test, opt.grid_step, opt.threads, relax_attempts, opt.grid_json,
+                                                                               opt.grid_adaptive ? acmacs::chart::grid_search::adaptive : acmacs::chart::grid_search::uniform,
+                                                                               opt.grid_local ? acmacs::chart::grid_refine::local : acmacs::chart::grid_refine::full, opt.grid_local_hops);
         AD_PRINT_NEWLINE();
 
         if (const size_t keep_projections = opt.keep_projections; keep_projections > 0 && projections.size() > (keep_projections + grid_projections))
             projections.keep_just(keep_projections + grid_projections);
 
         if (opt.output_chart.has_value() && !opt.reorient->empty()) {
-            acmacs::chart::CommonAntigensSera common(*master, chart, acmacs::chart::CommonAntigensSera::match_level_t::automatic);
-            auto master_projection = master->projection(0);
-            for (auto projection_to_reorient : acmacs::filled_with_indexes(chart.number_of_projections())) {
-                const auto procrustes_data = acmacs::chart::procrustes(*master_projection, *chart.projection(projection_to_reorient), common.points(), acmacs::chart::procrustes_scaling_t::no);
-                chart.projection_modify(projection_to_reorient)->transformation(procrustes_data.transformation);
-            }
+            chart.orient_projections_to(*master->projection(0), opt.threads);
         }
 
         fmt::print("{}\n", chart.make_info());
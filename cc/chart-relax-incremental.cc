@@ -22,7 +22,10 @@ struct Options : public argv
     option<bool>   grid{*this, "grid-test"};
     option<str>    grid_json{*this, "grid-json", desc{"export grid test results into json"}};
     option<double> grid_step{*this, "grid-step", dflt{0.1}};
-    option<str>    method{*this, "method", dflt{"alglib-cg"}, desc{"method: alglib-lbfgs, alglib-cg, optim-bfgs, optim-differential-evolution"}};
+    option<bool>   grid_adaptive{*this, "grid-adaptive", desc{"grid test: coarse scan, then fine scan around the best coarse cells only"}};
+    option<bool>   grid_local{*this, "grid-local", desc{"grid test: score candidate moves by optimizing the moved point neighbourhood, whole layout for trapped points only"}};
+    option<size_t> grid_local_hops{*this, "grid-local-hops", dflt{1UL}, desc{"--grid-local: neighbourhood size in table distance links"}};
+    option<str>    method{*this, "method", dflt{"alglib-cg"}, desc{"method: alglib-lbfgs, alglib-cg, sgd-adam, newton-block, optim-bfgs, optim-differential-evolution"}};
     option<double> randomization_diameter_multiplier{*this, "md", dflt{2.0}, desc{"randomization diameter multiplier"}};
     option<size_t> keep_projections{*this, "keep-projections", dflt{0ul}, desc{"number of projections to keep, 0 - keep all"}};
     option<int>    threads{*this, "threads", dflt{0}};
@@ -54,7 +57,9 @@ int main(int argc, char* const argv[])
         if (opt.grid) {
             acmacs::chart::GridTest::Results grid_results;
             const size_t projection_no_to_test{0}, relax_attempts{20};
-            std::tie(grid_results, grid_projections) = acmacs::chart::grid_test(chart, projection_no_to_test, opt.grid_step, opt.threads, relax_attempts, opt.grid_json);
+            std::tie(grid_results, grid_projections) = acmacs::chart::grid_test(chart, projection_no_to_test, opt.grid_step, opt.threads, relax_attempts, opt.grid_json,
+                                                                                opt.grid_adaptive ? acmacs::chart::grid_search::adaptive : acmacs::chart::grid_search::uniform,
+                                                                                opt.grid_local ? acmacs::chart::grid_refine::local : acmacs::chart::grid_refine::full, opt.grid_local_hops);
             AD_PRINT_NEWLINE();
         }
 
@@ -3,6 +3,7 @@
 #include "acmacs-base/string.hh"
 #include "acmacs-base/string-split.hh"
 #include "acmacs-base/timeit.hh"
+#include "acmacs-base/read-file.hh"
 #include "acmacs-chart-2/factory-import.hh"
 #include "acmacs-chart-2/factory-export.hh"
 #include "acmacs-chart-2/chart-modify.hh"
@@ -14,8 +15,9 @@ static void test_rough(acmacs::chart::ChartModify& chart, size_t attempts, std::
 static void test_randomization(acmacs::chart::ChartModify& chart, size_t attempts, std::string min_col_basis, acmacs::number_of_dimensions_t num_dims);
 static void test_dimension(acmacs::chart::ChartModify& chart, std::string min_col_basis);
 static void test_lbfgs_cg(acmacs::chart::ChartModify& chart, std::string min_col_basis, const acmacs::chart::dimension_schedule& schedule, acmacs::chart::optimization_precision precision);
-static void optimize_n(acmacs::chart::optimization_method method, acmacs::chart::ChartModify& chart, size_t attempts, std::string min_col_basis, acmacs::number_of_dimensions_t num_dims, acmacs::chart::optimization_precision precision);
-static void optimize_n(acmacs::chart::optimization_method method, acmacs::chart::ChartModify& chart, size_t attempts, std::string min_col_basis, const acmacs::chart::dimension_schedule& schedule, acmacs::chart::optimization_precision precision);
+static void test_methods(acmacs::chart::ChartModify& chart, size_t attempts, std::string min_col_basis, const acmacs::chart::dimension_schedule& schedule, acmacs::chart::optimization_precision precision);
+static std::vector<acmacs::chart::optimization_status> optimize_n(acmacs::chart::optimization_method method, acmacs::chart::ChartModify& chart, size_t attempts, std::string min_col_basis, acmacs::number_of_dimensions_t num_dims, acmacs::chart::optimization_precision precision, size_t trace_capacity);
+static std::vector<acmacs::chart::optimization_status> optimize_n(acmacs::chart::optimization_method method, acmacs::chart::ChartModify& chart, size_t attempts, std::string min_col_basis, const acmacs::chart::dimension_schedule& schedule, acmacs::chart::optimization_precision precision, size_t trace_capacity);
 
 // ----------------------------------------------------------------------
 
@@ -34,6 +36,9 @@ int main(int argc, char* const argv[])
                 {"--test-randomization", false},
                 {"--test-dimension", false},
                 {"--test-lbfgs-cg", false},
+                {"--test-methods", false, "optimize from the same starting layouts using all methods and compare"},
+                {"--trace", "", "export per-iteration optimizer trace (.json or .csv)"},
+                {"--trace-capacity", 10000, "number of last iterations to keep in the trace of each optimization"},
                 {"--time", false, "report time of loading chart"},
                 {"--verbose", false},
                 {"-h", false},
@@ -64,8 +69,18 @@ int main(int argc, char* const argv[])
             else if (args["--test-lbfgs-cg"]) {
                 test_lbfgs_cg(chart, args["-m"].str(), schedule, precision);
             }
+            else if (args["--test-methods"]) {
+                test_methods(chart, args["-n"], args["-m"].str(), schedule, precision);
+            }
             else {
-                optimize_n(method, chart, args["-n"], args["-m"].str(), schedule, precision);
+                const std::string trace_filename{args["--trace"].str()};
+                const auto statuses = optimize_n(method, chart, args["-n"], args["-m"].str(), schedule, precision, trace_filename.empty() ? 0UL : static_cast<size_t>(args["--trace-capacity"]));
+                if (!trace_filename.empty()) {
+                    if (acmacs::string::endswith(trace_filename, std::string_view{".csv"}))
+                        acmacs::file::write(trace_filename, acmacs::chart::export_traces_to_csv(statuses));
+                    else
+                        acmacs::file::write(trace_filename, acmacs::chart::export_traces_to_json(statuses));
+                }
                 chart.projections_modify().sort();
                 std::cout << chart.make_info() << '\n';
                 if (args.number_of_arguments() > 1)
@@ -186,28 +201,54 @@ void test_lbfgs_cg(acmacs::chart::ChartModify& chart, std::string min_col_basis,
 
 // ----------------------------------------------------------------------
 
-void optimize_n(acmacs::chart::optimization_method method, acmacs::chart::ChartModify& chart, size_t attempts, std::string min_col_basis, acmacs::number_of_dimensions_t num_dims, acmacs::chart::optimization_precision precision)
+void test_methods(acmacs::chart::ChartModify& chart, size_t attempts, std::string min_col_basis, const acmacs::chart::dimension_schedule& schedule, acmacs::chart::optimization_precision precision)
 {
+    using namespace acmacs::chart;
+    const std::array methods{optimization_method::alglib_lbfgs_pca, optimization_method::alglib_cg_pca, optimization_method::sgd_adam_lbfgs_pca, optimization_method::newton_block_pca};
+
+    for (size_t no = 0; no < attempts; ++no) {
+        auto projection = chart.projections_modify().new_from_scratch(schedule.initial(), min_col_basis);
+        projection->randomize_layout(randomizer_plain_with_table_max_distance(*projection));
+        const acmacs::Layout starting{*projection->layout_modified()};
+        for (const auto method : methods) {
+            projection->set_layout(starting, true);
+            const auto status = optimize(*projection, schedule, optimization_options(method, precision));
+            fmt::print("{:3d} {:20s} {:.12f} time: {} iters: {} nstress: {}\n", no, fmt::format("{}", method), status.final_stress, acmacs::format_duration(status.time), status.number_of_iterations, status.number_of_stress_calculations);
+        }
+    }
+
+} // test_methods
+
+// ----------------------------------------------------------------------
+
+std::vector<acmacs::chart::optimization_status> optimize_n(acmacs::chart::optimization_method method, acmacs::chart::ChartModify& chart, size_t attempts, std::string min_col_basis, acmacs::number_of_dimensions_t num_dims, acmacs::chart::optimization_precision precision, size_t trace_capacity)
+{
+    std::vector<acmacs::chart::optimization_status> statuses;
+    acmacs::chart::optimization_options options(method, precision);
+    options.trace_capacity = trace_capacity;
     for (size_t no = 0; no < attempts; ++no) {
           // Timeit ti("randomize and relax: ");
         auto projection = chart.projections_modify().new_from_scratch(num_dims, min_col_basis);
         projection->randomize_layout(randomizer_plain_with_table_max_distance(*projection));
-        const auto status = projection->relax(acmacs::chart::optimization_options(method, precision));
+        const auto& status = statuses.emplace_back(projection->relax(options));
         fmt::print("{}\n", status);
     }
+    return statuses;
 
 } // optimize_n
 
 // ----------------------------------------------------------------------
 
-void optimize_n(acmacs::chart::optimization_method method, acmacs::chart::ChartModify& chart, size_t attempts, std::string min_col_basis, const acmacs::chart::dimension_schedule& schedule, acmacs::chart::optimization_precision precision)
+std::vector<acmacs::chart::optimization_status> optimize_n(acmacs::chart::optimization_method method, acmacs::chart::ChartModify& chart, size_t attempts, std::string min_col_basis, const acmacs::chart::dimension_schedule& schedule, acmacs::chart::optimization_precision precision, size_t trace_capacity)
 {
-    if (schedule.size() == 1) {
-        optimize_n(method, chart, attempts, min_col_basis, schedule.initial(), precision);
-        return;
-    }
+    if (schedule.size() == 1)
+        return optimize_n(method, chart, attempts, min_col_basis, schedule.initial(), precision, trace_capacity);
 
+    std::vector<acmacs::chart::optimization_status> statuses;
     for (size_t no = 0; no < attempts; ++no) {
+        auto& attempt_status = statuses.emplace_back(method);
+        if (trace_capacity > 0)
+            attempt_status.trace = std::make_shared<acmacs::chart::OptimizationTrace>(trace_capacity); // one trace for all schedule stages
         auto projection = chart.projections_modify().new_from_scratch(schedule.initial(), min_col_basis);
         projection->randomize_layout(randomizer_plain_with_table_max_distance(*projection));
         auto layout = projection->layout_modified();
@@ -220,13 +261,17 @@ void optimize_n(acmacs::chart::optimization_method method, acmacs::chart::ChartM
                 layout->change_number_of_dimensions(num_dims);
                 stress.change_number_of_dimensions(num_dims);
             }
-            const auto status = acmacs::chart::optimize(method, stress, layout->data(), layout->data() + layout->size(), precision);
+            const auto status = acmacs::chart::optimize(method, stress, layout->data(), layout->data() + layout->size(), precision, attempt_status.trace.get());
+            if (num_dims == schedule.initial())
+                attempt_status.initial_stress = status.initial_stress;
+            attempt_status.final_stress = status.final_stress;
             std::cout << std::setprecision(12)
                       // << status.initial_stress << " --> "
                       << status.final_stress << " dims: " << acmacs::to_string(layout->number_of_dimensions())
                       << " time: " << acmacs::format_duration(status.time) << " iters: " << status.number_of_iterations << " nstress: " << status.number_of_stress_calculations << '\n';
         }
     }
+    return statuses;
 
 } // optimize_n
 
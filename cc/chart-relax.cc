@@ -1,6 +1,7 @@
 #include "acmacs-base/argv.hh"
 #include "acmacs-base/string.hh"
 #include "acmacs-base/timeit.hh"
+#include "acmacs-base/read-file.hh"
 #include "acmacs-chart-2/factory-import.hh"
 #include "acmacs-chart-2/factory-export.hh"
 #include "acmacs-chart-2/chart-modify.hh"
@@ -26,10 +27,13 @@ struct Options : public argv
     option<bool>   grid{*this, "grid", desc{"perform grid test after optimization until no trapped points left"}};
     option<str>    grid_json{*this, "grid-json", desc{"export grid test results into json"}};
     option<double> grid_step{*this, "grid-step", dflt{0.1}};
+    option<bool>   grid_adaptive{*this, "grid-adaptive", desc{"grid test: coarse scan, then fine scan around the best coarse cells only"}};
+    option<bool>   grid_local{*this, "grid-local", desc{"grid test: score candidate moves by optimizing the moved point neighbourhood, whole layout for trapped points only"}};
+    option<size_t> grid_local_hops{*this, "grid-local-hops", dflt{1UL}, desc{"--grid-local: neighbourhood size in table distance links"}};
     // option<bool>   export_pre_grid{*this, "export-pre-grid", desc{"export chart before running grid test (to help debugging crashes)"}};
     option<bool>   no_dimension_annealing{*this, "no-dimension-annealing"};
     option<bool>   dimension_annealing{*this, "dimension-annealing"};
-    option<str>    method{*this, "method", dflt{"alglib-cg"}, desc{"method: alglib-lbfgs, alglib-cg, optim-bfgs, optim-differential-evolution"}};
+    option<str>    method{*this, "method", dflt{"alglib-cg"}, desc{"method: alglib-lbfgs, alglib-cg, sgd-adam, newton-block, optim-bfgs, optim-differential-evolution"}};
     option<double> randomization_diameter_multiplier{*this, "md", dflt{2.0}, desc{"randomization diameter multiplier"}};
     option<bool>   remove_original_projections{*this, "remove-original-projections", desc{"remove projections found in the source chart"}};
     option<size_t> keep_projections{*this, "keep-projections", dflt{0UL}, desc{"number of projections to keep, 0 - keep all"}};
@@ -39,6 +43,8 @@ struct Options : public argv
     option<int>    threads{*this, "threads", dflt{0}, desc{"number of threads to use for optimization (omp): 0 - autodetect, 1 - sequential"}};
     option<str_array> verbose{*this, 'v', "verbose", desc{"comma separated list (or multiple switches) of enablers"}};
     option<unsigned> seed{*this, "seed", desc{"seed for randomization, -n 1 implied"}};
+    option<str>    trace{*this, "trace", desc{"export per-iteration optimizer trace of each optimization (.json or .csv)"}};
+    option<size_t> trace_capacity{*this, "trace-capacity", dflt{10000UL}, desc{"number of last iterations to keep in the trace of each optimization"}};
 
     argument<str>  source_chart{*this, arg_name{"source-chart"}, mandatory};
     argument<str>  output_chart{*this, arg_name{"output-chart"}};
@@ -65,6 +71,12 @@ int main(int argc, char* const argv[])
 
         acmacs::chart::optimization_options options(method, precision, opt.randomization_diameter_multiplier);
         options.disconnect_too_few_numeric_titers = opt.no_disconnect_having_few_titers ? acmacs::chart::disconnect_few_numeric_titers::no : acmacs::chart::disconnect_few_numeric_titers::yes;
+        if (opt.trace.has_value()) {
+            if (opt.incremental)
+                AD_WARNING("--trace is not supported with --incremental");
+            options.trace_capacity = opt.trace_capacity;
+        }
+        std::vector<acmacs::chart::optimization_status> statuses;
 
         if (opt.no_dimension_annealing)
             AD_WARNING("option --no-dimension-annealing is deprectaed, dimension annealing is disabled by default, use --dimension-annealing to enable");
@@ -80,7 +92,7 @@ int main(int argc, char* const argv[])
                                         opt.remove_original_projections ? acmacs::chart::remove_source_projection::yes : acmacs::chart::remove_source_projection::no,
                                         opt.unmovable_non_nan_points ? acmacs::chart::unmovable_non_nan_points::yes : acmacs::chart::unmovable_non_nan_points::no);
             else
-                chart.relax(*opt.minimum_column_basis, acmacs::number_of_dimensions_t{*opt.number_of_dimensions}, dimension_annealing, options, opt.seed, disconnected);
+                statuses.push_back(chart.relax(*opt.minimum_column_basis, acmacs::number_of_dimensions_t{*opt.number_of_dimensions}, dimension_annealing, options, opt.seed, disconnected).first);
         }
         else {
             options.num_threads = opt.threads;
@@ -89,15 +101,24 @@ int main(int argc, char* const argv[])
                                         opt.remove_original_projections ? acmacs::chart::remove_source_projection::yes : acmacs::chart::remove_source_projection::no,
                                         opt.unmovable_non_nan_points ? acmacs::chart::unmovable_non_nan_points::yes : acmacs::chart::unmovable_non_nan_points::no);
             else
-                chart.relax(acmacs::chart::number_of_optimizations_t{*opt.number_of_optimizations}, *opt.minimum_column_basis, acmacs::number_of_dimensions_t{*opt.number_of_dimensions},
-                            dimension_annealing, options, disconnected);
+                statuses = chart.relax(acmacs::chart::number_of_optimizations_t{*opt.number_of_optimizations}, *opt.minimum_column_basis, acmacs::number_of_dimensions_t{*opt.number_of_dimensions},
+                                       dimension_annealing, options, disconnected);
 
             if (opt.grid) {
                 const size_t projection_no_to_test = 0, relax_attempts = 20;
-                const auto [grid_results, grid_projections] = acmacs::chart::grid_test(chart, projection_no_to_test, opt.grid_step, opt.threads, relax_attempts, opt.grid_json);
+                const auto [grid_results, grid_projections] = acmacs::chart::grid_test(chart, projection_no_to_test, opt.grid_step, opt.threads, relax_attempts, opt.grid_json,
+                                                                                       opt.grid_adaptive ? acmacs::chart::grid_search::adaptive : acmacs::chart::grid_search::uniform,
+                                                                                       opt.grid_local ? acmacs::chart::grid_refine::local : acmacs::chart::grid_refine::full, opt.grid_local_hops);
             }
         }
 
+        if (opt.trace.has_value()) {
+            if (acmacs::string::endswith(*opt.trace, ".csv"sv) || acmacs::string::endswith(*opt.trace, ".csv.xz"sv))
+                acmacs::file::write(opt.trace, acmacs::chart::export_traces_to_csv(statuses));
+            else
+                acmacs::file::write(opt.trace, acmacs::chart::export_traces_to_json(statuses));
+        }
+
         projections.sort();
         for (size_t p_no = 0; p_no < opt.fine; ++p_no)
             chart.projection_modify(p_no)->relax(acmacs::chart::optimization_options(method, acmacs::chart::optimization_precision::fine));
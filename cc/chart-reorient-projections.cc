@@ -15,6 +15,7 @@ struct Options : public argv
     std::string_view help_pre() const override{ return "Re-orients all projections to the master projection of the chart\n"; }
 
     option<size_t> master_projection_no{*this, 'm', desc{"master projection no"}};
+    option<int>    threads{*this, "threads", dflt{0}, desc{"number of threads to use for procrustes (omp): 0 - autodetect, 1 - sequential"}};
     argument<str> chart{*this, arg_name{"chart"}, mandatory};
     argument<str> output_chart{*this, arg_name{"output-chart"}, mandatory};
 };
@@ -27,13 +28,19 @@ int main(int argc, char* const argv[])
         acmacs::chart::ChartModify to_reorient{acmacs::chart::import_from_file(opt.chart)};
         auto master_projection = to_reorient.projection(opt.master_projection_no);
         acmacs::chart::CommonAntigensSera common(to_reorient);
+        std::vector<size_t> projections_to_reorient;
+        std::vector<std::shared_ptr<acmacs::Layout>> layouts;
         for (auto projection_no : acmacs::filled_with_indexes(to_reorient.number_of_projections())) {
             if (projection_no != *opt.master_projection_no) {
-                const auto procrustes_data = acmacs::chart::procrustes(*master_projection, *to_reorient.projection(projection_no), common.points(), acmacs::chart::procrustes_scaling_t::no);
-                to_reorient.projection_modify(projection_no)->transformation(procrustes_data.transformation);
-                fmt::print("projection:  {}\ntransformation: {}\nrms: {}\n\n", projection_no, procrustes_data.transformation, procrustes_data.rms);
+                projections_to_reorient.push_back(projection_no);
+                layouts.push_back(to_reorient.projection(projection_no)->layout());
             }
         }
+        const auto procrustes_data = acmacs::chart::procrustes(*master_projection, layouts, common.points(), acmacs::chart::procrustes_scaling_t::no, opt.threads);
+        for (size_t index = 0; index < projections_to_reorient.size(); ++index) {
+            to_reorient.projection_modify(projections_to_reorient[index])->transformation(procrustes_data[index].transformation);
+            fmt::print("projection:  {}\ntransformation: {}\nrms: {}\n\n", projections_to_reorient[index], procrustes_data[index].transformation, procrustes_data[index].rms);
+        }
         acmacs::chart::export_factory(to_reorient, opt.output_chart, opt.program_name());
     }
     catch (std::exception& err) {
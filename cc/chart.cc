@@ -113,13 +113,10 @@ std::string acmacs::chart::Chart::description() const
 
 // ----------------------------------------------------------------------
 
-std::shared_ptr<acmacs::chart::ColumnBases> acmacs::chart::Chart::computed_column_bases(acmacs::chart::MinimumColumnBasis aMinimumColumnBasis, use_cache a_use_cache) const
+std::shared_ptr<acmacs::chart::ColumnBases> acmacs::chart::Chart::computed_column_bases(acmacs::chart::MinimumColumnBasis aMinimumColumnBasis) const
 {
-    if (a_use_cache == use_cache::yes) {
-        if (auto found = computed_column_bases_.find(aMinimumColumnBasis); found != computed_column_bases_.end())
-            return found->second;
-    }
-    return computed_column_bases_[aMinimumColumnBasis] = titers()->computed_column_bases(aMinimumColumnBasis);
+    // cached by titer statistics, cache is dropped when titers are modified, the caller gets its own copy and may modify it
+    return std::make_shared<ColumnBasesData>(*titers()->statistics()->column_bases(aMinimumColumnBasis));
 
 } // acmacs::chart::Chart::computed_column_bases
 
@@ -142,13 +139,13 @@ double acmacs::chart::Chart::column_basis(size_t serum_no, size_t projection_no)
         if (auto forced = prj->forced_column_bases(); forced)
             return forced->column_basis(serum_no);
         else
-            return computed_column_bases(prj->minimum_column_basis(), use_cache::yes)->column_basis(serum_no);
+            return titers()->statistics()->column_bases(prj->minimum_column_basis())->column_basis(serum_no);
     }
     else {
         if (auto forced = forced_column_bases({}); forced)
             return forced->column_basis(serum_no);
         else
-            return computed_column_bases({}, use_cache::yes)->column_basis(serum_no);
+            return titers()->statistics()->column_bases({})->column_basis(serum_no);
     }
 
 } // acmacs::chart::Chart::column_basis
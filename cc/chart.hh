@@ -892,8 +892,6 @@ namespace acmacs::chart
         PointStyle default_style(PointType aPointType) const;
 
       public:
-        enum class use_cache { no, yes };
-
         virtual ~Chart() = default;
         Chart() = default;
         Chart(const Chart&) = delete;
@@ -906,7 +904,8 @@ namespace acmacs::chart
         virtual std::shared_ptr<Sera> sera() const = 0;
         virtual std::shared_ptr<Titers> titers() const = 0;
         virtual std::shared_ptr<ColumnBases> forced_column_bases(MinimumColumnBasis aMinimumColumnBasis) const = 0; // returns nullptr if column bases not forced
-        virtual std::shared_ptr<ColumnBases> computed_column_bases(MinimumColumnBasis aMinimumColumnBasis, use_cache a_use_cache = use_cache::no) const;
+        // result is a copy of column bases cached per titers and minimum column basis
+        virtual std::shared_ptr<ColumnBases> computed_column_bases(MinimumColumnBasis aMinimumColumnBasis) const;
         double column_basis(size_t serum_no, size_t projection_no = 0) const;
         std::shared_ptr<ColumnBases> column_bases(MinimumColumnBasis aMinimumColumnBasis) const;
         virtual std::shared_ptr<Projections> projections() const = 0;
@@ -967,9 +966,6 @@ namespace acmacs::chart
         // check if at least one antigen has a sequences (sequence_aa or sequence_nuc)
         virtual bool has_sequences() const = 0;
 
-      private:
-        mutable std::map<MinimumColumnBasis, std::shared_ptr<ColumnBases>> computed_column_bases_; // cache, computing might be slow for big charts
-
     }; // class Chart
 
     using ChartP = std::shared_ptr<Chart>;
@@ -1,3 +1,8 @@
+#include <array>
+#include <optional>
+#include <cmath>
+#include <limits>
+
 #include "acmacs-base/log.hh"
 #include "acmacs-base/timeit.hh"
 #include "acmacs-base/omp.hh"
@@ -7,6 +12,7 @@
 #include "acmacs-base/range-v3.hh"
 #include "acmacs-base/read-file.hh"
 #include "acmacs-base/data-formatter.hh"
+#include "acmacs-base/sigmoid.hh"
 #include "acmacs-chart-2/grid-test.hh"
 #include "acmacs-chart-2/name-format.hh"
 #include "acmacs-chart-2/log.hh"
@@ -20,6 +26,120 @@ static std::vector<acmacs::chart::GridTest::Result> _gcc72_bug;
 
 // ----------------------------------------------------------------------
 
+namespace acmacs::chart::grid_test_internal
+{
+    // Evaluates contribution of the tested point placed at each of a tile of grid cells.
+    // Coordinates of the neighbours (points having table distance with the tested point) are gathered once,
+    // cells and neighbours are stored as structure of arrays, the inner loop runs over cells and is vectorized.
+    class TileEvaluator
+    {
+      public:
+        static constexpr const size_t tile_size{64};
+
+        TileEvaluator(const Stress::TableDistancesForPoint& table_distances_for_point, const acmacs::Layout& layout)
+            : num_dim_{*layout.number_of_dimensions()}, number_of_regular_{table_distances_for_point.regular.size()},
+              number_of_neighbours_{number_of_regular_ + table_distances_for_point.less_than.size()}, neighbours_(number_of_neighbours_ * num_dim_),
+              table_distances_(number_of_neighbours_), cells_(tile_size * num_dim_), contributions_(tile_size)
+        {
+            size_t neighbour_no{0};
+            const auto gather = [&](const auto& entries) {
+                for (const auto& entry : entries) {
+                    for (size_t dim = 0; dim < num_dim_; ++dim)
+                        neighbours_[dim * number_of_neighbours_ + neighbour_no] = layout.data()[entry.another_point * num_dim_ + dim];
+                    table_distances_[neighbour_no] = entry.distance;
+                    ++neighbour_no;
+                }
+            };
+            gather(table_distances_for_point.regular);
+            gather(table_distances_for_point.less_than);
+        }
+
+        bool full() const { return number_of_cells_ == tile_size; }
+        size_t size() const { return number_of_cells_; }
+        void clear() { number_of_cells_ = 0; }
+
+        void add(const PointCoordinates& cell)
+        {
+            for (auto dim : acmacs::range<number_of_dimensions_t>(cell.number_of_dimensions()))
+                cells_[*dim * tile_size + number_of_cells_] = cell[dim];
+            ++number_of_cells_;
+        }
+
+        PointCoordinates cell(size_t cell_no) const
+        {
+            PointCoordinates result(number_of_dimensions_t{num_dim_});
+            for (auto dim : acmacs::range<number_of_dimensions_t>(number_of_dimensions_t{num_dim_}))
+                result[dim] = cells_[*dim * tile_size + cell_no];
+            return result;
+        }
+
+        // returns contributions for the cells added since the last clear(), unused tail of the tile contains garbage
+        const std::vector<double>& evaluate()
+        {
+            std::fill(contributions_.begin(), contributions_.end(), 0.0);
+            for (size_t neighbour_no = 0; neighbour_no < number_of_neighbours_; ++neighbour_no) {
+                const double table_distance = table_distances_[neighbour_no];
+                map_distances(neighbour_no);
+                if (neighbour_no < number_of_regular_) {
+#pragma omp simd
+                    for (size_t cell_no = 0; cell_no < tile_size; ++cell_no) {
+                        const double diff = table_distance - distances_[cell_no];
+                        contributions_[cell_no] += diff * diff;
+                    }
+                }
+                else {
+#pragma omp simd
+                    for (size_t cell_no = 0; cell_no < tile_size; ++cell_no) {
+                        const double diff = table_distance - distances_[cell_no] + 1;
+                        contributions_[cell_no] += diff * diff * acmacs::sigmoid(diff * SigmoidMutiplier());
+                    }
+                }
+            }
+            return contributions_;
+        }
+
+      private:
+        const size_t num_dim_;
+        const size_t number_of_regular_;
+        const size_t number_of_neighbours_;
+        std::vector<double> neighbours_;       // [dim * number_of_neighbours_ + neighbour_no]
+        std::vector<double> table_distances_;  // regular first, then less-than
+        std::vector<double> cells_;            // [dim * tile_size + cell_no]
+        std::vector<double> contributions_;
+        std::array<double, tile_size> distances_;
+        size_t number_of_cells_{0};
+
+        void map_distances(size_t neighbour_no)
+        {
+            std::fill(distances_.begin(), distances_.end(), 0.0);
+            for (size_t dim = 0; dim < num_dim_; ++dim) {
+                const double neighbour_coord = neighbours_[dim * number_of_neighbours_ + neighbour_no];
+                const double* cell_coords = cells_.data() + dim * tile_size;
+#pragma omp simd
+                for (size_t cell_no = 0; cell_no < tile_size; ++cell_no)
+                    distances_[cell_no] += (cell_coords[cell_no] - neighbour_coord) * (cell_coords[cell_no] - neighbour_coord);
+            }
+#pragma omp simd
+            for (size_t cell_no = 0; cell_no < tile_size; ++cell_no)
+                distances_[cell_no] = std::sqrt(distances_[cell_no]);
+        }
+    };
+
+    inline to_json::object export_result(const ChartModify& chart, const GridTest::Result& result)
+    {
+        return to_json::object{
+            to_json::key_val{"point_no", result.point_no},
+            to_json::key_val{"name", result.point_no < chart.number_of_antigens() ? chart.antigen(result.point_no)->format("{name_full}") : chart.serum(result.point_no - chart.number_of_antigens())->format("{name_full}")},
+            to_json::key_val{"distance", result.distance},
+            to_json::key_val{"contribution_diff", result.contribution_diff},
+            to_json::key_val{"pos", to_json::array(result.pos.begin(), result.pos.end())},
+        };
+    }
+
+} // namespace acmacs::chart::grid_test_internal
+
+// ----------------------------------------------------------------------
+
 std::string acmacs::chart::GridTest::point_name(size_t point_no) const
 {
     if (antigen(point_no)) {
@@ -79,8 +199,7 @@ void acmacs::chart::GridTest::test(Result& result)
 
         result.diagnosis = Result::normal;
 
-        acmacs::Layout layout(original_layout_);
-        const auto target_contribution = stress_.contribution(result.point_no, table_distances_for_point, layout.data());
+        const auto target_contribution = stress_.contribution(result.point_no, table_distances_for_point, original_layout_.data());
         const auto original_pos = original_layout_.at(result.point_no);
         auto best_contribution = target_contribution;
         PointCoordinates best_coord(original_pos.number_of_dimensions()),
@@ -88,38 +207,122 @@ void acmacs::chart::GridTest::test(Result& result)
         const auto hemisphering_stress_threshold_rough = hemisphering_stress_threshold_ * 2;
         auto hemisphering_contribution = target_contribution + hemisphering_stress_threshold_rough;
         const auto area = area_for(table_distances_for_point);
-        for (auto it = area.begin(grid_step_), last = area.end(); it != last; ++it) {
-            layout.update(result.point_no, *it);
-            const auto contribution = stress_.contribution(result.point_no, table_distances_for_point, layout.data());
-            if (contribution < best_contribution) {
-                best_contribution = contribution;
-                best_coord = *it;
+        grid_test_internal::TileEvaluator evaluator(table_distances_for_point, original_layout_);
+        const auto process_cells = [&](const std::vector<double>& contributions) {
+            for (size_t cell_no = 0; cell_no < evaluator.size(); ++cell_no) {
+                if (const auto contribution = contributions[cell_no]; contribution < best_contribution) {
+                    best_contribution = contribution;
+                    best_coord = evaluator.cell(cell_no);
+                }
+                else if (!best_coord.exists() && contribution < hemisphering_contribution) {
+                    if (auto cell = evaluator.cell(cell_no); distance(original_pos, cell) > hemisphering_distance_threshold_) {
+                        hemisphering_contribution = contribution;
+                        hemisphering_coord = std::move(cell);
+                    }
+                }
             }
-            else if (!best_coord.exists() && contribution < hemisphering_contribution && distance(original_pos, *it) > hemisphering_distance_threshold_) {
-                hemisphering_contribution = contribution;
-                hemisphering_coord = *it;
+        };
+        const auto scan = [&evaluator](const acmacs::Area& scan_area, double step, const auto& process_tile) {
+            for (auto it = scan_area.begin(step), last = scan_area.end(); it != last; ++it) {
+                evaluator.add(*it);
+                if (evaluator.full()) {
+                    process_tile(evaluator.evaluate());
+                    evaluator.clear();
+                }
             }
+            if (evaluator.size() > 0) {
+                process_tile(evaluator.evaluate());
+                evaluator.clear();
+            }
+        };
+
+        if (search_ == grid_search::uniform) {
+            scan(area, grid_step_, process_cells);
+        }
+        else {
+            // coarse scan of the whole area, then uniform scan with grid_step_ around adaptive_basins_ best coarse cells that are far enough from each other
+            const auto coarse_step = std::max(grid_step_ * 2.0, adaptive_coarse_step_);
+            std::vector<std::pair<double, PointCoordinates>> coarse_best; // sorted by contribution
+            const size_t coarse_best_size = adaptive_basins_ * 8;
+            scan(area, coarse_step, [&](const std::vector<double>& contributions) {
+                process_cells(contributions);
+                for (size_t cell_no = 0; cell_no < evaluator.size(); ++cell_no) {
+                    if (coarse_best.size() < coarse_best_size || contributions[cell_no] < coarse_best.back().first) {
+                        const auto pos = std::upper_bound(coarse_best.begin(), coarse_best.end(), contributions[cell_no], [](double contribution, const auto& en) { return contribution < en.first; });
+                        coarse_best.emplace(pos, contributions[cell_no], evaluator.cell(cell_no));
+                        if (coarse_best.size() > coarse_best_size)
+                            coarse_best.pop_back();
+                    }
+                }
+            });
+            std::vector<PointCoordinates> basins;
+            for (const auto& [contribution, cell] : coarse_best) {
+                if (std::all_of(basins.begin(), basins.end(), [&cell = cell, coarse_step](const auto& basin) { return distance(basin, cell) > (coarse_step * 2.0); }))
+                    basins.push_back(cell);
+                if (basins.size() == adaptive_basins_)
+                    break;
+            }
+            for (const auto& basin : basins) {
+                acmacs::Area refine_area(basin);
+                refine_area.extend(basin - coarse_step);
+                refine_area.extend(basin + coarse_step);
+                scan(refine_area, grid_step_, process_cells);
+            }
+        }
+
+        if (!best_coord.exists() && !hemisphering_coord.exists())
+            return;
+
+        acmacs::Layout layout(original_layout_);
+        const auto num_dim = static_cast<size_t>(*layout.number_of_dimensions());
+        std::optional<LocalStress> local;
+        std::vector<double> local_layout;
+        double local_initial_stress{0.0};
+        if (refine_ == grid_refine::local) {
+            local = make_local_stress(result.point_no);
+            local_layout.resize(local->points.size() * num_dim);
+            for (size_t l_no = 0; l_no < local->points.size(); ++l_no)
+                std::copy_n(layout.data() + local->points[l_no] * num_dim, num_dim, local_layout.begin() + static_cast<std::ptrdiff_t>(l_no * num_dim));
+            local_initial_stress = local->stress.value(local_layout.data());
         }
+        // returns stress change caused by the move
+        const auto optimize_candidate = [&](acmacs::chart::optimization_precision precision) {
+            if (local) {
+                // only the neighbourhood of the moved point is optimized, movable points are copied back to layout
+                for (size_t l_no = 0; l_no < local->number_of_movable; ++l_no)
+                    std::copy_n(layout.data() + local->points[l_no] * num_dim, num_dim, local_layout.begin() + static_cast<std::ptrdiff_t>(l_no * num_dim));
+                const auto status = acmacs::chart::optimize(optimization_method_, local->stress, local_layout.data(), local_layout.data() + local_layout.size(), precision);
+                for (size_t l_no = 0; l_no < local->number_of_movable; ++l_no)
+                    std::copy_n(local_layout.begin() + static_cast<std::ptrdiff_t>(l_no * num_dim), num_dim, layout.data() + local->points[l_no] * num_dim);
+                return status.final_stress - local_initial_stress;
+            }
+            else
+                return acmacs::chart::optimize(optimization_method_, stress_, layout.data(), layout.data() + layout.size(), precision).final_stress - projection_->stress();
+        };
+
         if (best_coord.exists()) {
             layout.update(result.point_no, best_coord);
-            const auto status = acmacs::chart::optimize(optimization_method_, stress_, layout.data(), layout.data() + layout.size(), acmacs::chart::optimization_precision::rough);
+            result.contribution_diff = optimize_candidate(acmacs::chart::optimization_precision::rough);
+            if (local && std::abs(result.contribution_diff) > hemisphering_stress_threshold_) {
+                // trapped according to local optimization, confirm by optimizing the whole layout
+                local.reset();
+                result.contribution_diff = optimize_candidate(acmacs::chart::optimization_precision::rough);
+            }
             result.pos = layout.at(result.point_no);
             result.distance = distance(original_pos, result.pos);
-            result.contribution_diff = status.final_stress - projection_->stress();
             result.diagnosis = std::abs(result.contribution_diff) > hemisphering_stress_threshold_ ? Result::trapped : Result::hemisphering;
         }
         else if (hemisphering_coord.exists()) {
             // relax to find real contribution
             layout.update(result.point_no, hemisphering_coord);
-            auto status = acmacs::chart::optimize(optimization_method_, stress_, layout.data(), layout.data() + layout.size(), acmacs::chart::optimization_precision::rough);
+            result.contribution_diff = optimize_candidate(acmacs::chart::optimization_precision::rough);
             result.pos = layout.at(result.point_no);
             result.distance = distance(original_pos, result.pos);
             if (result.distance > hemisphering_distance_threshold_ && result.distance < (hemisphering_distance_threshold_ * 1.2)) {
-                status = acmacs::chart::optimize(optimization_method_, stress_, layout.data(), layout.data() + layout.size(), acmacs::chart::optimization_precision::fine);
+                result.contribution_diff = optimize_candidate(acmacs::chart::optimization_precision::fine);
                 result.pos = layout.at(result.point_no);
                 result.distance = distance(original_pos, result.pos);
             }
-            result.contribution_diff = status.final_stress - projection_->stress();
             if (result.distance > hemisphering_distance_threshold_) {
                 // if (const auto real_contribution_diff = stress_.contribution(result.point_no, table_distances_for_point, layout.data()) - target_contribution;
                 //     real_contribution_diff < hemisphering_stress_threshold_) {
@@ -136,6 +339,82 @@ void acmacs::chart::GridTest::test(Result& result)
 
 // ----------------------------------------------------------------------
 
+acmacs::chart::GridTest::LocalStress acmacs::chart::GridTest::make_local_stress(size_t point_no) const
+{
+    const auto number_of_points = original_layout_.number_of_points();
+    std::vector<bool> movable(number_of_points, false);
+    movable[point_no] = true;
+    const auto& regular = stress_.table_distances().regular();
+    const auto& less_than = stress_.table_distances().less_than();
+    for (size_t hop = 0; hop < local_hops_; ++hop) {
+        auto next = movable;
+        const auto extend = [&movable, &next](const auto& entries) {
+            for (const auto& entry : entries) {
+                if (movable[entry.point_1])
+                    next[entry.point_2] = true;
+                else if (movable[entry.point_2])
+                    next[entry.point_1] = true;
+            }
+        };
+        extend(regular);
+        extend(less_than);
+        movable.swap(next);
+    }
+
+    // local problem contains movable points followed by their unmovable neighbours,
+    // terms between unmovable points do not change, they are not included
+    constexpr const auto not_in_local = std::numeric_limits<size_t>::max();
+    std::vector<size_t> local_no(number_of_points, not_in_local), points;
+    for (size_t p_no = 0; p_no < number_of_points; ++p_no) {
+        if (movable[p_no]) {
+            local_no[p_no] = points.size();
+            points.push_back(p_no);
+        }
+    }
+    const auto number_of_movable = points.size();
+    const auto add_neighbours = [&movable, &local_no, &points](const auto& entries) {
+        for (const auto& entry : entries) {
+            if (movable[entry.point_1] || movable[entry.point_2]) {
+                for (const auto p_no : {entry.point_1, entry.point_2}) {
+                    if (local_no[p_no] == not_in_local) {
+                        local_no[p_no] = points.size();
+                        points.push_back(p_no);
+                    }
+                }
+            }
+        }
+    };
+    add_neighbours(regular);
+    add_neighbours(less_than);
+
+    LocalStress local{Stress{stress_.number_of_dimensions(), points.size(), stress_.parameters().mult, stress_.parameters().dodgy_titer_is_regular}, std::move(points), number_of_movable};
+    const auto copy = [&movable, &local_no](const auto& source, auto& target) {
+        for (const auto& entry : source) {
+            if (movable[entry.point_1] || movable[entry.point_2]) {
+                auto& local_entry = target.emplace_back(entry);
+                local_entry.point_1 = local_no[entry.point_1];
+                local_entry.point_2 = local_no[entry.point_2];
+            }
+        }
+    };
+    copy(regular, local.stress.table_distances_modify().regular());
+    copy(less_than, local.stress.table_distances_modify().less_than());
+
+    std::vector<size_t> unmovable, unmovable_in_the_last_dimension;
+    for (size_t l_no = 0; l_no < local.points.size(); ++l_no) {
+        if (l_no >= local.number_of_movable || stress_.parameters().unmovable.contains(local.points[l_no]))
+            unmovable.push_back(l_no);
+        else if (stress_.parameters().unmovable_in_the_last_dimension.contains(local.points[l_no]))
+            unmovable_in_the_last_dimension.push_back(l_no);
+    }
+    local.stress.set_unmovable(UnmovablePoints(unmovable.begin(), unmovable.end()));
+    local.stress.set_unmovable_in_the_last_dimension(UnmovableInTheLastDimensionPoints(unmovable_in_the_last_dimension.begin(), unmovable_in_the_last_dimension.end()));
+    return local;
+
+} // acmacs::chart::GridTest::make_local_stress
+
+// ----------------------------------------------------------------------
+
 acmacs::chart::GridTest::Results acmacs::chart::GridTest::test(const std::vector<size_t>& points, [[maybe_unused]] int threads)
 {
     Results results(points, *projection_);
@@ -143,6 +422,8 @@ acmacs::chart::GridTest::Results acmacs::chart::GridTest::test(const std::vector
 #pragma omp parallel for default(none) shared(results) num_threads(threads <= 0 ? omp_get_max_threads() : threads) schedule(static, chart_.number_of_antigens() < 1000 ? 4 : 1)
     for (size_t entry_no = 0; entry_no < results.size(); ++entry_no) {
         test(results[entry_no]);
+        if (stream_)
+            stream_->write(results[entry_no]);
     }
 
     return results;
@@ -158,6 +439,8 @@ acmacs::chart::GridTest::Results acmacs::chart::GridTest::test_all([[maybe_unuse
 #pragma omp parallel for default(none) shared(results) num_threads(threads <= 0 ? omp_get_max_threads() : threads) schedule(static, chart_.number_of_antigens() < 1000 ? 4 : 1)
     for (size_t entry_no = 0; entry_no < results.size(); ++entry_no) {
         test(results[entry_no]);
+        if (stream_)
+            stream_->write(results[entry_no]);
     }
 
     return results;
@@ -183,6 +466,40 @@ acmacs::chart::ProjectionModifyP acmacs::chart::GridTest::make_new_projection_an
 
 // ----------------------------------------------------------------------
 
+std::vector<size_t> acmacs::chart::GridTest::switch_to(acmacs::chart::ProjectionModifyP projection, double threshold)
+{
+    const acmacs::Layout previous_layout{original_layout_};
+    projection_ = projection;
+    original_layout_ = *projection_->layout();
+
+    const auto number_of_points = original_layout_.number_of_points();
+    std::vector<bool> moved(number_of_points, false), affected(number_of_points, false);
+    for (size_t point_no = 0; point_no < number_of_points; ++point_no) {
+        if (const auto dist = distance(previous_layout.at(point_no), original_layout_.at(point_no)); dist > threshold) // NaN (disconnected) is not moved
+            moved[point_no] = affected[point_no] = true;
+    }
+    const auto mark_neighbours = [&moved, &affected](const auto& entries) {
+        for (const auto& entry : entries) {
+            if (moved[entry.point_1])
+                affected[entry.point_2] = true;
+            if (moved[entry.point_2])
+                affected[entry.point_1] = true;
+        }
+    };
+    mark_neighbours(stress_.table_distances().regular());
+    mark_neighbours(stress_.table_distances().less_than());
+
+    std::vector<size_t> points;
+    for (size_t point_no = 0; point_no < number_of_points; ++point_no) {
+        if (affected[point_no])
+            points.push_back(point_no);
+    }
+    return points;
+
+} // acmacs::chart::GridTest::switch_to
+
+// ----------------------------------------------------------------------
+
 std::string acmacs::chart::GridTest::Results::report() const
 {
     size_t trapped = 0, hemi = 0;
@@ -252,6 +569,7 @@ acmacs::chart::GridTest::Results::Results(const acmacs::chart::Projection& proje
     size_t point_no = 0;
     for (auto& res : *this)
         res.point_no = point_no++;
+    make_index();
     exclude_disconnected(projection);
 
 } // acmacs::chart::GridTest::Results::Results
@@ -263,12 +581,24 @@ acmacs::chart::GridTest::Results::Results(const std::vector<size_t>& points, con
 {
     for (auto [index, point_no] : acmacs::enumerate(points))
         at(index).point_no = point_no;
+    make_index();
     exclude_disconnected(projection);
 
 } // acmacs::chart::GridTest::Results::Results
 
 // ----------------------------------------------------------------------
 
+void acmacs::chart::GridTest::Results::update(const Results& retested)
+{
+    for (const auto& result : retested) {
+        if (auto* found = find(result.point_no); found)
+            *found = result;
+    }
+
+} // acmacs::chart::GridTest::Results::update
+
+// ----------------------------------------------------------------------
+
 void acmacs::chart::GridTest::Results::exclude_disconnected(const acmacs::chart::Projection& projection)
 {
     const auto exclude = [this](size_t point_no) {
@@ -281,22 +611,47 @@ void acmacs::chart::GridTest::Results::exclude_disconnected(const acmacs::chart:
     for (auto disconnected : projection.disconnected())
         exclude(disconnected);
     erase(std::remove_if(begin(), end(), [](const auto& entry) { return entry.diagnosis == Result::excluded; }), end());
+    make_index();
 
 } // acmacs::chart::GridTest::Results::exclude_disconnected
 
 // ----------------------------------------------------------------------
 
+void acmacs::chart::GridTest::Results::make_index()
+{
+    index_.assign(empty() ? 0 : (std::max_element(begin(), end(), [](const auto& r1, const auto& r2) { return r1.point_no < r2.point_no; })->point_no + 1), not_found);
+    for (size_t entry_no = 0; entry_no < size(); ++entry_no)
+        index_[(*this)[entry_no].point_no] = entry_no;
+
+} // acmacs::chart::GridTest::Results::make_index
+
+// ----------------------------------------------------------------------
+
+acmacs::chart::GridTestStream::GridTestStream(const ChartModify& chart, std::string_view filename)
+    : chart_{chart}, output_{std::string{filename}}
+{
+    if (!output_)
+        throw std::runtime_error{AD_FORMAT("cannot write grid test results to {}", filename)};
+
+} // acmacs::chart::GridTestStream::GridTestStream
+
+// ----------------------------------------------------------------------
+
+void acmacs::chart::GridTestStream::write(const GridTest::Result& result)
+{
+    auto data = grid_test_internal::export_result(chart_, result);
+    data << to_json::key_val{"attempt", attempt_} << to_json::key_val{"diagnosis", result.diagnosis_str()};
+    const auto line = fmt::format("{}\n", data.compact());
+    std::lock_guard<std::mutex> lock{access_};
+    output_ << line << std::flush; // flush to make results available if the test is interrupted
+
+} // acmacs::chart::GridTestStream::write
+
+// ----------------------------------------------------------------------
+
 std::string acmacs::chart::GridTest::Results::export_to_json(const ChartModify& chart, size_t number_of_relaxations) const
 {
-    const auto export_point = [&chart](const auto& en) -> to_json::object {
-        return to_json::object{
-            to_json::key_val{"point_no", en.point_no},
-            to_json::key_val{"name", en.point_no < chart.number_of_antigens() ? chart.antigen(en.point_no)->format("{name_full}") : chart.serum(en.point_no - chart.number_of_antigens())->format("{name_full}")},
-            to_json::key_val{"distance", en.distance},
-            to_json::key_val{"contribution_diff", en.contribution_diff},
-            to_json::key_val{"pos", to_json::array(en.pos.begin(), en.pos.end())},
-        };
-    };
+    const auto export_point = [&chart](const auto& en) { return grid_test_internal::export_result(chart, en); };
 
     to_json::array hemisphering, trapped, tested;
     for (const auto& en : *this) {
@@ -388,25 +743,53 @@ std::string acmacs::chart::GridTest::Results::export_to_layout_csv(const ChartMo
 
 // ----------------------------------------------------------------------
 
-std::pair<acmacs::chart::GridTest::Results, size_t> acmacs::chart::grid_test(ChartModify& chart, size_t projection_no, double grid_step, int threads, size_t relax_attempts, std::string_view export_filename, verbose verb)
+std::pair<acmacs::chart::GridTest::Results, size_t> acmacs::chart::grid_test(ChartModify& chart, size_t projection_no, double grid_step, int threads, size_t relax_attempts, std::string_view export_filename,
+                                                                            grid_search search, grid_refine refine, size_t local_hops, grid_retest retest,
+                                                                            std::string_view stream_filename, verbose verb)
 {
     const Timeit ti_grid("grid test: ", verb == verbose::yes ? report_time::yes : report_time::no);
     const size_t total_attempts = relax_attempts ? relax_attempts : 1;
     size_t grid_projections = 0;
     GridTest::Results results;
+    std::optional<GridTest> test;
+    acmacs::chart::ProjectionModifyP relaxed;
+    std::optional<GridTestStream> stream;
+    if (!stream_filename.empty())
+        stream.emplace(chart, stream_filename);
     for (size_t attempt = 0; attempt < total_attempts; ++attempt) {
-        GridTest test{chart, projection_no, grid_step};
-        results = test.test_all(threads);
+        if (stream)
+            stream->attempt(attempt);
+        if (!test || retest == grid_retest::all) {
+            test.emplace(chart, projection_no, grid_step);
+            test->search(search);
+            test->refine(refine, local_hops);
+            if (stream)
+                test->stream(&*stream);
+            results = test->test_all(threads);
+        }
+        else {
+            // heuristic: a point moved by less than grid step and having no table distance to a moved point is assumed to keep its scan result,
+            // trapped and hemisphering results are retested anyway, their pos and contribution_diff refer to the previous projection
+            auto points = test->switch_to(relaxed, grid_step);
+            for (const auto& result : results) {
+                if (result)
+                    points.push_back(result.point_no);
+            }
+            std::sort(points.begin(), points.end());
+            points.erase(std::unique(points.begin(), points.end()), points.end());
+            AD_INFO(verb, "grid test attempt {}: retesting {} points of {}", attempt, points.size(), results.size());
+            results.update(test->test(points, threads));
+        }
         AD_INFO(verb, "{}", results.report());
         for (const auto& result : results) {
             if (result)
                 AD_LOG(acmacs::log::report_stresses, "{}", result.report(chart));
         }
         if (relax_attempts) {
-            auto projection = test.make_new_projection_and_relax(results, verb);
+            relaxed = test->make_new_projection_and_relax(results, verb);
             ++grid_projections;
-            projection->comment("grid-test-" + acmacs::to_string(attempt));
-            projection_no = projection->projection_no();
+            relaxed->comment("grid-test-" + acmacs::to_string(attempt));
+            projection_no = relaxed->projection_no();
             if (ranges::all_of(results, [](const auto& result) { return result.diagnosis != acmacs::chart::GridTest::Result::trapped; }))
                 break;
             // if (std::all_of(results.begin(), results.end(), [](const auto& result) { return result.diagnosis != acmacs::chart::GridTest::Result::trapped; }))
@@ -1,11 +1,31 @@
 #pragma once
 
+#include <fstream>
+#include <mutex>
+
 #include "acmacs-chart-2/chart-modify.hh"
 
 // ----------------------------------------------------------------------
 
 namespace acmacs::chart
 {
+    enum class grid_search {
+        uniform, // scan the whole area with grid step
+        adaptive // coarse scan of the whole area, then scan with grid step around the best coarse cells only
+    };
+
+    enum class grid_refine {
+        full, // score candidate move by optimizing the whole layout
+        local // optimize moved point and its neighbourhood only, optimize the whole layout for trapped points only
+    };
+
+    enum class grid_retest {
+        all,        // test all points on every relax attempt
+        incremental // after the first attempt test only points moved by make_new_projection_and_relax and their table distance neighbours
+    };
+
+    class GridTestStream;
+
     class GridTest
     {
       public:
@@ -17,7 +37,7 @@ namespace acmacs::chart
         {
             enum diagnosis_t { excluded, not_tested, normal, trapped, hemisphering };
 
-            Result(size_t a_point_no, number_of_dimensions_t number_of_dimensions) : point_no(a_point_no), diagnosis(not_tested), pos(number_of_dimensions) {}
+            Result(size_t a_point_no, number_of_dimensions_t number_of_dimensions) : point_no(a_point_no), diagnosis(not_tested), pos(number_of_dimensions), distance(0.0), contribution_diff(0.0) {}
             Result(size_t a_point_no, diagnosis_t a_diagnosis, const PointCoordinates& a_pos, double a_distance, double diff)
                 : point_no(a_point_no), diagnosis(a_diagnosis), pos(a_pos), distance(a_distance), contribution_diff(diff) {}
             explicit operator bool() const { return diagnosis == trapped || diagnosis == hemisphering; }
@@ -48,30 +68,30 @@ namespace acmacs::chart
             std::string export_to_layout_csv(const ChartModify& chart, const acmacs::chart::Projection& projection) const;
             auto count_trapped_hemisphering() const { return std::count_if(begin(), end(), [](const auto& r) { return r.diagnosis == Result::trapped || r.diagnosis == Result::hemisphering; }); }
             number_of_dimensions_t num_dimensions() const { return front().pos.number_of_dimensions(); }
+            void update(const Results& retested); // replaces results for retested points
+            // O(1), index is maintained by constructors and update(), entries must not be added or removed directly
+            Result* find(size_t point_no) { return point_no < index_.size() && index_[point_no] != not_found ? &(*this)[index_[point_no]] : nullptr; }
+            const Result* find(size_t point_no) const { return point_no < index_.size() && index_[point_no] != not_found ? &(*this)[index_[point_no]] : nullptr; }
 
           private:
+            static constexpr const size_t not_found = static_cast<size_t>(-1);
+            std::vector<size_t> index_; // point_no -> entry index in this or not_found
+
+            void make_index();
             void exclude_disconnected(const acmacs::chart::Projection& projection);
-            Result* find(size_t point_no)
-            {
-                if (const auto found = std::find_if(begin(), end(), [point_no](const auto& en) { return en.point_no == point_no; }); found != end())
-                    return &*found;
-                else
-                    return nullptr;
-            }
-            const Result* find(size_t point_no) const
-            {
-                if (const auto found = std::find_if(begin(), end(), [point_no](const auto& en) { return en.point_no == point_no; }); found != end())
-                    return &*found;
-                else
-                    return nullptr;
-            }
         };
 
+        void search(grid_search gs) { search_ = gs; }
+        void stream(GridTestStream* stream) { stream_ = stream; } // stream is not owned
+        void refine(grid_refine gr, size_t local_hops = 1) { refine_ = gr; local_hops_ = local_hops; }
         std::string point_name(size_t point_no) const;
         Result test(size_t point_no);
         Results test(const std::vector<size_t>& points, int threads = 0);
         Results test_all(int threads = 0);
         acmacs::chart::ProjectionModifyP make_new_projection_and_relax(const Results& results, verbose verb);
+        // switches to projection made by make_new_projection_and_relax keeping stress (table distances are the same),
+        // returns points moved by more than threshold and points having table distance to a moved point
+        std::vector<size_t> switch_to(acmacs::chart::ProjectionModifyP projection, double threshold);
 
       private:
         ChartModify& chart_;
@@ -79,8 +99,14 @@ namespace acmacs::chart
         const double grid_step_;                             // acmacs-c2: 0.01
         const double hemisphering_distance_threshold_ = 1.0; // from acmacs-c2 hemi-local test: 1.0
         const double hemisphering_stress_threshold_ = 0.25;  // stress diff within threshold -> hemisphering, from acmacs-c2 hemi-local test: 0.25
+        grid_search search_{grid_search::uniform};
+        const size_t adaptive_basins_ = 8;          // number of best coarse cells to refine around
+        const double adaptive_coarse_step_ = 0.5;   // coarse grid step, map units, refinement is done in the box of +-coarse step around basin
+        grid_refine refine_{grid_refine::full};
+        size_t local_hops_{1};                      // for grid_refine::local: points linked to the moved point by at most local_hops_ table distances are movable
         acmacs::Layout original_layout_;
         Stress stress_;
+        GridTestStream* stream_{nullptr};
         static constexpr auto optimization_method_ = acmacs::chart::optimization_method::alglib_cg_pca;
 
         void test(Result& result);
@@ -88,13 +114,42 @@ namespace acmacs::chart
         size_t antigen_serum_no(size_t point_no) const { return antigen(point_no) ? point_no : (point_no - chart_.number_of_antigens()); }
         // acmacs::Area area_for(size_t point_no) const;
         acmacs::Area area_for(const Stress::TableDistancesForPoint& table_distances_for_point) const;
+        // stress over the neighbourhood of the moved point only: movable points first, then their unmovable neighbours
+        struct LocalStress
+        {
+            Stress stress;
+            std::vector<size_t> points; // local point no -> point no in layout
+            size_t number_of_movable;
+        };
+        LocalStress make_local_stress(size_t point_no) const;
 
     }; // class GridTest::chart
 
+    // writes result of each tested point as a json line as soon as the point is tested, thread safe
+    // line: {"attempt": 0, "point_no": 5, "name": "...", "diagnosis": "trapped", "distance": 1.2, "contribution_diff": -0.4, "pos": [1.0, 2.0]}
+    class GridTestStream
+    {
+      public:
+        GridTestStream(const ChartModify& chart, std::string_view filename);
+        void attempt(size_t attempt_no) { attempt_ = attempt_no; }
+        void write(const GridTest::Result& result);
+
+      private:
+        const ChartModify& chart_;
+        std::ofstream output_;
+        std::mutex access_;
+        size_t attempt_{0};
+    };
+
     // if relax_attempts > 1, move trapped points and relax, test again, repeat while there are trapped points
     // if export_filename is not empty, exports in the json format
     // returns last grid test result and the number of grid test projections
-    std::pair<GridTest::Results, size_t> grid_test(ChartModify& chart, size_t projection_no, double grid_step, int threads, size_t relax_attempts, std::string_view export_filename, verbose verb = verbose::yes);
+    // if stream_filename is not empty, result of each tested point is written there as a json line as soon as the point is tested (see GridTestStream)
+    // with grid_retest::incremental, stress is made once and attempts after the first one retest only points affected by the previous move-and-relax
+    // (moved by more than grid step or having table distance to such a point) and points found trapped or hemisphering by the previous attempt
+    std::pair<GridTest::Results, size_t> grid_test(ChartModify& chart, size_t projection_no, double grid_step, int threads, size_t relax_attempts, std::string_view export_filename,
+                                                   grid_search search = grid_search::uniform, grid_refine refine = grid_refine::full, size_t local_hops = 1, grid_retest retest = grid_retest::all,
+                                                   std::string_view stream_filename = {}, verbose verb = verbose::yes);
 
 } // namespace acmacs
 
@@ -204,7 +204,10 @@ SeraP LispmdsChart::sera() const
 
 TitersP LispmdsChart::titers() const
 {
-    return std::make_shared<LispmdsTiters>(mData);
+    std::lock_guard<std::mutex> lock{titers_access_};
+    if (!titers_)
+        titers_ = std::make_shared<LispmdsTiters>(mData);
+    return titers_;
 
 } // LispmdsChart::titers
 
@@ -503,13 +506,7 @@ size_t LispmdsTiters::number_of_non_dont_cares() const
 
 size_t LispmdsTiters::titrations_for_antigen(size_t antigen_no) const
 {
-    size_t result = 0;
-    const auto& row = std::get<acmacs::lispmds::list>(acmacs::lispmds::get(mData, 0, 3))[antigen_no];
-    for (const auto& titer : std::get<acmacs::lispmds::list>(row)) {
-        if (!is_dontcare(titer))
-            ++result;
-    }
-    return result;
+    return statistics()->titrations_for_antigen(antigen_no);
 
 } // LispmdsTiters::titrations_for_antigen
 
@@ -517,12 +514,7 @@ size_t LispmdsTiters::titrations_for_antigen(size_t antigen_no) const
 
 size_t LispmdsTiters::titrations_for_serum(size_t serum_no) const
 {
-    size_t result = 0;
-    for (const auto& row : std::get<acmacs::lispmds::list>(acmacs::lispmds::get(mData, 0, 3))) {
-        if (!is_dontcare(std::get<acmacs::lispmds::list>(row)[serum_no]))
-            ++result;
-    }
-    return result;
+    return statistics()->titrations_for_serum(serum_no);
 
 } // LispmdsTiters::titrations_for_serum
 
@@ -31,6 +31,8 @@ namespace acmacs::chart
      private:
         acmacs::lispmds::value mData;
         mutable ProjectionsP projections_;
+        mutable TitersP titers_; // kept to reuse Titers::encoded() cache
+        mutable std::mutex titers_access_;
 
     }; // class Chart
 
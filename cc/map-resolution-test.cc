@@ -1,11 +1,243 @@
+#include <thread>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <random>
+#include <cstdint>
+#include <limits>
+#include <condition_variable>
+#include <deque>
+
 #include "acmacs-base/read-file.hh"
 #include "acmacs-base/filesystem.hh"
+#include "acmacs-base/omp.hh"
+#include "acmacs-base/log.hh"
 #include "acmacs-chart-2/map-resolution-test.hh"
 #include "acmacs-chart-2/chart-modify.hh"
 #include "acmacs-chart-2/factory-export.hh"
+#include "acmacs-chart-2/stress.hh"
+#include "acmacs-chart-2/optimize.hh"
+
+static acmacs::chart::map_resolution_test_data::Predictions make_predictions(const acmacs::chart::map_resolution_test_data::ReplicateStat& replicate_stat);
+
+namespace acmacs::chart::map_resolution_test_internal
+{
+    // writes intermediate charts in a background thread, charts are kept alive until written
+    class ChartSaver
+    {
+      public:
+        ChartSaver() = default;
+        ChartSaver(const ChartSaver&) = delete;
+        ~ChartSaver()
+        {
+            try {
+                finish();
+            }
+            catch (std::exception& err) {
+                AD_ERROR("map resolution test: {}", err);
+            }
+        }
+
+        void save(std::shared_ptr<ChartModify> chart, std::string filename)
+        {
+            std::unique_lock<std::mutex> lock{access_};
+            queue_.emplace_back(std::move(chart), std::move(filename));
+            if (!thread_.joinable())
+                thread_ = std::thread{[this]() { run(); }};
+            lock.unlock();
+            wakeup_.notify_one();
+        }
+
+        // waits for all charts to be written, rethrows the first export error
+        void finish()
+        {
+            {
+                std::lock_guard<std::mutex> lock{access_};
+                finish_ = true;
+            }
+            wakeup_.notify_one();
+            if (thread_.joinable())
+                thread_.join();
+            if (error_)
+                std::rethrow_exception(std::exchange(error_, nullptr));
+        }
+
+      private:
+        std::mutex access_;
+        std::condition_variable wakeup_;
+        std::deque<std::pair<std::shared_ptr<ChartModify>, std::string>> queue_;
+        bool finish_{false};
+        std::thread thread_;
+        std::exception_ptr error_;
+
+        void run()
+        {
+            for (;;) {
+                std::unique_lock<std::mutex> lock{access_};
+                wakeup_.wait(lock, [this]() { return finish_ || !queue_.empty(); });
+                if (queue_.empty())
+                    return; // finish_ and nothing to write
+                auto [chart, filename] = std::move(queue_.front());
+                queue_.pop_front();
+                lock.unlock();
+                try {
+                    export_factory(*chart, filename, "map_resolution_test");
+                }
+                catch (...) {
+                    std::lock_guard<std::mutex> error_lock{access_};
+                    if (!error_)
+                        error_ = std::current_exception();
+                }
+            }
+        }
+    };
+
+} // namespace acmacs::chart::map_resolution_test_internal
+
+// ----------------------------------------------------------------------
+
+acmacs::chart::map_resolution_test_internal::MaskedReplicates::MaskedReplicates(const ChartModify& master_chart, const map_resolution_test_data::Parameters& parameters)
+    : master_chart_{master_chart}, parameters_{parameters},
+      master_stress_{stress_factory(master_chart, number_of_dimensions_t{5}, parameters.minimum_column_basis, multiply_antigen_titer_until_column_adjust::yes)},
+      master_titers_{master_chart.titers()->encoded()}, master_column_bases_{master_chart.column_bases(parameters.minimum_column_basis)},
+      number_of_antigens_{master_chart.number_of_antigens()}
+{
+    if (parameters.column_bases_from_master == map_resolution_test_data::column_bases_from_master::no)
+        throw std::invalid_argument{"map resolution test: mask replicates require column bases from master"};
+    if (parameters.relax_from_full_table == map_resolution_test_data::relax_from_full_table::yes)
+        throw std::invalid_argument{"map resolution test: mask replicates do not support relax from full table"};
+    if (!parameters.save_charts_to.empty())
+        AD_WARNING("map resolution test: intermediate charts are not made for mask replicates and not saved");
+
+} // acmacs::chart::map_resolution_test_internal::MaskedReplicates::MaskedReplicates
+
+// ----------------------------------------------------------------------
+
+acmacs::chart::map_resolution_test_internal::MaskedReplicates::mask_t acmacs::chart::map_resolution_test_internal::MaskedReplicates::make_mask(double proportion_to_dont_care, std::mt19937& generator) const
+{
+    if (proportion_to_dont_care <= 0.0 || proportion_to_dont_care > 0.5)
+        throw std::invalid_argument(fmt::format("invalid proportion for map resolution test: {}", proportion_to_dont_care));
+
+    // proportion is not more than 0.5, rejection sampling of already selected entries is cheap
+    const auto entries = number_of_entries();
+    if (entries == 0)
+        throw std::invalid_argument{"map resolution test: chart has no titers to dont-care"};
+    mask_t mask((entries + 63) / 64, 0);
+    const auto entries_to_dont_care = static_cast<size_t>(std::lround(static_cast<double>(entries) * proportion_to_dont_care));
+    std::uniform_int_distribution<size_t> distribution{0, entries - 1};
+    for (size_t selected = 0; selected < entries_to_dont_care;) {
+        if (const auto entry_no = distribution(generator); !masked(mask, entry_no)) {
+            mask[entry_no / 64] |= std::uint64_t{1} << (entry_no % 64);
+            ++selected;
+        }
+    }
+    return mask;
+
+} // acmacs::chart::map_resolution_test_internal::MaskedReplicates::make_mask
+
+// ----------------------------------------------------------------------
+
+acmacs::chart::Stress acmacs::chart::map_resolution_test_internal::MaskedReplicates::make_stress(const mask_t& mask, number_of_dimensions_t number_of_dimensions) const
+{
+    const auto& master_regular = master_stress_.table_distances().regular();
+    const auto& master_less_than = master_stress_.table_distances().less_than();
+    Stress stress{number_of_dimensions, master_chart_.number_of_points()};
+    stress.parameters() = master_stress_.parameters();
+
+    const optimization_options options{parameters_.optimization_precision};
+    if (options.disconnect_too_few_numeric_titers == disconnect_few_numeric_titers::yes) {
+        // points left with too few numeric titers after masking are disconnected, as in relax_prepare()
+        std::vector<size_t> numeric_titers(master_chart_.number_of_points(), 0);
+        for (size_t entry_no = 0; entry_no < master_regular.size(); ++entry_no) {
+            if (!masked(mask, entry_no)) {
+                ++numeric_titers[master_regular[entry_no].point_1];
+                ++numeric_titers[master_regular[entry_no].point_2];
+            }
+        }
+        PointIndexList too_few;
+        for (size_t point_no = 0; point_no < numeric_titers.size(); ++point_no) {
+            if (numeric_titers[point_no] < 3)
+                too_few.insert(point_no);
+        }
+        stress.extend_disconnected(too_few);
+        if (const auto num_connected = master_chart_.number_of_points() - stress.number_of_disconnected(); num_connected < 3)
+            throw std::runtime_error{AD_FORMAT("map resolution test: too few connected points after masking: {}", num_connected)};
+    }
+    const auto& disconnected = stress.parameters().disconnected;
+    const auto connected = [&disconnected](const auto& entry) { return !disconnected.contains(entry.point_1) && !disconnected.contains(entry.point_2); };
+
+    for (size_t entry_no = 0; entry_no < master_regular.size(); ++entry_no) {
+        if (!masked(mask, entry_no) && connected(master_regular[entry_no]))
+            stress.table_distances_modify().regular().push_back(master_regular[entry_no]);
+    }
+    for (size_t entry_no = 0; entry_no < master_less_than.size(); ++entry_no) {
+        if (!masked(mask, entry_no + master_regular.size()) && connected(master_less_than[entry_no]))
+            stress.table_distances_modify().less_than().push_back(master_less_than[entry_no]);
+    }
+    return stress;
+
+} // acmacs::chart::map_resolution_test_internal::MaskedReplicates::make_stress
+
+// ----------------------------------------------------------------------
+
+acmacs::chart::map_resolution_test_data::Predictions acmacs::chart::map_resolution_test_internal::MaskedReplicates::run(number_of_dimensions_t number_of_dimensions, double proportion_to_dont_care, LayoutRandomizer::seed_t seed) const
+{
+    std::mt19937 generator{seed ? *seed : std::random_device{}()};
+    const auto mask = make_mask(proportion_to_dont_care, generator);
+    const auto start_num_dim = *number_of_dimensions < 5 ? number_of_dimensions_t{5} : number_of_dimensions; // dimension annealing as in relax()
+    auto stress = make_stress(mask, start_num_dim);
+    const auto& master_regular = master_stress_.table_distances().regular();
+    const auto& disconnected = stress.parameters().disconnected;
+    const auto connected = [&disconnected](const auto& entry) { return !disconnected.contains(entry.point_1) && !disconnected.contains(entry.point_2); };
+
+    const optimization_options options{parameters_.optimization_precision};
+    auto randomizer = randomizer_plain_from_sample_optimization(master_chart_, stress, start_num_dim, parameters_.minimum_column_basis, options.randomization_diameter_multiplier,
+                                                                generator());
+    std::optional<acmacs::Layout> best_layout;
+    double best_stress{0.0};
+    for (size_t optimization_no = 0; optimization_no < *parameters_.number_of_optimizations; ++optimization_no) {
+        acmacs::Layout layout{master_chart_.number_of_points(), start_num_dim};
+        for (size_t point_no = 0; point_no < layout.number_of_points(); ++point_no)
+            layout.update(point_no, randomizer->get(start_num_dim));
+        stress.set_coordinates_of_disconnected(layout.data(), layout.size(), std::numeric_limits<double>::quiet_NaN(), start_num_dim);
+        stress.change_number_of_dimensions(start_num_dim);
+        auto status = optimize(options.method, stress, layout.data(), layout.data() + layout.size(), start_num_dim > number_of_dimensions ? optimization_precision::rough : options.precision);
+        if (start_num_dim > number_of_dimensions) {
+            dimension_annealing(options.method, stress, start_num_dim, number_of_dimensions, layout.data(), layout.data() + layout.size());
+            layout.change_number_of_dimensions(number_of_dimensions);
+            stress.change_number_of_dimensions(number_of_dimensions);
+            status = optimize(options.method, stress, layout.data(), layout.data() + layout.size(), options.precision);
+        }
+        if (!std::isnan(status.final_stress) && (!best_layout || status.final_stress < best_stress)) {
+            best_layout = std::move(layout);
+            best_stress = status.final_stress;
+        }
+    }
+    if (!best_layout)
+        throw std::runtime_error{"map resolution test: all optimizations of a replicate failed"};
+
+    // collect errors for held out regular entries, master distance is column basis - logged titer as in collect_errors()
+    // (entry distance may be adjusted by multiply_antigen_titer_until_column_adjust)
+    // disconnected points have no coordinates, their entries are not predicted
+    map_resolution_test_data::ReplicateStat replicate_stat;
+    for (size_t entry_no = 0; entry_no < master_regular.size(); ++entry_no) {
+        if (masked(mask, entry_no) && connected(master_regular[entry_no])) {
+            const auto& entry = master_regular[entry_no];
+            const auto serum_no = entry.point_2 - number_of_antigens_;
+            const auto master_distance = master_column_bases_->column_basis(serum_no) - master_titers_->titer(entry.point_1, serum_no).logged();
+            const auto predicted_distance = best_layout->distance(entry.point_1, entry.point_2);
+            replicate_stat.prediction_errors_for_titers.emplace_back(entry.point_1, serum_no, master_distance - predicted_distance);
+            replicate_stat.master_distances.push_back(master_distance);
+            replicate_stat.predicted_distances.push_back(predicted_distance);
+        }
+    }
+    return make_predictions(replicate_stat);
+
+} // acmacs::chart::map_resolution_test_internal::MaskedReplicates::run
 
 static void relax(acmacs::chart::ChartModify& chart, acmacs::number_of_dimensions_t number_of_dimensions, const acmacs::chart::map_resolution_test_data::Parameters& parameters);
-static acmacs::chart::map_resolution_test_data::Predictions relax_with_proportion_dontcared(acmacs::chart::ChartModify& chart, acmacs::number_of_dimensions_t number_of_dimensions, double proportion_to_dont_care, size_t replicate_no, const acmacs::chart::map_resolution_test_data::Parameters& parameters);
+static void relax_replicate(acmacs::chart::ChartModify& chart, acmacs::number_of_dimensions_t number_of_dimensions, acmacs::chart::LayoutRandomizer::seed_t seed, const acmacs::chart::map_resolution_test_data::Parameters& parameters);
+static acmacs::chart::map_resolution_test_data::Predictions relax_with_proportion_dontcared(acmacs::chart::ChartModify& chart, acmacs::number_of_dimensions_t number_of_dimensions, double proportion_to_dont_care, size_t replicate_no, acmacs::chart::LayoutRandomizer::seed_t seed, acmacs::chart::map_resolution_test_internal::ChartSaver& saver, const acmacs::chart::map_resolution_test_data::Parameters& parameters);
 static acmacs::chart::map_resolution_test_data::ReplicateStat collect_errors(acmacs::chart::ChartModify& master_chart, acmacs::chart::ChartModify& prediction_chart, const acmacs::chart::map_resolution_test_data::Parameters& parameters);
 static void create_directory_for_intermediate_charts(const acmacs::chart::map_resolution_test_data::Parameters& parameters);
 
@@ -17,29 +249,66 @@ acmacs::chart::map_resolution_test_data::Results acmacs::chart::map_resolution_t
     map_resolution_test_data::Results results(parameters);
     chart.projections_modify().remove_all();
     // std::cout << "master dot-cares: " << (1.0 - chart.titers()->percent_of_non_dont_cares()) << '\n' << chart.titers()->print() << '\n';
+
+    // every replicate is a job, jobs of all dimensions and proportions are run concurrently
+    struct job_t
+    {
+        number_of_dimensions_t number_of_dimensions;
+        double proportion_to_dont_care;
+        size_t replicate_no;
+    };
+    std::vector<job_t> jobs;
     for (auto number_of_dimensions : parameters.number_of_dimensions) {
         for (auto proportion_to_dont_care : parameters.proportions_to_dont_care) {
             if (parameters.relax_from_full_table == map_resolution_test_data::relax_from_full_table::yes)
-                relax(chart, number_of_dimensions, parameters);
-            std::vector<double> av_abs_error(parameters.number_of_random_replicates_for_each_proportion), sd_error(parameters.number_of_random_replicates_for_each_proportion),
-                correlations(parameters.number_of_random_replicates_for_each_proportion), r2(parameters.number_of_random_replicates_for_each_proportion);
-            size_t number_of_samples = 0;
-            for (auto replicate_no : range(parameters.number_of_random_replicates_for_each_proportion)) {
-                const auto predictions = relax_with_proportion_dontcared(chart, number_of_dimensions, proportion_to_dont_care, replicate_no + 1, parameters);
-                av_abs_error[replicate_no] = predictions.av_abs_error;
-                sd_error[replicate_no] = predictions.sd_error;
-                correlations[replicate_no] = predictions.correlation;
-                r2[replicate_no] = predictions.linear_regression.r2();
-                number_of_samples += predictions.number_of_samples;
-            }
+                relax(chart, number_of_dimensions, parameters); // master chart is not modified by jobs
+            for (auto replicate_no : range(parameters.number_of_random_replicates_for_each_proportion))
+                jobs.push_back(job_t{number_of_dimensions, proportion_to_dont_care, replicate_no});
+        }
+    }
 
-            results.predictions().emplace_back(number_of_dimensions, proportion_to_dont_care, statistics::standard_deviation(av_abs_error), statistics::standard_deviation(sd_error),
-                                 statistics::standard_deviation(correlations), statistics::standard_deviation(r2), number_of_samples);
+    // values cached by the master chart are calculated before jobs start
+    chart.column_bases(parameters.minimum_column_basis);
+    chart.titers();
+
+    const auto base_seed = parameters.seed ? *parameters.seed : std::random_device{}();
+    std::optional<map_resolution_test_internal::MaskedReplicates> masked_replicates;
+    if (parameters.dont_care_replicates == map_resolution_test_data::dont_care_replicates::mask)
+        masked_replicates.emplace(chart, parameters);
+    map_resolution_test_internal::ChartSaver saver;
+    std::vector<std::optional<map_resolution_test_data::Predictions>> predictions(jobs.size());
+#ifdef _OPENMP
+    const int num_threads = parameters.threads <= 0 ? omp_get_max_threads() : parameters.threads;
+#endif
+#pragma omp parallel for default(shared) num_threads(num_threads) schedule(dynamic, 1)
+    for (size_t job_no = 0; job_no < jobs.size(); ++job_no) {
+        const auto& job = jobs[job_no];
+        const auto seed = static_cast<LayoutRandomizer::seed_t::value_type>(base_seed + job_no);
+        if (masked_replicates)
+            predictions[job_no] = masked_replicates->run(job.number_of_dimensions, job.proportion_to_dont_care, seed);
+        else
+            predictions[job_no] = relax_with_proportion_dontcared(chart, job.number_of_dimensions, job.proportion_to_dont_care, job.replicate_no + 1, seed, saver, parameters);
+    }
 
-            // std::cout << results.predictions().back() << '\n';
+    const auto replicates = parameters.number_of_random_replicates_for_each_proportion;
+    for (size_t first_job = 0; first_job < jobs.size(); first_job += replicates) {
+        std::vector<double> av_abs_error(replicates), sd_error(replicates), correlations(replicates), r2(replicates);
+        size_t number_of_samples = 0;
+        for (auto replicate_no : range(replicates)) {
+            const auto& replicate_predictions = *predictions[first_job + replicate_no];
+            av_abs_error[replicate_no] = replicate_predictions.av_abs_error;
+            sd_error[replicate_no] = replicate_predictions.sd_error;
+            correlations[replicate_no] = replicate_predictions.correlation;
+            r2[replicate_no] = replicate_predictions.linear_regression.r2();
+            number_of_samples += replicate_predictions.number_of_samples;
         }
+
+        results.predictions().emplace_back(jobs[first_job].number_of_dimensions, jobs[first_job].proportion_to_dont_care, statistics::standard_deviation(av_abs_error),
+                                           statistics::standard_deviation(sd_error), statistics::standard_deviation(correlations), statistics::standard_deviation(r2), number_of_samples);
+        // std::cout << results.predictions().back() << '\n';
     }
 
+    saver.finish();
     return results;
 
 } // acmacs::chart::map_resolution_test
@@ -54,39 +323,41 @@ void relax(acmacs::chart::ChartModify& chart, acmacs::number_of_dimensions_t num
 
 // ----------------------------------------------------------------------
 
+void relax_replicate(acmacs::chart::ChartModify& chart, acmacs::number_of_dimensions_t number_of_dimensions, acmacs::chart::LayoutRandomizer::seed_t seed, const acmacs::chart::map_resolution_test_data::Parameters& parameters)
+{
+    acmacs::chart::optimization_options options{parameters.optimization_precision};
+    options.num_threads = 1; // replicates are run concurrently, one thread also keeps seeded randomizations reproducible
+    chart.relax(parameters.number_of_optimizations, parameters.minimum_column_basis, number_of_dimensions, acmacs::chart::use_dimension_annealing::yes, options, {}, seed);
+
+} // relax_replicate
+
+// ----------------------------------------------------------------------
+
 acmacs::chart::map_resolution_test_data::Predictions relax_with_proportion_dontcared(acmacs::chart::ChartModify& master_chart, acmacs::number_of_dimensions_t number_of_dimensions,
-                                                                                     double proportion_to_dont_care, size_t replicate_no,
+                                                                                     double proportion_to_dont_care, size_t replicate_no, acmacs::chart::LayoutRandomizer::seed_t seed,
+                                                                                     acmacs::chart::map_resolution_test_internal::ChartSaver& saver,
                                                                                      const acmacs::chart::map_resolution_test_data::Parameters& parameters)
 {
-    acmacs::chart::ChartClone chart(master_chart, acmacs::chart::ChartClone::clone_data::titers);
+    auto chart_ptr = std::make_shared<acmacs::chart::ChartClone>(master_chart, acmacs::chart::ChartClone::clone_data::titers);
+    auto& chart = *chart_ptr;
     chart.info_modify().name_append(acmacs::string::concat(proportion_to_dont_care, "-dont-cared"));
     chart.titers_modify().remove_layers();
-    chart.titers_modify().set_proportion_of_titers_to_dont_care(proportion_to_dont_care);
+    chart.titers_modify().set_proportion_of_titers_to_dont_care(proportion_to_dont_care, seed);
     if (parameters.column_bases_from_master == acmacs::chart::map_resolution_test_data::column_bases_from_master::yes)
         chart.forced_column_bases_modify(*master_chart.column_bases(parameters.minimum_column_basis));
     if (parameters.relax_from_full_table == acmacs::chart::map_resolution_test_data::relax_from_full_table::yes) {
         auto projection = chart.projections_modify().new_by_cloning(*master_chart.projections_modify().at(0), true);
         projection->set_forced_column_bases(master_chart.column_bases(parameters.minimum_column_basis));
         projection->comment("relaxed-from-full-table-best");
-        projection->relax(acmacs::chart::optimization_options{parameters.optimization_precision});
+        acmacs::chart::optimization_options options{parameters.optimization_precision};
+        options.num_threads = 1; // replicates are run concurrently
+        projection->relax(options);
     }
-    relax(chart, number_of_dimensions, parameters);
+    relax_replicate(chart, number_of_dimensions, seed, parameters);
     chart.projections_modify().sort();
 
     // collect statistics
-    const auto replicate_stat = collect_errors(master_chart, chart, parameters);
-    std::vector<double> prediction_errors(replicate_stat.prediction_errors_for_titers.size());
-    std::transform(std::begin(replicate_stat.prediction_errors_for_titers), std::end(replicate_stat.prediction_errors_for_titers), std::begin(prediction_errors),
-                   [=](const auto& entry) -> double {
-                       // std::cout << "dim:" << number_of_dimensions << " prop:" << proportion_to_dont_care << " ag:" << entry.antigen << " sr:" << entry.serum << " err:" << entry.error << '\n';
-                       return entry.error;
-                   });
-
-    const acmacs::chart::map_resolution_test_data::Predictions predictions{
-        acmacs::statistics::mean_abs(prediction_errors), acmacs::statistics::standard_deviation(prediction_errors).population_sd(),
-        acmacs::statistics::correlation(replicate_stat.master_distances, replicate_stat.predicted_distances),
-        acmacs::statistics::simple_linear_regression(std::begin(replicate_stat.master_distances), std::end(replicate_stat.master_distances), std::begin(replicate_stat.predicted_distances)),
-        prediction_errors.size()};
+    const auto predictions = make_predictions(collect_errors(master_chart, chart, parameters));
 
     // std::cout << "replicate:" << replicate_no << " dim:" << number_of_dimensions << " prop:" << proportion_to_dont_care << '\n'
     //           << "    " << predictions << '\n'
@@ -102,7 +373,7 @@ acmacs::chart::map_resolution_test_data::Predictions relax_with_proportion_dontc
     //  }
 
     if (!parameters.save_charts_to.empty())
-        export_factory(chart, fmt::format("{}/mrt-{}d-{}-{:03d}.ace", parameters.save_charts_to, number_of_dimensions, proportion_to_dont_care, replicate_no), "map_resolution_test");
+        saver.save(chart_ptr, fmt::format("{}/mrt-{}d-{}-{:03d}.ace", parameters.save_charts_to, number_of_dimensions, proportion_to_dont_care, replicate_no));
 
     return predictions;
 
@@ -110,6 +381,22 @@ acmacs::chart::map_resolution_test_data::Predictions relax_with_proportion_dontc
 
 // ----------------------------------------------------------------------
 
+acmacs::chart::map_resolution_test_data::Predictions make_predictions(const acmacs::chart::map_resolution_test_data::ReplicateStat& replicate_stat)
+{
+    std::vector<double> prediction_errors(replicate_stat.prediction_errors_for_titers.size());
+    std::transform(std::begin(replicate_stat.prediction_errors_for_titers), std::end(replicate_stat.prediction_errors_for_titers), std::begin(prediction_errors),
+                   [=](const auto& entry) -> double { return entry.error; });
+
+    return acmacs::chart::map_resolution_test_data::Predictions{
+        acmacs::statistics::mean_abs(prediction_errors), acmacs::statistics::standard_deviation(prediction_errors).population_sd(),
+        acmacs::statistics::correlation(replicate_stat.master_distances, replicate_stat.predicted_distances),
+        acmacs::statistics::simple_linear_regression(std::begin(replicate_stat.master_distances), std::end(replicate_stat.master_distances), std::begin(replicate_stat.predicted_distances)),
+        prediction_errors.size()};
+
+} // make_predictions
+
+// ----------------------------------------------------------------------
+
 acmacs::chart::map_resolution_test_data::ReplicateStat collect_errors(acmacs::chart::ChartModify& master_chart, acmacs::chart::ChartModify& prediction_chart, const acmacs::chart::map_resolution_test_data::Parameters& parameters)
 {
     const auto number_of_antigens = master_chart.number_of_antigens();
@@ -2,10 +2,15 @@
 
 #include <vector>
 #include <iostream>
+#include <memory>
+#include <random>
+#include <cstdint>
 
 #include "acmacs-base/statistics.hh"
 #include "acmacs-chart-2/optimize-options.hh"
 #include "acmacs-chart-2/column-bases.hh"
+#include "acmacs-chart-2/randomizer.hh"
+#include "acmacs-chart-2/stress.hh"
 
 // ----------------------------------------------------------------------
 
@@ -16,6 +21,7 @@ namespace acmacs
     namespace chart
     {
         class ChartModify;
+        class EncodedTiters;
 
         namespace map_resolution_test_data
         {
@@ -28,6 +34,11 @@ namespace acmacs
             // master chart column bases
             enum class column_bases_from_master { no, yes };
 
+            // clone_chart: each replicate clones the chart, sets titers to dont-care and relaxes the chart (intermediate charts can be saved)
+            // mask: master table distances are made once, each replicate holds out entries selected by a random bitmask
+            //       (requires column_bases_from_master::yes and relax_from_full_table::no)
+            enum class dont_care_replicates { clone_chart, mask };
+
             struct Parameters
             {
                 std::vector<number_of_dimensions_t> number_of_dimensions{number_of_dimensions_t{1}, number_of_dimensions_t{2}, number_of_dimensions_t{3}, number_of_dimensions_t{4},
@@ -39,7 +50,10 @@ namespace acmacs
                 enum column_bases_from_master column_bases_from_master { column_bases_from_master::yes };
                 enum optimization_precision optimization_precision { optimization_precision::rough };
                 enum relax_from_full_table relax_from_full_table { relax_from_full_table::no };
-                std::string save_charts_to;
+                enum dont_care_replicates dont_care_replicates { dont_care_replicates::clone_chart };
+                std::string save_charts_to;                       // charts are written in a background thread
+                LayoutRandomizer::seed_t seed{};                  // replicate job number is added to seed to select titers to dont-care and to randomize replicate layouts, random if not set
+                int threads{0};                                   // replicate jobs run concurrently, 0 - autodetect
             };
 
             // ----------------------------------------------------------------------
@@ -114,6 +128,39 @@ namespace acmacs
 
         map_resolution_test_data::Results map_resolution_test(ChartModify& chart, const map_resolution_test_data::Parameters& parameters);
 
+        namespace map_resolution_test_internal
+        {
+            // Master table distances are made once, a replicate holds out a random subset of entries selected by a bitmask
+            // and relaxes the remaining ones directly, no chart is cloned and no titers are parsed again.
+            // Held-out regular entries are used to collect prediction errors (see collect_errors()).
+            class MaskedReplicates
+            {
+              public:
+                using mask_t = std::vector<std::uint64_t>; // entries are numbered: regular first, then less than
+
+                MaskedReplicates(const ChartModify& master_chart, const map_resolution_test_data::Parameters& parameters);
+
+                map_resolution_test_data::Predictions run(number_of_dimensions_t number_of_dimensions, double proportion_to_dont_care, LayoutRandomizer::seed_t seed) const;
+
+                mask_t make_mask(double proportion_to_dont_care, std::mt19937& generator) const;
+                // master table distances not held out by the mask, points left with too few numeric titers are disconnected and their entries removed
+                Stress make_stress(const mask_t& mask, number_of_dimensions_t number_of_dimensions) const;
+
+                const Stress& master_stress() const { return master_stress_; }
+                size_t number_of_entries() const { return master_stress_.table_distances().regular().size() + master_stress_.table_distances().less_than().size(); }
+                static bool masked(const mask_t& mask, size_t entry_no) { return (mask[entry_no / 64] >> (entry_no % 64)) & 1; }
+
+              private:
+                const ChartModify& master_chart_;
+                const map_resolution_test_data::Parameters& parameters_;
+                Stress master_stress_;
+                std::shared_ptr<const EncodedTiters> master_titers_;
+                std::shared_ptr<ColumnBases> master_column_bases_;
+                size_t number_of_antigens_;
+            };
+
+        } // namespace map_resolution_test_internal
+
 
     } // namespace chart
 
@@ -164,7 +211,11 @@ template <> struct fmt::formatter<acmacs::chart::map_resolution_test_data::Param
         fmt::format_to(ctx.out(), "  column_bases_from_master:                        {}\n", param.column_bases_from_master);
         fmt::format_to(ctx.out(), "  optimization_precision:                          {}\n", param.optimization_precision);
         fmt::format_to(ctx.out(), "  relax_from_full_table:                           {}\n",   param.relax_from_full_table);
-        fmt::format_to(ctx.out(), "  save_charts_to:                                  {}",   param.relax_from_full_table);
+        fmt::format_to(ctx.out(), "  dont_care_replicates:                            {}\n", param.dont_care_replicates == acmacs::chart::map_resolution_test_data::dont_care_replicates::mask ? "mask" : "clone-chart");
+        fmt::format_to(ctx.out(), "  save_charts_to:                                  {}\n", param.save_charts_to);
+        if (param.seed)
+            fmt::format_to(ctx.out(), "  seed:                                            {}\n", *param.seed);
+        fmt::format_to(ctx.out(), "  threads:                                         {}", param.threads);
         return ctx.out();
     }
 };
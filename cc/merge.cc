@@ -6,7 +6,7 @@
 // ----------------------------------------------------------------------
 
 static void merge_info(acmacs::chart::ChartModify& target, const acmacs::chart::Chart& chart1, const acmacs::chart::Chart& chart2);
-static void merge_titers(acmacs::chart::ChartModify& result, const acmacs::chart::Chart& chart1, const acmacs::chart::Chart& chart2, acmacs::chart::MergeReport& report);
+static void merge_titers(acmacs::chart::ChartModify& result, const acmacs::chart::Chart& chart1, const acmacs::chart::Chart& chart2, acmacs::chart::MergeReport& report, acmacs::chart::TitersModify::make_merge_report make_report);
 static void merge_plot_spec(acmacs::chart::ChartModify& result, const acmacs::chart::Chart& chart1, const acmacs::chart::Chart& chart2, const acmacs::chart::MergeReport& report);
 static void merge_projections_type2(acmacs::chart::ChartModify& result, const acmacs::chart::Chart& chart1, const acmacs::chart::Chart& chart2, acmacs::chart::MergeReport& report);
 static void merge_projections_type3(acmacs::chart::ChartModify& result, const acmacs::chart::Chart& chart1, const acmacs::chart::Chart& chart2, acmacs::chart::MergeReport& report);
@@ -214,7 +214,7 @@ std::pair<acmacs::chart::ChartModifyP, acmacs::chart::MergeReport> acmacs::chart
         throw merge_error{err_message};
     }
 
-    merge_titers(*result, chart1, chart2, report);
+    merge_titers(*result, chart1, chart2, report, settings.titer_merge_report_);
     merge_plot_spec(*result, chart1, chart2, report);
 
     if (chart1.number_of_projections()) {
@@ -254,7 +254,7 @@ std::pair<acmacs::chart::ChartModifyP, acmacs::chart::MergeReport> acmacs::chart
 
 // ----------------------------------------------------------------------
 
-void merge_titers(acmacs::chart::ChartModify& result, const acmacs::chart::Chart& chart1, const acmacs::chart::Chart& chart2, acmacs::chart::MergeReport& report)
+void merge_titers(acmacs::chart::ChartModify& result, const acmacs::chart::Chart& chart1, const acmacs::chart::Chart& chart2, acmacs::chart::MergeReport& report, acmacs::chart::TitersModify::make_merge_report make_report)
 {
     auto& titers = result.titers_modify();
     auto titers1 = chart1.titers(), titers2 = chart2.titers();
@@ -284,7 +284,7 @@ void merge_titers(acmacs::chart::ChartModify& result, const acmacs::chart::Chart
     };
     copy_layers(layers1, *titers1, report.antigens_primary_target, report.sera_primary_target);
     copy_layers(layers2, *titers2, report.antigens_secondary_target, report.sera_secondary_target);
-    report.titer_report = titers.set_from_layers(result);
+    report.titer_report = titers.set_from_layers(result, make_report);
 }
 
 // ----------------------------------------------------------------------
@@ -565,6 +565,8 @@ std::string acmacs::chart::MergeReport::titer_merge_diagnostics(const ChartModif
     auto ags = chart.antigens();
     auto srs = chart.sera();
     auto tt = chart.titers();
+    if (!titer_report)
+        throw merge_error{"titer merge report was not requested, see MergeSettings::titer_merge_report_"};
 
     fmt::memory_buffer output;
     fmt::format_to_mb(output, "{:{}s}", "", max_field_size);
@@ -596,10 +598,13 @@ std::string acmacs::chart::MergeReport::titer_merge_diagnostics(const ChartModif
 
         fmt::format_to_mb(output, "{:<{}s}", "Report (see below)", max_field_size + 2);
         for (auto sr_no : sera) {
-            if (const auto found = std::find_if(titer_report->begin(), titer_report->end(), [ag_no=ag_no,sr_no](const auto& entry) { return entry.antigen == ag_no && entry.serum == sr_no; }); found != titer_report->end())
+            // report is ordered by antigen then serum, cells without titers in layers are not there
+            const auto found = std::lower_bound(titer_report->begin(), titer_report->end(), std::pair{ag_no, sr_no},
+                                                [](const auto& entry, const auto& ag_sr) { return std::pair{entry.antigen, entry.serum} < ag_sr; });
+            if (found != titer_report->end() && found->antigen == ag_no && found->serum == sr_no)
                 fmt::format_to_mb(output, "{:>7s}", TitersModify::titer_merge_report_brief(found->report));
             else
-                fmt::format_to_mb(output, "       ");
+                fmt::format_to_mb(output, "{:>7s}", TitersModify::titer_merge_report_brief(TitersModify::titer_merge::all_dontcare));
         }
         fmt::format_to_mb(output, "\n\n");
     }
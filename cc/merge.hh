@@ -28,6 +28,7 @@ namespace acmacs::chart
         projection_merge_t projection_merge{projection_merge_t::type1};
         combine_cheating_assays combine_cheating_assays_{combine_cheating_assays::no};
         remove_distinct remove_distinct_{remove_distinct::no};
+        TitersModify::make_merge_report titer_merge_report_{TitersModify::make_merge_report::no}; // yes is required for MergeReport::titer_merge_report*()
     };
 
     struct MergeReport
@@ -54,7 +55,7 @@ namespace acmacs::chart
         CommonAntigensSera common;
         index_mapping_t antigens_primary_target, antigens_secondary_target, sera_primary_target, sera_secondary_target;
         size_t target_antigens = 0, target_sera = 0;
-        std::unique_ptr<TitersModify::titer_merge_report> titer_report;
+        std::unique_ptr<TitersModify::titer_merge_report> titer_report; // nullptr unless requested by MergeSettings::titer_merge_report_
     };
 
     std::pair<ChartModifyP, MergeReport> merge(const Chart& chart1, const Chart& chart2, const MergeSettings& settings = {});
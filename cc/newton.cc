@@ -0,0 +1,252 @@
+#include <vector>
+#include <cmath>
+#include <numeric>
+#include <algorithm>
+#include <limits>
+
+#include "acmacs-base/fmt.hh"
+#include "acmacs-base/sigmoid.hh"
+#include "acmacs-chart-2/newton.hh"
+#include "acmacs-chart-2/alglib.hh"
+#include "acmacs-chart-2/optimize.hh"
+#include "acmacs-chart-2/stress.hh"
+
+// ----------------------------------------------------------------------
+
+namespace acmacs::chart::newton
+{
+    constexpr const size_t max_sweeps{1000};
+    constexpr const double relative_stress_tolerance{1e-12}; // stop when a sweep improves stress by less than this fraction
+    constexpr const double step_tolerance{1e-9};             // stop when no point moved farther than this
+    constexpr const double max_step{1.0};                    // trust region radius for a single point move, in map units
+    constexpr const double damping_increase{10.0};
+    constexpr const double max_damping{1e8};
+
+    struct Neighbour
+    {
+        size_t point_no;
+        double distance;
+        bool less_than;
+    };
+
+    // table distances for each point in compressed sparse row form
+    class Neighbours
+    {
+      public:
+        Neighbours(const acmacs::chart::TableDistances& table_distances, size_t number_of_points) : offsets_(number_of_points + 1, 0)
+        {
+            const auto count = [this](const auto& entries) {
+                for (const auto& entry : entries) {
+                    ++offsets_[entry.point_1 + 1];
+                    ++offsets_[entry.point_2 + 1];
+                }
+            };
+            count(table_distances.regular());
+            count(table_distances.less_than());
+            std::partial_sum(offsets_.begin(), offsets_.end(), offsets_.begin());
+            neighbours_.resize(offsets_.back());
+            std::vector<size_t> fill(offsets_.begin(), offsets_.end() - 1);
+            const auto add = [this, &fill](const auto& entries, bool less_than) {
+                for (const auto& entry : entries) {
+                    neighbours_[fill[entry.point_1]++] = Neighbour{entry.point_2, entry.distance, less_than};
+                    neighbours_[fill[entry.point_2]++] = Neighbour{entry.point_1, entry.distance, less_than};
+                }
+            };
+            add(table_distances.regular(), false);
+            add(table_distances.less_than(), true);
+        }
+
+        const Neighbour* begin(size_t point_no) const { return neighbours_.data() + offsets_[point_no]; }
+        const Neighbour* end(size_t point_no) const { return neighbours_.data() + offsets_[point_no + 1]; }
+        bool empty(size_t point_no) const { return offsets_[point_no] == offsets_[point_no + 1]; }
+        size_t size(size_t point_no) const { return offsets_[point_no + 1] - offsets_[point_no]; }
+        size_t size() const { return neighbours_.size(); } // each table distance is counted for both its points
+
+      private:
+        std::vector<size_t> offsets_;
+        std::vector<Neighbour> neighbours_;
+    };
+
+    // ----------------------------------------------------------------------
+
+    // per-point term of the stress as a function of the map distance, with its first and second derivatives by the map distance
+    struct Term
+    {
+        double value, d1, d2;
+    };
+
+    inline Term term(const Neighbour& neighbour, double map_dist)
+    {
+        if (!neighbour.less_than) {
+            const double diff = neighbour.distance - map_dist;
+            return {diff * diff, -2.0 * diff, 2.0};
+        }
+        else {
+            constexpr const double mult = acmacs::chart::SigmoidMutiplier();
+            const double diff = neighbour.distance - map_dist + 1;
+            const double sigm = acmacs::sigmoid(diff * mult), d_sigm = acmacs::d_sigmoid(diff * mult) * mult, d2_sigm = d_sigm * (1.0 - 2.0 * sigm) * mult;
+            // derivatives by diff, diff = const - map_dist: first derivative changes sign, second does not
+            const double g1 = 2.0 * diff * sigm + diff * diff * d_sigm;
+            const double g2 = 2.0 * sigm + 4.0 * diff * d_sigm + diff * diff * d2_sigm;
+            return {diff * diff * sigm, -g1, g2};
+        }
+    }
+
+    inline double distance(const double* p1, const double* p2, size_t num_dim)
+    {
+        double sum{0};
+        for (size_t dim = 0; dim < num_dim; ++dim)
+            sum += (p1[dim] - p2[dim]) * (p1[dim] - p2[dim]);
+        return std::sqrt(sum);
+    }
+
+    // stress contribution of the point placed at coordinates, other points are taken from layout
+    inline double contribution(const Neighbours& neighbours, size_t point_no, const double* coordinates, const double* layout, size_t num_dim)
+    {
+        double sum{0};
+        for (auto neighbour = neighbours.begin(point_no); neighbour != neighbours.end(point_no); ++neighbour)
+            sum += term(*neighbour, distance(coordinates, layout + neighbour->point_no * num_dim, num_dim)).value;
+        return sum;
+    }
+
+    // gradient and hessian (num_dim×num_dim, row major) of the point contribution by the point coordinates
+    inline void gradient_hessian(const Neighbours& neighbours, size_t point_no, const double* layout, size_t num_dim, std::vector<double>& gradient, std::vector<double>& hessian, std::vector<double>& unit)
+    {
+        std::fill(gradient.begin(), gradient.end(), 0.0);
+        std::fill(hessian.begin(), hessian.end(), 0.0);
+        const double* coordinates = layout + point_no * num_dim;
+        for (auto neighbour = neighbours.begin(point_no); neighbour != neighbours.end(point_no); ++neighbour) {
+            const double* another = layout + neighbour->point_no * num_dim;
+            const double map_dist = std::max(distance(coordinates, another, num_dim), 1e-5);
+            for (size_t dim = 0; dim < num_dim; ++dim)
+                unit[dim] = (coordinates[dim] - another[dim]) / map_dist;
+            const auto trm = term(*neighbour, map_dist);
+            // d(map_dist)/dx = unit, d2(map_dist)/dx2 = (I - unit unit^T) / map_dist
+            for (size_t row = 0; row < num_dim; ++row) {
+                gradient[row] += trm.d1 * unit[row];
+                for (size_t col = 0; col < num_dim; ++col)
+                    hessian[row * num_dim + col] += (trm.d2 - trm.d1 / map_dist) * unit[row] * unit[col] + (row == col ? trm.d1 / map_dist : 0.0);
+            }
+        }
+    }
+
+    // solves (hessian + damping * I) step = -gradient by Cholesky decomposition, returns false if matrix is not positive definite
+    inline bool solve(const std::vector<double>& hessian, const std::vector<double>& gradient, double damping, size_t num_dim, std::vector<double>& lower, std::vector<double>& step)
+    {
+        for (size_t row = 0; row < num_dim; ++row) {
+            for (size_t col = 0; col <= row; ++col) {
+                double sum = hessian[row * num_dim + col] + (row == col ? damping : 0.0);
+                for (size_t k = 0; k < col; ++k)
+                    sum -= lower[row * num_dim + k] * lower[col * num_dim + k];
+                if (row == col) {
+                    if (sum <= 0.0)
+                        return false;
+                    lower[row * num_dim + row] = std::sqrt(sum);
+                }
+                else
+                    lower[row * num_dim + col] = sum / lower[col * num_dim + col];
+            }
+        }
+        for (size_t row = 0; row < num_dim; ++row) { // L y = -g
+            double sum = -gradient[row];
+            for (size_t k = 0; k < row; ++k)
+                sum -= lower[row * num_dim + k] * step[k];
+            step[row] = sum / lower[row * num_dim + row];
+        }
+        for (size_t row = num_dim; row > 0; --row) { // L^T s = y
+            double sum = step[row - 1];
+            for (size_t k = row; k < num_dim; ++k)
+                sum -= lower[k * num_dim + row - 1] * step[k];
+            step[row - 1] = sum / lower[(row - 1) * num_dim + row - 1];
+        }
+        return true;
+    }
+
+} // namespace acmacs::chart::newton
+
+// ----------------------------------------------------------------------
+
+void acmacs::chart::newton::block_optimize(acmacs::chart::optimization_status& status, acmacs::chart::OptimiserCallbackData& callback_data, double* arg_first, double* arg_last,
+                                           acmacs::chart::optimization_precision precision)
+{
+    alglib::cg_optimize(status, callback_data, arg_first, arg_last, precision == optimization_precision::fine ? optimization_precision::rough : precision);
+    if (precision != optimization_precision::fine)
+        return;
+
+    const auto& stress = callback_data.stress;
+    const auto num_dim = static_cast<size_t>(stress.number_of_dimensions());
+    const auto number_of_points = static_cast<size_t>(arg_last - arg_first) / num_dim;
+    const Neighbours neighbours(stress.table_distances(), number_of_points);
+
+    std::vector<bool> movable(number_of_points, true);
+    for (const auto p_no : stress.parameters().unmovable)
+        movable[p_no] = false;
+    for (const auto p_no : stress.parameters().disconnected)
+        movable[p_no] = false;
+    std::vector<bool> movable_in_the_last_dimension(number_of_points, true);
+    for (const auto p_no : stress.parameters().unmovable_in_the_last_dimension)
+        movable_in_the_last_dimension[p_no] = false;
+
+    std::vector<double> gradient(num_dim), hessian(num_dim * num_dim), lower(num_dim * num_dim), step(num_dim), unit(num_dim), candidate(num_dim);
+    double current_stress = stress.value(arg_first);
+    ++status.number_of_stress_calculations;
+    size_t terms_evaluated{0}; // by per point gradient/hessian and contribution calls, converted into full stress calculations at the end
+    size_t sweep_no = 0;
+    for (; sweep_no < max_sweeps; ++sweep_no) {
+        double max_move{0};
+        for (size_t point_no = 0; point_no < number_of_points; ++point_no) {
+            if (!movable[point_no] || neighbours.empty(point_no))
+                continue;
+            double* coordinates = arg_first + point_no * num_dim;
+            gradient_hessian(neighbours, point_no, arg_first, num_dim, gradient, hessian, unit);
+            terms_evaluated += neighbours.size(point_no);
+            if (!movable_in_the_last_dimension[point_no]) {
+                gradient[num_dim - 1] = 0.0;
+                for (size_t dim = 0; dim < num_dim; ++dim)
+                    hessian[(num_dim - 1) * num_dim + dim] = hessian[dim * num_dim + num_dim - 1] = (dim == (num_dim - 1) ? 1.0 : 0.0);
+            }
+            const double point_contribution = contribution(neighbours, point_no, coordinates, arg_first, num_dim);
+            terms_evaluated += neighbours.size(point_no);
+            double diagonal_scale{0};
+            for (size_t dim = 0; dim < num_dim; ++dim)
+                diagonal_scale = std::max(diagonal_scale, std::abs(hessian[dim * num_dim + dim]));
+            for (double damping = 0.0; damping < max_damping; damping = std::max(damping * damping_increase, 1e-6 * (diagonal_scale + 1.0))) {
+                if (!solve(hessian, gradient, damping, num_dim, lower, step))
+                    continue;
+                const double step_length = std::sqrt(std::inner_product(step.begin(), step.end(), step.begin(), 0.0));
+                const double scale = step_length > max_step ? max_step / step_length : 1.0;
+                for (size_t dim = 0; dim < num_dim; ++dim)
+                    candidate[dim] = coordinates[dim] + step[dim] * scale;
+                terms_evaluated += neighbours.size(point_no);
+                if (contribution(neighbours, point_no, candidate.data(), arg_first, num_dim) < point_contribution) {
+                    std::copy(candidate.begin(), candidate.end(), coordinates);
+                    max_move = std::max(max_move, step_length * scale);
+                    break;
+                }
+            }
+        }
+        ++status.number_of_iterations;
+        ++status.number_of_stress_calculations;
+        const double new_stress = stress.value(arg_first);
+        if (callback_data.report_iterations()) {
+            callback_data.gradient_norm = std::numeric_limits<double>::quiet_NaN(); // full gradient is not evaluated
+            callback_data.iteration_done(arg_first, static_cast<size_t>(arg_last - arg_first), new_stress);
+        }
+        const bool converged = (current_stress - new_stress) <= (relative_stress_tolerance * current_stress) || max_move < step_tolerance;
+        current_stress = new_stress;
+        if (converged) {
+            ++sweep_no;
+            break;
+        }
+    }
+    // per point evaluations are counted as full stress calculations over all table distances (as epochs of stochastic optimization)
+    if (neighbours.size() > 0)
+        status.number_of_stress_calculations += (terms_evaluated + neighbours.size() - 1) / neighbours.size();
+    status.termination_report = fmt::format("cg: {}; newton: {} sweeps", status.termination_report, sweep_no);
+
+} // acmacs::chart::newton::block_optimize
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "acmacs-chart-2/optimization-precision.hh"
+
+// ----------------------------------------------------------------------
+
+namespace acmacs::chart
+{
+    struct optimization_status;
+    struct OptimiserCallbackData;
+}
+
+// ----------------------------------------------------------------------
+
+namespace acmacs::chart::newton
+{
+    // rough alglib cg followed (for fine precision) by sweeps of damped per-point Newton steps,
+    // each point is moved using its exact d×d hessian block with all other points fixed (block Gauss-Seidel)
+    void block_optimize(acmacs::chart::optimization_status& status, acmacs::chart::OptimiserCallbackData& callback_data, double* arg_first, double* arg_last, acmacs::chart::optimization_precision precision);
+
+} // namespace acmacs::chart::newton
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -15,6 +15,8 @@ namespace acmacs::chart
     enum class optimization_method {
         alglib_lbfgs_pca,
         alglib_cg_pca,
+        sgd_adam_lbfgs_pca, // mini-batch adam over table distances, then full-batch alglib lbfgs, for huge tables
+        newton_block_pca,   // alglib cg for rough, then per-point damped newton steps for fine
         // optimlib_bfgs_pca,
         // optimlib_differential_evolution,
     };
@@ -42,6 +44,7 @@ namespace acmacs::chart
         multiply_antigen_titer_until_column_adjust mult{multiply_antigen_titer_until_column_adjust::yes};
         double randomization_diameter_multiplier{2.0}; // for layout randomizations
         int num_threads{0};                            // 0 - omp_get_max_threads()
+        size_t trace_capacity{0};                      // > 0 - collect per-iteration trace of that many last iterations into optimization_status::trace
 
     }; // struct optimization_options
 
@@ -88,6 +91,10 @@ template <> struct fmt::formatter<acmacs::chart::optimization_method> : public f
               return fmt::format_to(ctx.out(), "alglib_lbfgs_pca");
           case optimization_method::alglib_cg_pca:
               return fmt::format_to(ctx.out(), "alglib_cg_pca");
+          case optimization_method::sgd_adam_lbfgs_pca:
+              return fmt::format_to(ctx.out(), "sgd_adam_lbfgs_pca");
+          case optimization_method::newton_block_pca:
+              return fmt::format_to(ctx.out(), "newton_block_pca");
           // case optimization_method::optimlib_bfgs_pca:
           //     return fmt::format_to(ctx.out(), "optimlib_bfgs_pca");
           // case optimization_method::optimlib_differential_evolution:
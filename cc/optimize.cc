@@ -2,11 +2,15 @@
 
 #include "acmacs-base/timeit.hh"
 #include "acmacs-base/sigmoid.hh"
+#include "acmacs-base/enumerate.hh"
+#include "acmacs-base/to-json.hh"
 #include "acmacs-chart-2/stress.hh"
 #include "acmacs-chart-2/chart-modify.hh"
 #include "acmacs-chart-2/randomizer.hh"
 #include "acmacs-chart-2/disconnected-points-handler.hh"
 #include "acmacs-chart-2/alglib.hh"
+#include "acmacs-chart-2/stochastic.hh"
+#include "acmacs-chart-2/newton.hh"
 // #include "acmacs-chart-2/optim.hh"
 
 // ----------------------------------------------------------------------
@@ -25,12 +29,16 @@ acmacs::chart::optimization_method acmacs::chart::optimization_method_from_strin
         method = optimization_method::alglib_lbfgs_pca;
     else if (source == "alglib-cg")
         method = optimization_method::alglib_cg_pca;
+    else if (source == "sgd-adam")
+        method = optimization_method::sgd_adam_lbfgs_pca;
+    else if (source == "newton-block")
+        method = optimization_method::newton_block_pca;
     // else if (source == "optim-bfgs")
     //     method = optimization_method::optimlib_bfgs_pca;
     // else if (source == "optim-differential-evolution")
     //     method = optimization_method::optimlib_differential_evolution;
     else
-        throw std::runtime_error{fmt::format("unrecognized method: \"{}\", expected: alglib-lbfgs, alglib-cg", source)};
+        throw std::runtime_error{fmt::format("unrecognized method: \"{}\", expected: alglib-lbfgs, alglib-cg, sgd-adam, newton-block", source)};
     return method;
 
 } // acmacs::chart::optimization_method_from_string
@@ -41,8 +49,11 @@ acmacs::chart::optimization_status acmacs::chart::optimize(acmacs::chart::Projec
 {
     auto layout = projection.layout_modified();
     auto stress = stress_factory(projection, options.mult);
-    OptimiserCallbackData callback_data(stress);
-    return optimize(options.method, callback_data, layout->data(), layout->data() + layout->size(), options.precision);
+    auto trace = make_optimization_trace(options);
+    OptimiserCallbackData callback_data(stress, trace.get());
+    auto status = optimize(options.method, callback_data, layout->data(), layout->data() + layout->size(), options.precision);
+    status.trace = trace;
+    return status;
 
 } // acmacs::chart::optimize
 
@@ -52,8 +63,11 @@ acmacs::chart::optimization_status acmacs::chart::optimize(ProjectionModify& pro
 {
     auto layout = projection.layout_modified();
     auto stress = stress_factory(projection, options.mult);
-    OptimiserCallbackData callback_data(stress, intermediate_layouts);
-    return optimize(options.method, callback_data, layout->data(), layout->data() + layout->size(), options.precision);
+    auto trace = make_optimization_trace(options);
+    OptimiserCallbackData callback_data(stress, intermediate_layouts, trace.get());
+    auto status = optimize(options.method, callback_data, layout->data(), layout->data() + layout->size(), options.precision);
+    status.trace = trace;
+    return status;
 
 } // acmacs::chart::optimize
 
@@ -66,6 +80,7 @@ acmacs::chart::optimization_status acmacs::chart::optimize(ProjectionModify& pro
 
     const auto start = std::chrono::high_resolution_clock::now();
     optimization_status status(options.method);
+    status.trace = make_optimization_trace(options);
     auto layout = projection.layout_modified();
     auto stress = stress_factory(projection, options.mult);
 
@@ -76,7 +91,7 @@ acmacs::chart::optimization_status acmacs::chart::optimize(ProjectionModify& pro
             layout->change_number_of_dimensions(num_dims);
             stress.change_number_of_dimensions(num_dims);
         }
-        const auto sub_status = optimize(options.method, stress, layout->data(), layout->data() + layout->size(), options.precision);
+        const auto sub_status = optimize(options.method, stress, layout->data(), layout->data() + layout->size(), options.precision, status.trace.get());
         if (initial_opt) {
             status.initial_stress = sub_status.initial_stress;
             status.termination_report = sub_status.termination_report;
@@ -106,9 +121,9 @@ acmacs::chart::optimization_status acmacs::chart::optimize(acmacs::chart::ChartM
 
 // ----------------------------------------------------------------------
 
-acmacs::chart::optimization_status acmacs::chart::optimize(optimization_method optimization_method, const Stress& stress, double* arg_first, double* arg_last, optimization_precision precision)
+acmacs::chart::optimization_status acmacs::chart::optimize(optimization_method optimization_method, const Stress& stress, double* arg_first, double* arg_last, optimization_precision precision, OptimizationTrace* trace)
 {
-    OptimiserCallbackData callback_data(stress);
+    OptimiserCallbackData callback_data(stress, trace);
     return optimize(optimization_method, callback_data, arg_first, arg_last, precision);
 
 } // acmacs::chart::optimize
@@ -121,6 +136,8 @@ acmacs::chart::optimization_status acmacs::chart::optimize(acmacs::chart::optimi
     DisconnectedPointsHandler disconnected_point_handler{callback_data.stress, arg_first, static_cast<size_t>(arg_last - arg_first)};
     optimization_status status(optimization_method);
     status.initial_stress = callback_data.stress.value(arg_first);
+    if (callback_data.trace)
+        callback_data.previous_arg.assign(arg_first, arg_last);
     const auto start = std::chrono::high_resolution_clock::now();
     switch (optimization_method) {
         case optimization_method::alglib_lbfgs_pca:
@@ -129,6 +146,12 @@ acmacs::chart::optimization_status acmacs::chart::optimize(acmacs::chart::optimi
         case optimization_method::alglib_cg_pca:
             alglib::cg_optimize(status, callback_data, arg_first, arg_last, precision);
             break;
+        case optimization_method::sgd_adam_lbfgs_pca:
+            stochastic::adam_lbfgs_optimize(status, callback_data, arg_first, arg_last, precision);
+            break;
+        case optimization_method::newton_block_pca:
+            newton::block_optimize(status, callback_data, arg_first, arg_last, precision);
+            break;
         // case optimization_method::optimlib_bfgs_pca:
         //     optim::bfgs(status, callback_data, arg_first, arg_last, precision);
         //     break;
@@ -145,6 +168,73 @@ acmacs::chart::optimization_status acmacs::chart::optimize(acmacs::chart::optimi
 
 // ----------------------------------------------------------------------
 
+void acmacs::chart::OptimiserCallbackData::iteration_done(const double* arg_first, size_t num_args, double stress_value)
+{
+    ++iteration_no;
+    if (intermediate_layouts)
+        intermediate_layouts->emplace_back(stress.number_of_dimensions(), arg_first, static_cast<long>(num_args), stress_value);
+    if (trace) {
+        double step_length{0.0};
+        if (previous_arg.size() == num_args)
+            step_length = std::sqrt(std::inner_product(arg_first, arg_first + num_args, previous_arg.begin(), 0.0, std::plus<>{}, [](double a1, double a2) { return (a1 - a2) * (a1 - a2); }));
+        previous_arg.assign(arg_first, arg_first + num_args);
+        trace->add(stress_value, gradient_norm, step_length);
+    }
+
+} // acmacs::chart::OptimiserCallbackData::iteration_done
+
+// ----------------------------------------------------------------------
+
+std::string acmacs::chart::export_traces_to_json(const std::vector<optimization_status>& statuses)
+{
+    to_json::array optimizations;
+    for (auto [optimization_no, status] : acmacs::enumerate(statuses)) {
+        if (!status.trace)
+            continue;
+        to_json::array iterations;
+        for (size_t entry_no = 0; entry_no < status.trace->size(); ++entry_no) {
+            const auto& entry = (*status.trace)[entry_no];
+            iterations << to_json::object{
+                to_json::key_val{"iteration", entry.iteration},
+                to_json::key_val{"stress", entry.stress},
+                to_json::key_val{"gradient_norm", std::isnan(entry.gradient_norm) ? -1.0 : entry.gradient_norm}, // -1: full gradient was not evaluated
+                to_json::key_val{"step_length", entry.step_length},
+                to_json::key_val{"time_us", entry.time.count()},
+            };
+        }
+        optimizations << to_json::object{
+            to_json::key_val{"optimization_no", optimization_no},
+            to_json::key_val{"method", fmt::format("{}", status.method)},
+            to_json::key_val{"initial_stress", status.initial_stress},
+            to_json::key_val{"final_stress", status.final_stress},
+            to_json::key_val{"total_iterations", status.trace->total()},
+            to_json::key_val{"iterations", std::move(iterations)},
+        };
+    }
+    return fmt::format("{}\n", to_json::object{to_json::key_val{"  version", "optimization-trace-v1"}, to_json::key_val{"optimizations", std::move(optimizations)}});
+
+} // acmacs::chart::export_traces_to_json
+
+// ----------------------------------------------------------------------
+
+std::string acmacs::chart::export_traces_to_csv(const std::vector<optimization_status>& statuses)
+{
+    fmt::memory_buffer out;
+    fmt::format_to_mb(out, "optimization_no,iteration,stress,gradient_norm,step_length,time_us\n");
+    for (auto [optimization_no, status] : acmacs::enumerate(statuses)) {
+        if (!status.trace)
+            continue;
+        for (size_t entry_no = 0; entry_no < status.trace->size(); ++entry_no) {
+            const auto& entry = (*status.trace)[entry_no];
+            fmt::format_to_mb(out, "{},{},{:.10f},{:.10g},{:.10g},{}\n", optimization_no, entry.iteration, entry.stress, entry.gradient_norm, entry.step_length, entry.time.count());
+        }
+    }
+    return fmt::to_string(out);
+
+} // acmacs::chart::export_traces_to_csv
+
+// ----------------------------------------------------------------------
+
 acmacs::chart::ErrorLines acmacs::chart::error_lines(const acmacs::chart::Projection& projection)
 {
     auto layout = projection.layout();
@@ -176,6 +266,8 @@ acmacs::chart::DimensionAnnelingStatus acmacs::chart::dimension_annealing(optimi
     switch (optimization_method) {
         case optimization_method::alglib_lbfgs_pca:
         case optimization_method::alglib_cg_pca:
+        case optimization_method::sgd_adam_lbfgs_pca:
+        case optimization_method::newton_block_pca:
             // case optimization_method::optimlib_bfgs_pca:
             alglib::pca(callback_data, source_number_of_dimensions, target_number_of_dimensions, arg_first, arg_last);
             break;
@@ -2,6 +2,8 @@
 
 #include <stdexcept>
 #include <chrono>
+#include <numeric>
+#include <limits>
 
 #include "acmacs-base/layout.hh"
 #include "acmacs-chart-2/optimize-options.hh"
@@ -32,6 +34,39 @@ namespace acmacs::chart
 
     // ----------------------------------------------------------------------
 
+    // per-iteration optimizer telemetry, collected by optimizer step callback into a preallocated ring buffer
+    class OptimizationTrace
+    {
+      public:
+        struct Entry
+        {
+            size_t iteration;
+            double stress;
+            double gradient_norm; // NaN if method does not evaluate full gradient
+            double step_length;
+            std::chrono::microseconds time; // since trace creation
+        };
+
+        static constexpr size_t default_capacity{10000};
+
+        OptimizationTrace(size_t capacity = default_capacity) : entries_(std::max(capacity, 1UL)) {}
+
+        void add(double stress, double gradient_norm, double step_length)
+        {
+            entries_[total_ % entries_.size()] = Entry{total_, stress, gradient_norm, step_length, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start_)};
+            ++total_;
+        }
+
+        size_t size() const { return std::min(total_, entries_.size()); }
+        size_t total() const { return total_; } // number of iterations recorded, the oldest entries are overwritten when buffer is full
+        const Entry& operator[](size_t index) const { return entries_[(total_ > entries_.size() ? total_ - entries_.size() + index : index) % entries_.size()]; } // oldest first
+
+      private:
+        std::vector<Entry> entries_;
+        size_t total_{0};
+        const std::chrono::high_resolution_clock::time_point start_{std::chrono::high_resolution_clock::now()};
+    };
+
     struct optimization_status
     {
         optimization_status(optimization_method a_method) : method{a_method} {}
@@ -42,9 +77,14 @@ namespace acmacs::chart
         std::chrono::microseconds time;
         double initial_stress;
         double final_stress;
+        std::shared_ptr<OptimizationTrace> trace; // if requested by optimization_options::trace_capacity
 
     }; // struct optimization_status
 
+    // exports traces of the passed statuses (statuses without trace are skipped), csv has one row per iteration
+    std::string export_traces_to_json(const std::vector<optimization_status>& statuses);
+    std::string export_traces_to_csv(const std::vector<optimization_status>& statuses);
+
     struct DimensionAnnelingStatus
     {
         std::chrono::microseconds time;
@@ -73,11 +113,12 @@ namespace acmacs::chart
     // creates new projection and optimizes it with or without dimension annealing
     optimization_status optimize(ChartModify& chart, MinimumColumnBasis minimum_column_basis, const dimension_schedule& schedule, optimization_options options = optimization_options{});
 
-    optimization_status optimize(optimization_method method, const Stress& stress, double* arg_first, double* arg_last, optimization_precision precision = optimization_precision::fine);
-    inline optimization_status optimize(optimization_method method, const Stress& stress, double* arg_first, size_t arg_size, optimization_precision precision = optimization_precision::fine)
+    optimization_status optimize(optimization_method method, const Stress& stress, double* arg_first, double* arg_last, optimization_precision precision = optimization_precision::fine, OptimizationTrace* trace = nullptr);
+    inline optimization_status optimize(optimization_method method, const Stress& stress, double* arg_first, size_t arg_size, optimization_precision precision = optimization_precision::fine, OptimizationTrace* trace = nullptr)
     {
-        return optimize(method, stress, arg_first, arg_first + arg_size, precision);
+        return optimize(method, stress, arg_first, arg_first + arg_size, precision, trace);
     }
+    inline std::shared_ptr<OptimizationTrace> make_optimization_trace(const optimization_options& options) { return options.trace_capacity > 0 ? std::make_shared<OptimizationTrace>(options.trace_capacity) : nullptr; }
 
     DimensionAnnelingStatus dimension_annealing(optimization_method optimization_method, const Stress& stress, number_of_dimensions_t source_number_of_dimensions,
                                                 number_of_dimensions_t target_number_of_dimensions, double* arg_first, double* arg_last);
@@ -103,11 +144,24 @@ namespace acmacs::chart
 
     struct OptimiserCallbackData
     {
-        OptimiserCallbackData(const Stress& a_stress) : stress{a_stress}, intermediate_layouts{nullptr} {}
-        OptimiserCallbackData(const Stress& a_stress, acmacs::chart::IntermediateLayouts& a_intermediate_layouts) : stress{a_stress}, intermediate_layouts{&a_intermediate_layouts} {}
+        OptimiserCallbackData(const Stress& a_stress, OptimizationTrace* a_trace = nullptr) : stress{a_stress}, intermediate_layouts{nullptr}, trace{a_trace} {}
+        OptimiserCallbackData(const Stress& a_stress, acmacs::chart::IntermediateLayouts& a_intermediate_layouts, OptimizationTrace* a_trace = nullptr)
+            : stress{a_stress}, intermediate_layouts{&a_intermediate_layouts}, trace{a_trace} {}
         const acmacs::chart::Stress& stress;
         acmacs::chart::IntermediateLayouts* intermediate_layouts{nullptr};
+        OptimizationTrace* trace{nullptr};
         size_t iteration_no{0};
+        double gradient_norm{std::numeric_limits<double>::quiet_NaN()}; // of the last gradient evaluation, for trace
+        std::vector<double> previous_arg;                                 // for trace step length
+
+        bool report_iterations() const { return intermediate_layouts != nullptr || trace != nullptr; }
+        void set_gradient_norm(const double* gradient_first, size_t num_args)
+        {
+            if (trace)
+                gradient_norm = std::sqrt(std::inner_product(gradient_first, gradient_first + num_args, gradient_first, 0.0));
+        }
+        // to be called by the optimizer step callback
+        void iteration_done(const double* arg_first, size_t num_args, double stress_value);
     };
 
 } // namespace acmacs::chart
@@ -1,3 +1,8 @@
+#include <numeric>
+#include <limits>
+#include <optional>
+
+#include "acmacs-base/omp.hh"
 #include "acmacs-base/range-v3.hh"
 #include "acmacs-base/float.hh"
 #include "acmacs-chart-2/procrustes.hh"
@@ -22,57 +27,111 @@ constexpr inline aint_t cint(acmacs::number_of_dimensions_t src) { return static
 
 // ----------------------------------------------------------------------
 
-class MatrixJ
+namespace acmacs::chart::procrustes_internal
 {
- public:
-    template <typename S> MatrixJ(S size) : size_(cint(size)) {}
-    virtual ~MatrixJ() {}
+    // coordinates of common points centered by subtracting mean, stored row-wise (number of common points x number of dimensions)
+    class Centered
+    {
+      public:
+        Centered(const acmacs::Layout& layout, const std::vector<CommonAntigensSera::common_t>& common, size_t CommonAntigensSera::common_t::*point_no)
+            : number_of_dimensions_{static_cast<size_t>(*layout.number_of_dimensions())}, coordinates_(common.size() * number_of_dimensions_), mean_(number_of_dimensions_, 0.0)
+        {
+            for (size_t row = 0; row < common.size(); ++row) {
+                for (size_t dim = 0; dim < number_of_dimensions_; ++dim) {
+                    const auto value = layout.coordinate(common[row].*point_no, number_of_dimensions_t{dim});
+                    coordinates_[row * number_of_dimensions_ + dim] = value;
+                    mean_[dim] += value;
+                }
+            }
+            for (auto& val : mean_)
+                val /= static_cast<double>(common.size());
+            for (size_t row = 0; row < common.size(); ++row) {
+                for (size_t dim = 0; dim < number_of_dimensions_; ++dim)
+                    coordinates_[row * number_of_dimensions_ + dim] -= mean_[dim];
+            }
+        }
 
-    constexpr aint_t rows() const { return size_; }
-    constexpr aint_t cols() const { return size_; }
-    virtual double operator()(aint_t row, aint_t col) const = 0;
+        size_t rows() const { return coordinates_.size() / number_of_dimensions_; }
+        size_t number_of_dimensions() const { return number_of_dimensions_; }
+        double operator()(size_t row, size_t dim) const { return coordinates_[row * number_of_dimensions_ + dim]; }
+        double mean(number_of_dimensions_t dim) const { return mean_[*dim]; }
+        double sum_of_squares() const { return std::inner_product(coordinates_.begin(), coordinates_.end(), coordinates_.begin(), 0.0); } // trace(y^T J y)
 
- private:
-    const aint_t size_;
-};
+      private:
+        size_t number_of_dimensions_;
+        std::vector<double> coordinates_;
+        std::vector<double> mean_;
+    };
 
-class MatrixJProcrustes : public MatrixJ
-{
- public:
-    template <typename S> MatrixJProcrustes(S size) : MatrixJ(size), diagonal_(1.0 - 1.0 / static_cast<double>(size)), non_diagonal_(-1.0 / static_cast<double>(size)) {}
-    double operator()(aint_t row, aint_t column) const override { return row == column ? diagonal_ : non_diagonal_; }
+    // x^T J y, d x d
+    inline alglib::real_2d_array cross_product(const Centered& x, const Centered& y)
+    {
+        const auto num_dim = x.number_of_dimensions();
+        alglib::real_2d_array result;
+        result.setlength(cint(num_dim), cint(num_dim));
+        for (size_t row = 0; row < num_dim; ++row) {
+            for (size_t col = 0; col < num_dim; ++col) {
+                double sum{0.0};
+                for (size_t point_no = 0; point_no < x.rows(); ++point_no)
+                    sum += x(point_no, row) * y(point_no, col);
+                result(cint(row), cint(col)) = sum;
+            }
+        }
+        return result;
+    }
+
+    // trace(x^T J y transformation)
+    inline double trace_cross_product(const Centered& x, const Centered& y, const alglib::real_2d_array& transformation)
+    {
+        const auto num_dim = x.number_of_dimensions();
+        double trace{0.0};
+        for (size_t point_no = 0; point_no < x.rows(); ++point_no) {
+            for (size_t dim = 0; dim < num_dim; ++dim) {
+                double y_transformed{0.0};
+                for (size_t index = 0; index < num_dim; ++index)
+                    y_transformed += y(point_no, index) * transformation(cint(index), cint(dim));
+                trace += x(point_no, dim) * y_transformed;
+            }
+        }
+        return trace;
+    }
+
+    inline std::vector<CommonAntigensSera::common_t> without_disconnected(const acmacs::Layout& layout, const std::vector<CommonAntigensSera::common_t>& common, size_t CommonAntigensSera::common_t::*point_no)
+    {
+        std::vector<CommonAntigensSera::common_t> result;
+        std::copy_if(std::begin(common), std::end(common), std::back_inserter(result), [&layout, point_no](const auto& en) { return !std::isnan(layout.coordinate(en.*point_no, number_of_dimensions_t{0})); });
+        return result;
+    }
 
- private:
-    const double diagonal_, non_diagonal_;
+    // primary side of procrustes: common points having coordinates in the primary and their centered coordinates, prepared once for many secondaries
+    class Primary
+    {
+      public:
+        Primary(const Projection& primary, const std::vector<CommonAntigensSera::common_t>& common) : Primary(layout_of(primary), common) {}
+        Primary(std::shared_ptr<acmacs::Layout> layout, const std::vector<CommonAntigensSera::common_t>& common);
 
-}; // class MatrixJProcrustes
+        // 2d primary is used with its transformation applied
+        static std::shared_ptr<acmacs::Layout> layout_of(const Projection& primary) { return primary.number_of_dimensions() == number_of_dimensions_t{2} ? primary.transformed_layout() : primary.layout(); }
 
-class MatrixJProcrustesScaling : public MatrixJ
-{
- public:
-    template <typename S> MatrixJProcrustesScaling(S size)
-        : MatrixJ(size),
-          diagonal_0_(1.0 - 1.0 / static_cast<double>(size)), non_diagonal_0_(-1.0 / static_cast<double>(size)),
-          diagonal_(non_diagonal_0_ * non_diagonal_0_ * static_cast<double>(size - 1) + diagonal_0_ * diagonal_0_),
-          non_diagonal_(non_diagonal_0_ * non_diagonal_0_ * static_cast<double>(size - 2) + non_diagonal_0_ * diagonal_0_ * 2)
-        {}
-    double operator()(aint_t row, aint_t column) const override { return row == column ? diagonal_ : non_diagonal_; }
+        number_of_dimensions_t number_of_dimensions() const { return layout_->number_of_dimensions(); }
+        // transformation and rms, secondary_transformed is not set
+        // rms calculation is stopped as soon as it is known to exceed rms_cutoff, rms is set to infinity then
+        ProcrustesData operator()(const acmacs::Layout& secondary, procrustes_scaling_t scaling, double rms_cutoff = std::numeric_limits<double>::infinity()) const;
 
- private:
-    const double diagonal_0_, non_diagonal_0_;
-    const double diagonal_, non_diagonal_;
+      private:
+        std::shared_ptr<acmacs::Layout> layout_;
+        std::vector<CommonAntigensSera::common_t> common_; // without points disconnected in the primary
+        Centered centered_;
 
-}; // class MatrixJProcrustesScaling
+        ProcrustesData procrustes(const Centered& x, const std::vector<CommonAntigensSera::common_t>& common, const acmacs::Layout& secondary, procrustes_scaling_t scaling, double rms_cutoff) const;
+    };
+
+} // namespace acmacs::chart::procrustes_internal
 
 // ----------------------------------------------------------------------
 
-static alglib::real_2d_array multiply(const MatrixJ& left, const alglib::real_2d_array& right);
-static alglib::real_2d_array multiply(const alglib::real_2d_array& left, const alglib::real_2d_array& right);
 static void multiply(alglib::real_2d_array& matrix, double scale);
-static void multiply_add(alglib::real_2d_array& matrix, double scale, const alglib::real_2d_array& to_add);
-static alglib::real_2d_array multiply_left_transposed(const alglib::real_2d_array& left, const alglib::real_2d_array& right);
 static alglib::real_2d_array multiply_both_transposed(const alglib::real_2d_array& left, const alglib::real_2d_array& right);
-static alglib::real_2d_array transpose(const alglib::real_2d_array& matrix);
 static void singular_value_decomposition(const alglib::real_2d_array& matrix, alglib::real_2d_array& u, alglib::real_2d_array& vt);
 
 inline bool has_nan(const alglib::real_2d_array& data)
@@ -100,34 +159,41 @@ inline bool has_nan(const alglib::real_2d_array& data)
 
 // ----------------------------------------------------------------------
 
-// Code for this function was extracted from Procrustes3-for-lisp.c from lispmds
+acmacs::chart::procrustes_internal::Primary::Primary(std::shared_ptr<acmacs::Layout> layout, const std::vector<CommonAntigensSera::common_t>& common)
+    : layout_{layout},
+      common_{without_disconnected(*layout_, common, &CommonAntigensSera::common_t::primary)},
+      centered_{*layout_, common_, &CommonAntigensSera::common_t::primary}
+{
+} // acmacs::chart::procrustes_internal::Primary::Primary
 
-ProcrustesData acmacs::chart::procrustes(const Projection& primary, const Projection& secondary, const std::vector<CommonAntigensSera::common_t>& common, procrustes_scaling_t scaling)
+// ----------------------------------------------------------------------
+
+ProcrustesData acmacs::chart::procrustes_internal::Primary::operator()(const acmacs::Layout& secondary, procrustes_scaling_t scaling, double rms_cutoff) const
 {
-    auto primary_layout = primary.number_of_dimensions() == number_of_dimensions_t{2} ? primary.transformed_layout() : primary.layout();
-    auto secondary_layout = secondary.layout();
-    const auto number_of_dimensions = primary_layout->number_of_dimensions();
-    if (number_of_dimensions != secondary_layout->number_of_dimensions())
+    if (number_of_dimensions() != secondary.number_of_dimensions())
         throw invalid_data("procrustes: projections have different number of dimensions");
 
-    auto common_without_disconnected = common;
-    common_without_disconnected.erase(std::remove_if(std::begin(common_without_disconnected), std::end(common_without_disconnected),
-                                                     [&primary_layout, &secondary_layout](const auto& en) {
-                                                         return std::isnan(primary_layout->coordinate(en.primary, number_of_dimensions_t{0})) ||
-                                                                std::isnan(secondary_layout->coordinate(en.secondary, number_of_dimensions_t{0}));
-                                                     }),
-                                      std::end(common_without_disconnected));
-    // std::cerr << "common: " << common.size() << " common_without_disconnected: " << common_without_disconnected.size() << '\n';
-
-    alglib::real_2d_array x, y;
-    x.setlength(cint(common_without_disconnected.size()), cint(number_of_dimensions));
-    y.setlength(cint(common_without_disconnected.size()), cint(number_of_dimensions));
-    for (size_t point_no = 0; point_no < common_without_disconnected.size(); ++point_no) {
-        for (auto dim : acmacs::range(number_of_dimensions)) {
-            x(cint(point_no), cint(dim)) = primary_layout->coordinate(common_without_disconnected[point_no].primary, dim);
-            y(cint(point_no), cint(dim)) = secondary_layout->coordinate(common_without_disconnected[point_no].secondary, dim);
-        }
-    }
+    const auto disconnected_in_secondary = [&secondary](const auto& en) { return std::isnan(secondary.coordinate(en.secondary, number_of_dimensions_t{0})); };
+    if (std::none_of(std::begin(common_), std::end(common_), disconnected_in_secondary))
+        return procrustes(centered_, common_, secondary, scaling, rms_cutoff);
+
+    // secondary has disconnected common points, primary coordinates have to be centered again
+    const auto common_without_disconnected = without_disconnected(secondary, common_, &CommonAntigensSera::common_t::secondary);
+    // std::cerr << "common: " << common_.size() << " common_without_disconnected: " << common_without_disconnected.size() << '\n';
+    return procrustes(Centered{*layout_, common_without_disconnected, &CommonAntigensSera::common_t::primary}, common_without_disconnected, secondary, scaling, rms_cutoff);
+
+} // acmacs::chart::procrustes_internal::Primary::operator()
+
+// ----------------------------------------------------------------------
+
+ProcrustesData acmacs::chart::procrustes_internal::Primary::procrustes(const Centered& x, const std::vector<CommonAntigensSera::common_t>& common, const acmacs::Layout& secondary, procrustes_scaling_t scaling,
+                                                                     double rms_cutoff) const
+{
+    const auto number_of_dimensions = layout_->number_of_dimensions();
+
+    // coordinates of common points are centered explicitly, that replaces multiplication by the N x N centering matrix J (J = I - 1/N), J is symmetric and idempotent,
+    // therefore x^T J y = xc^T yc and only d x d matrices are involved in svd
+    const Centered y(secondary, common, &CommonAntigensSera::common_t::secondary);
 
     ProcrustesData result(number_of_dimensions);
     auto set_transformation = [&result, number_of_dimensions = cint(number_of_dimensions)](const auto& source) {
@@ -138,75 +204,96 @@ ProcrustesData acmacs::chart::procrustes(const Projection& primary, const Projec
             std::cerr << "WARNING: procrustes: invalid transformation\n";
     };
 
-    alglib::real_2d_array transformation;
-    if (scaling == procrustes_scaling_t::no) {
-        const MatrixJProcrustes j(common_without_disconnected.size());
-        auto m4 = transpose(multiply_left_transposed(multiply(j, y), multiply(j, x)));
-        alglib::real_2d_array u, vt;
-        singular_value_decomposition(m4, u, vt);
-        if (has_nan(u))
-            std::cerr << "WARNING: procrustes: invalid u after svd (no scaling)\n";
-        if (has_nan(vt))
-            std::cerr << "WARNING: procrustes: invalid vt after svd (no scaling)\n";
-        transformation = multiply_both_transposed(vt, u);
-        if (has_nan(transformation))
-            std::cerr << "WARNING: procrustes: invalid transformation after svd (no scaling)\n";
-    }
-    else {
-        const MatrixJProcrustesScaling j(common_without_disconnected.size());
-        const auto m1 = multiply(j, y);
-        const auto m2 = multiply_left_transposed(x, m1);
-        alglib::real_2d_array u, vt;
-        singular_value_decomposition(m2, u, vt);
-        transformation = multiply_both_transposed(vt, u);
-        if (has_nan(transformation))
-            std::cerr << "WARNING: procrustes: invalid transformation after svd (with scaling)\n";
-        // std::cerr << "transformation0: " << transformation.tostring(8) << '\n';
-
-        // calculate optimal scale parameter
-        const auto denominator = multiply_left_transposed(y, m1);
-        const auto trace_denominator =
-            std::accumulate(acmacs::index_iterator<aint_t>(0), acmacs::index_iterator(cint(number_of_dimensions)), 0.0, [&denominator](double sum, auto i) { return sum + denominator(i, i); });
-        const auto m3 = multiply(y, transformation);
-        const auto m4 = multiply(j, m3);
-        const auto numerator = multiply_left_transposed(x, m4);
-        const auto trace_numerator =
-            std::accumulate(acmacs::index_iterator<aint_t>(0), acmacs::index_iterator(cint(number_of_dimensions)), 0.0, [&numerator](double sum, auto i) { return sum + numerator(i, i); });
-        const auto scale = trace_numerator / trace_denominator;
+    auto m4 = cross_product(x, y);
+    alglib::real_2d_array u, vt;
+    singular_value_decomposition(m4, u, vt);
+    if (has_nan(u))
+        std::cerr << "WARNING: procrustes: invalid u after svd\n";
+    if (has_nan(vt))
+        std::cerr << "WARNING: procrustes: invalid vt after svd\n";
+    auto transformation = multiply_both_transposed(vt, u);
+    if (has_nan(transformation))
+        std::cerr << "WARNING: procrustes: invalid transformation after svd\n";
+    if (scaling == procrustes_scaling_t::yes) {
+        // optimal scale parameter: trace(x^T J y T) / trace(y^T J y)
+        const auto scale = trace_cross_product(x, y, transformation) / y.sum_of_squares();
         multiply(transformation, scale);
         result.scale = scale;
     }
     set_transformation(transformation);
 
-    // translation
-    auto m5 = multiply(y, transformation);
-    multiply_add(m5, -1, x);
+    // translation: mean of (x - y T) over common points
     for (auto dim : acmacs::range(number_of_dimensions)) {
-        const auto t_i = std::accumulate(acmacs::index_iterator<aint_t>(0), acmacs::index_iterator(cint(common_without_disconnected.size())), 0.0,
-                                         [&m5, dim = cint(dim)](auto sum, auto row) { return sum + m5(row, dim); });
-        result.transformation.translation(dim) = t_i / static_cast<double>(common_without_disconnected.size());
+        double y_transformed_mean{0.0};
+        for (auto index : acmacs::range(number_of_dimensions))
+            y_transformed_mean += y.mean(index) * transformation(cint(index), cint(dim));
+        result.transformation.translation(dim) = x.mean(dim) - y_transformed_mean;
     }
 
-    // rms
-    result.secondary_transformed = result.apply(*secondary_layout);
-    result.rms = 0.0;
-    size_t num_rows = 0;
-    for (const auto& cp : common_without_disconnected) {
-        if (const auto pc = primary_layout->at(cp.primary), sc = result.secondary_transformed->at(cp.secondary); pc.exists() && sc.exists()) {
-            ++num_rows;
-            const auto make_rms_inc = [&pc, &sc](auto sum, auto dim) { return sum + square(pc[dim] - sc[dim]); };
-            result.rms = std::accumulate(acmacs::index_iterator<number_of_dimensions_t>(0UL), acmacs::index_iterator(number_of_dimensions), result.rms, make_rms_inc);
-            // std::cerr << cp.primary << ' ' << cp.secondary << ' ' << result.rms << '\n';
+    // rms, secondary common points are transformed in place, without making transformed layout
+    const auto sum_squares_cutoff = square(rms_cutoff) * static_cast<double>(common.size());
+    double sum_squares{0.0};
+    for (const auto& cp : common) {
+        for (auto dim : acmacs::range(number_of_dimensions)) {
+            double transformed = result.transformation.translation(dim);
+            for (auto index : acmacs::range(number_of_dimensions))
+                transformed += secondary.coordinate(cp.secondary, index) * result.transformation(index, dim);
+            sum_squares += square(layout_->coordinate(cp.primary, dim) - transformed);
+        }
+        if (sum_squares > sum_squares_cutoff) {
+            result.rms = std::numeric_limits<double>::infinity();
+            return result;
         }
     }
-    result.rms = std::sqrt(result.rms / static_cast<double>(num_rows));
+    result.rms = std::sqrt(sum_squares / static_cast<double>(common.size()));
 
-    // std::cerr << "common points (without disconnected): " << common_without_disconnected.size() << '\n';
+    // std::cerr << "common points (without disconnected): " << common.size() << '\n';
     // std::cerr << "transformation: " << acmacs::to_string(result.transformation) << '\n';
     // std::cerr << "rms: " << acmacs::to_string(result.rms) << '\n';
 
     return result;
 
+} // acmacs::chart::procrustes_internal::Primary::procrustes
+
+// ----------------------------------------------------------------------
+
+// Code for this function was extracted from Procrustes3-for-lisp.c from lispmds
+
+ProcrustesData acmacs::chart::procrustes(const Projection& primary, const Projection& secondary, const std::vector<CommonAntigensSera::common_t>& common, procrustes_scaling_t scaling)
+{
+    return procrustes(primary, *secondary.layout(), common, scaling);
+
+} // acmacs::chart::procrustes
+
+// ----------------------------------------------------------------------
+
+ProcrustesData acmacs::chart::procrustes(const Projection& primary, const acmacs::Layout& secondary, const std::vector<CommonAntigensSera::common_t>& common, procrustes_scaling_t scaling)
+{
+    auto result = procrustes_internal::Primary{primary, common}(secondary, scaling);
+    result.secondary_transformed = result.apply(secondary);
+    return result;
+
+} // acmacs::chart::procrustes
+
+// ----------------------------------------------------------------------
+
+std::vector<ProcrustesData> acmacs::chart::procrustes(const Projection& primary, const std::vector<std::shared_ptr<acmacs::Layout>>& secondaries, const std::vector<CommonAntigensSera::common_t>& common, procrustes_scaling_t scaling, int threads)
+{
+    const procrustes_internal::Primary master{primary, common};
+    for (const auto& secondary : secondaries) {
+        if (master.number_of_dimensions() != secondary->number_of_dimensions())
+            throw invalid_data("procrustes: projections have different number of dimensions");
+    }
+
+#ifdef _OPENMP
+    const int num_threads = threads <= 0 ? omp_get_max_threads() : threads;
+#endif
+    std::vector<ProcrustesData> results(secondaries.size(), ProcrustesData{master.number_of_dimensions()});
+#pragma omp parallel for default(shared) num_threads(num_threads) schedule(dynamic, 1)
+    for (size_t secondary_no = 0; secondary_no < secondaries.size(); ++secondary_no)
+        results[secondary_no] = master(*secondaries[secondary_no], scaling);
+    return results;
+
 } // acmacs::chart::procrustes
 
 // ----------------------------------------------------------------------
@@ -235,38 +322,6 @@ std::shared_ptr<acmacs::Layout> acmacs::chart::ProcrustesData::apply(const acmac
 
 // ----------------------------------------------------------------------
 
-alglib::real_2d_array multiply(const MatrixJ& left, const alglib::real_2d_array& right)
-{
-    // std::cerr << "multiply left " << left.rows() << 'x' << left.cols() << "  right " << right.rows() << 'x' << right.cols() << '\n';
-    alglib::real_2d_array result;
-    result.setlength(left.rows(), right.cols());
-    for (aint_t row = 0; row < left.rows(); ++row) {
-        for (aint_t column = 0; column < right.cols(); ++column) {
-            result(row, column) = std::accumulate(acmacs::index_iterator<aint_t>(0), acmacs::index_iterator(left.cols()), 0.0,
-                                                  [&left,&right,row,column](double sum, auto i) { return sum + left(row, i) * right(i, column); });
-        }
-    }
-    return result;
-
-} // multiply
-
-// ----------------------------------------------------------------------
-
-alglib::real_2d_array multiply(const alglib::real_2d_array& left, const alglib::real_2d_array& right)
-{
-    alglib::real_2d_array result;
-    result.setlength(left.rows(), right.cols());
-    // std::cerr << "multiply left " << left.rows() << 'x' << left.cols() << "  right " << right.rows() << 'x' << right.cols() << "  result " << result.rows() << 'x' << result.cols() << '\n';
-    alglib::rmatrixgemm(left.rows(), right.cols(), right.rows(),
-                        1.0 /*alpha*/, left, 0 /*i-left*/, 0 /*j-left*/, 0 /*left-no-transform*/,
-                        right, 0 /*i-right*/, 0 /*j-right*/, 0 /*right-no-transform*/,
-                        0.0 /*beta*/, result, 0 /*i-result*/, 0 /*j-result*/);
-    return result;
-
-} // multiply
-
-// ----------------------------------------------------------------------
-
 void multiply(alglib::real_2d_array& matrix, double scale)
 {
     for (aint_t row = 0; row < matrix.rows(); ++row)
@@ -276,31 +331,6 @@ void multiply(alglib::real_2d_array& matrix, double scale)
 
 // ----------------------------------------------------------------------
 
-void multiply_add(alglib::real_2d_array& matrix, double scale, const alglib::real_2d_array& to_add)
-{
-    for (aint_t row = 0; row < matrix.rows(); ++row) {
-        alglib::vmul(&matrix[row][0], 1, matrix.cols(), scale);
-        alglib::vadd(&matrix[row][0], 1, &to_add[row][0], 1, matrix.cols());
-    }
-
-} // multiply_add
-
-// ----------------------------------------------------------------------
-
-alglib::real_2d_array multiply_left_transposed(const alglib::real_2d_array& left, const alglib::real_2d_array& right)
-{
-    alglib::real_2d_array result;
-    result.setlength(left.cols(), right.cols());
-    alglib::rmatrixgemm(left.cols(), right.cols(), right.rows(),
-                        1.0 /*alpha*/, left, 0 /*i-left*/, 0 /*j-left*/, 1 /*left-transpose*/,
-                        right, 0 /*i-right*/, 0 /*j-right*/, 0 /*right-no-transform*/,
-                        0.0 /*beta*/, result, 0 /*i-result*/, 0 /*j-result*/);
-    return result;
-
-} // multiply_left_transposed
-
-// ----------------------------------------------------------------------
-
 alglib::real_2d_array multiply_both_transposed(const alglib::real_2d_array& left, const alglib::real_2d_array& right)
 {
     alglib::real_2d_array result;
@@ -315,18 +345,6 @@ alglib::real_2d_array multiply_both_transposed(const alglib::real_2d_array& left
 
 // ----------------------------------------------------------------------
 
-alglib::real_2d_array transpose(const alglib::real_2d_array& source)
-{
-    alglib::real_2d_array result;
-    result.setlength(source.cols(), source.rows());
-    alglib::rmatrixtranspose(source.rows(), source.cols(), source, 0/*i-source*/, 0/*j-source*/, result, 0/*i-result*/, 0/*j-result*/);
-      // std::cerr << "transposed: " << source.rows() << 'x' << source.cols() << " --> " << source.cols() << 'x' << source.rows() << '\n';
-    return result;
-
-} // transpose
-
-// ----------------------------------------------------------------------
-
 void singular_value_decomposition(const alglib::real_2d_array& matrix, alglib::real_2d_array& u, alglib::real_2d_array& vt)
 {
     vt.setlength(matrix.cols(), matrix.cols());
@@ -339,6 +357,93 @@ void singular_value_decomposition(const alglib::real_2d_array& matrix, alglib::r
 
 // ----------------------------------------------------------------------
 
+acmacs::chart::ProjectionsSimilarity acmacs::chart::projections_similarity(const Chart& chart, double rms_cutoff, int threads)
+{
+    const auto number_of_projections = chart.number_of_projections();
+    ProjectionsSimilarity result{number_of_projections};
+    if (number_of_projections < 2)
+        return result;
+
+    const auto common = CommonAntigensSera{chart}.points();
+    auto projections = chart.projections();
+    // layouts are obtained sequentially, layout() of modified projection may fill cache
+    std::vector<std::shared_ptr<acmacs::Layout>> layouts(number_of_projections), primary_layouts(number_of_projections);
+    for (size_t projection_no = 0; projection_no < number_of_projections; ++projection_no) {
+        const auto projection = (*projections)[projection_no];
+        layouts[projection_no] = projection->layout();
+        primary_layouts[projection_no] = procrustes_internal::Primary::layout_of(*projection);
+    }
+
+#ifdef _OPENMP
+    const int num_threads = threads <= 0 ? omp_get_max_threads() : threads;
+#endif
+
+    // primary side (centered layout and common points) is prepared once per projection and shared by all blocks of its row
+    std::vector<std::optional<procrustes_internal::Primary>> primaries(number_of_projections);
+#pragma omp parallel for default(shared) num_threads(num_threads) schedule(dynamic, 1)
+    for (size_t primary_no = 0; primary_no < number_of_projections; ++primary_no)
+        primaries[primary_no].emplace(primary_layouts[primary_no], common);
+
+    // pairs (primary < secondary) are processed in square blocks, layouts of the block are reused while they are in cache
+    constexpr const size_t block_size = 16;
+    const auto number_of_blocks = (number_of_projections + block_size - 1) / block_size;
+    std::vector<std::pair<size_t, size_t>> blocks;
+    for (size_t block_row = 0; block_row < number_of_blocks; ++block_row) {
+        for (size_t block_col = block_row; block_col < number_of_blocks; ++block_col)
+            blocks.emplace_back(block_row, block_col);
+    }
+
+#pragma omp parallel for default(shared) num_threads(num_threads) schedule(dynamic, 1)
+    for (size_t block_no = 0; block_no < blocks.size(); ++block_no) {
+        const auto [block_row, block_col] = blocks[block_no];
+        const auto row_last = std::min((block_row + 1) * block_size, number_of_projections), col_last = std::min((block_col + 1) * block_size, number_of_projections);
+        for (size_t primary_no = block_row * block_size; primary_no < row_last; ++primary_no) {
+            const auto& primary = *primaries[primary_no];
+            for (size_t secondary_no = std::max(block_col * block_size, primary_no + 1); secondary_no < col_last; ++secondary_no) {
+                const auto rms = layouts[secondary_no]->number_of_dimensions() == primary.number_of_dimensions()
+                                     ? primary(*layouts[secondary_no], procrustes_scaling_t::no, rms_cutoff).rms
+                                     : std::numeric_limits<double>::quiet_NaN(); // projections with different number of dimensions are not comparable
+                result.rms[primary_no * number_of_projections + secondary_no] = result.rms[secondary_no * number_of_projections + primary_no] = rms;
+            }
+        }
+    }
+    return result;
+
+} // acmacs::chart::projections_similarity
+
+// ----------------------------------------------------------------------
+
+std::vector<acmacs::chart::ProjectionsCluster> acmacs::chart::projections_clusters(const Chart& chart, const ProjectionsSimilarity& similarity, double rms_threshold)
+{
+    // projections in the order of stress, the best unassigned projection becomes representative of a new cluster
+    // and collects all unassigned projections within rms_threshold from it
+    auto projections = chart.projections();
+    std::vector<size_t> by_stress(similarity.number_of_projections);
+    std::iota(std::begin(by_stress), std::end(by_stress), 0UL);
+    std::vector<double> stresses(similarity.number_of_projections);
+    for (size_t projection_no = 0; projection_no < similarity.number_of_projections; ++projection_no)
+        stresses[projection_no] = (*projections)[projection_no]->stress();
+    std::stable_sort(std::begin(by_stress), std::end(by_stress), [&stresses](size_t p1, size_t p2) { return stresses[p1] < stresses[p2]; });
+
+    std::vector<ProjectionsCluster> clusters;
+    std::vector<bool> assigned(similarity.number_of_projections, false);
+    for (const auto representative : by_stress) {
+        if (assigned[representative])
+            continue;
+        auto& cluster = clusters.emplace_back(ProjectionsCluster{representative, stresses[representative], {}});
+        for (const auto projection_no : by_stress) {
+            if (!assigned[projection_no] && (projection_no == representative || similarity(representative, projection_no) <= rms_threshold)) {
+                cluster.projections.push_back(projection_no);
+                assigned[projection_no] = true;
+            }
+        }
+    }
+    return clusters;
+
+} // acmacs::chart::projections_clusters
+
+// ----------------------------------------------------------------------
+
 acmacs::chart::ProcrustesSummary acmacs::chart::procrustes_summary(const acmacs::Layout& primary, const acmacs::Layout& transformed_secondary, const ProcrustesSummaryParameters& parameters)
 {
     ProcrustesSummary results{parameters.number_of_antigens, primary.number_of_points() - parameters.number_of_antigens};
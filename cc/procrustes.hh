@@ -1,5 +1,7 @@
 #pragma once
 
+#include <limits>
+
 #include "acmacs-base/transformation.hh"
 #include "acmacs-chart-2/common.hh"
 
@@ -9,6 +11,7 @@ namespace acmacs { class Layout; }
 
 namespace acmacs::chart
 {
+    class Chart;
     class Projection;
     class CommonAntigensSera;
 
@@ -18,6 +21,8 @@ namespace acmacs::chart
         ProcrustesData(number_of_dimensions_t number_of_dimensions) : transformation(number_of_dimensions) {}
         ProcrustesData(const ProcrustesData&) = default;
         ProcrustesData(ProcrustesData&&) = default;
+        ProcrustesData& operator=(const ProcrustesData&) = default;
+        ProcrustesData& operator=(ProcrustesData&&) = default;
         Transformation transformation;
         double scale{1};
         double rms{0};
@@ -30,6 +35,38 @@ namespace acmacs::chart
     enum class procrustes_scaling_t { no, yes };
 
     ProcrustesData procrustes(const Projection& primary, const Projection& secondary, const std::vector<CommonAntigensSera::common_t>& common, procrustes_scaling_t scaling);
+    // secondary layout is not necessarily in a projection (e.g. scratch layout of avidity test)
+    ProcrustesData procrustes(const Projection& primary, const acmacs::Layout& secondary, const std::vector<CommonAntigensSera::common_t>& common, procrustes_scaling_t scaling);
+    // batch: primary side (common points, centered coordinates) is prepared once, secondaries are processed in parallel (omp)
+    // results contain transformation, scale and rms, secondary_transformed is not set (use apply() if necessary)
+    std::vector<ProcrustesData> procrustes(const Projection& primary, const std::vector<std::shared_ptr<acmacs::Layout>>& secondaries, const std::vector<CommonAntigensSera::common_t>& common,
+                                           procrustes_scaling_t scaling, int threads = 0);
+
+    // ----------------------------------------------------------------------
+    // similarity of projections of the same chart
+    // ----------------------------------------------------------------------
+
+    struct ProjectionsSimilarity
+    {
+        ProjectionsSimilarity(size_t a_number_of_projections) : number_of_projections{a_number_of_projections}, rms(a_number_of_projections * a_number_of_projections, 0.0) {}
+        double operator()(size_t p1, size_t p2) const { return rms[p1 * number_of_projections + p2]; }
+
+        size_t number_of_projections;
+        std::vector<double> rms; // procrustes rms (no scaling), symmetric matrix, infinity if rms exceeds cutoff, NaN if numbers of dimensions differ
+    };
+
+    struct ProjectionsCluster
+    {
+        size_t representative;           // projection with the lowest stress in the cluster
+        double stress;                   // of representative
+        std::vector<size_t> projections; // including representative, in the order of stress
+    };
+
+    // pairwise procrustes rms between all projections of the chart, runs in parallel (omp),
+    // calculation of rms for a pair is stopped as soon as rms is known to be above rms_cutoff
+    ProjectionsSimilarity projections_similarity(const Chart& chart, double rms_cutoff = std::numeric_limits<double>::infinity(), int threads = 0);
+    // basins: the best (by stress) unassigned projection starts a new cluster and collects all unassigned projections within rms_threshold from it
+    std::vector<ProjectionsCluster> projections_clusters(const Chart& chart, const ProjectionsSimilarity& similarity, double rms_threshold);
 
     // ----------------------------------------------------------------------
     // avidity test support
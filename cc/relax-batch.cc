@@ -0,0 +1,164 @@
+#include <atomic>
+#include <mutex>
+
+#include "acmacs-base/omp.hh"
+#include "acmacs-base/read-file.hh"
+#include "acmacs-base/rjson-v2.hh"
+#include "acmacs-chart-2/relax-batch.hh"
+#include "acmacs-chart-2/factory-import.hh"
+#include "acmacs-chart-2/factory-export.hh"
+#include "acmacs-chart-2/log.hh"
+
+// ----------------------------------------------------------------------
+
+std::vector<acmacs::chart::RelaxJob> acmacs::chart::read_relax_jobs(std::string_view manifest_filename)
+{
+    const auto manifest = rjson::parse_string(static_cast<std::string>(acmacs::file::read(manifest_filename)));
+    const auto& jobs_json = manifest["jobs"];
+    if (jobs_json.empty())
+        throw std::runtime_error{AD_FORMAT("{}: no jobs found", manifest_filename)};
+
+    std::vector<RelaxJob> jobs;
+    rjson::for_each(jobs_json, [&jobs, manifest_filename](const rjson::value& job_json, size_t job_no) {
+        auto& job = jobs.emplace_back();
+        if (const auto& val = job_json["source"]; !val.is_null())
+            job.source = val.to<std::string_view>();
+        if (const auto& val = job_json["output"]; !val.is_null())
+            job.output = val.to<std::string_view>();
+        if (job.source.empty() || job.output.empty())
+            throw std::runtime_error{AD_FORMAT("{}: job {}: both \"source\" and \"output\" must be specified", manifest_filename, job_no)};
+        if (const auto& val = job_json["number_of_optimizations"]; !val.is_null())
+            job.number_of_optimizations = number_of_optimizations_t{val.to<size_t>()};
+        if (const auto& val = job_json["number_of_dimensions"]; !val.is_null())
+            job.number_of_dimensions = number_of_dimensions_t{val.to<size_t>()};
+        if (const auto& val = job_json["minimum_column_basis"]; !val.is_null())
+            job.minimum_column_basis = val.to<std::string_view>();
+        if (const auto& val = job_json["method"]; !val.is_null())
+            job.options.method = optimization_method_from_string(val.to<std::string_view>());
+        if (const auto& val = job_json["rough"]; !val.is_null() && val.to<bool>())
+            job.options.precision = optimization_precision::rough;
+        if (const auto& val = job_json["dimension_annealing"]; !val.is_null())
+            job.dimension_annealing = use_dimension_annealing_from_bool(val.to<bool>());
+        if (const auto& val = job_json["md"]; !val.is_null())
+            job.options.randomization_diameter_multiplier = val.to<double>();
+        if (const auto& val = job_json["remove_original_projections"]; !val.is_null())
+            job.remove_original_projections = val.to<bool>();
+        if (const auto& val = job_json["keep_projections"]; !val.is_null())
+            job.keep_projections = val.to<size_t>();
+    });
+    return jobs;
+
+} // acmacs::chart::read_relax_jobs
+
+// ----------------------------------------------------------------------
+
+std::vector<acmacs::chart::RelaxJobResult> acmacs::chart::relax_batch(const std::vector<RelaxJob>& jobs, int threads, std::string_view program_name)
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+    std::vector<RelaxJobResult> results(jobs.size());
+    std::vector<std::shared_ptr<ChartModify>> charts(jobs.size());
+    std::vector<std::optional<ChartModify::relax_prepared_t>> prepared(jobs.size());
+    std::vector<std::atomic<size_t>> remaining(jobs.size()); // number of optimizations of the job not yet finished
+    std::mutex results_access;
+
+#ifdef _OPENMP
+    const int num_threads = threads <= 0 ? omp_get_max_threads() : threads;
+#endif
+
+    const auto set_error = [&results, &results_access](size_t job_no, std::string_view message) {
+        std::lock_guard<std::mutex> lock{results_access};
+        if (results[job_no].error.empty())
+            results[job_no].error = message;
+    };
+
+    // exports chart and releases its memory
+    const auto finish = [&](size_t job_no) {
+        if (results[job_no].error.empty()) {
+            try {
+                auto& projections = charts[job_no]->projections_modify();
+                projections.sort();
+                if (const auto keep_projections = jobs[job_no].keep_projections; keep_projections > 0 && projections.size() > keep_projections)
+                    projections.keep_just(keep_projections);
+                if (projections.size() > 0)
+                    results[job_no].best_stress = charts[job_no]->projection(0)->stress();
+                export_factory(*charts[job_no], jobs[job_no].output, program_name);
+            }
+            catch (std::exception& err) {
+                set_error(job_no, fmt::format("{}: {}", jobs[job_no].output, err.what()));
+            }
+        }
+        charts[job_no].reset();
+        prepared[job_no].reset();
+        results[job_no].time = std::chrono::duration_cast<decltype(results[job_no].time)>(std::chrono::high_resolution_clock::now() - start);
+        AD_LOG(acmacs::log::relax, "batch job {} finished: {} {}", job_no, jobs[job_no].output, results[job_no].error);
+    };
+
+    // load charts concurrently
+#pragma omp parallel for default(shared) num_threads(num_threads) schedule(dynamic, 1)
+    for (size_t job_no = 0; job_no < jobs.size(); ++job_no) {
+        const auto& job = jobs[job_no];
+        try {
+            charts[job_no] = std::make_shared<ChartModify>(import_from_file(job.source, Verify::None, report_time::no));
+            if (job.remove_original_projections)
+                charts[job_no]->projections_modify().remove_all();
+            prepared[job_no] = charts[job_no]->relax_prepare(job.number_of_optimizations, MinimumColumnBasis{job.minimum_column_basis}, job.number_of_dimensions, job.dimension_annealing, job.options);
+            remaining[job_no] = prepared[job_no]->projections.size();
+        }
+        catch (std::exception& err) {
+            set_error(job_no, fmt::format("{}: {}", job.source, err.what()));
+            remaining[job_no] = 0;
+        }
+    }
+
+    // every optimization of every job is a task, most expensive tasks go first, tasks of the same job are kept together to reuse stress copy
+    struct task_t
+    {
+        size_t job_no;
+        size_t projection_index;
+        size_t cost;
+    };
+    std::vector<task_t> tasks;
+    for (size_t job_no = 0; job_no < jobs.size(); ++job_no) {
+        if (remaining[job_no] == 0)
+            finish(job_no); // failed to load or nothing to optimize
+        else {
+            for (size_t projection_index = 0; projection_index < prepared[job_no]->projections.size(); ++projection_index)
+                tasks.push_back(task_t{job_no, projection_index, prepared[job_no]->stress.number_of_entries()});
+        }
+    }
+    std::sort(tasks.begin(), tasks.end(), [](const auto& t1, const auto& t2) { return t1.cost == t2.cost ? t1.job_no < t2.job_no : t1.cost > t2.cost; });
+    AD_LOG(acmacs::log::relax, "batch: {} jobs, {} optimizations", jobs.size(), tasks.size());
+
+#pragma omp parallel default(shared) num_threads(num_threads)
+    {
+        std::optional<Stress> stress; // thread local copy, number of dimensions is changed by dimension annealing
+        size_t stress_job_no{jobs.size()};
+#pragma omp for schedule(dynamic, 1)
+        for (size_t task_no = 0; task_no < tasks.size(); ++task_no) {
+            const auto& task = tasks[task_no];
+            try {
+                if (stress_job_no != task.job_no) {
+                    stress = prepared[task.job_no]->stress;
+                    stress_job_no = task.job_no;
+                }
+                charts[task.job_no]->relax_prepared(*prepared[task.job_no], task.projection_index, *stress, jobs[task.job_no].options);
+            }
+            catch (std::exception& err) {
+                set_error(task.job_no, fmt::format("{}: {}", jobs[task.job_no].source, err.what()));
+            }
+            if (--remaining[task.job_no] == 0) {
+                stress.reset();
+                stress_job_no = jobs.size();
+                finish(task.job_no);
+            }
+        }
+    }
+
+    return results;
+
+} // acmacs::chart::relax_batch
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "acmacs-chart-2/chart-modify.hh"
+
+// ----------------------------------------------------------------------
+
+namespace acmacs::chart
+{
+    struct RelaxJob
+    {
+        std::string source;
+        std::string output;
+        number_of_optimizations_t number_of_optimizations{1};
+        number_of_dimensions_t number_of_dimensions{2};
+        std::string minimum_column_basis{"none"};
+        use_dimension_annealing dimension_annealing{use_dimension_annealing::no};
+        optimization_options options{};
+        bool remove_original_projections{false};
+        size_t keep_projections{0}; // 0 - keep all
+    };
+
+    struct RelaxJobResult
+    {
+        std::optional<double> best_stress{};
+        std::chrono::microseconds time{0}; // since the start of the batch until output of the job was written
+        std::string error{};
+    };
+
+    // manifest is json:
+    // {"jobs": [{"source": "c.ace", "output": "c.relaxed.ace", "number_of_optimizations": 100, "number_of_dimensions": 2, "minimum_column_basis": "none",
+    //            "method": "alglib-cg", "rough": false, "dimension_annealing": false, "md": 2.0, "remove_original_projections": false, "keep_projections": 10}]}
+    // all fields but "source" and "output" are optional
+    std::vector<RelaxJob> read_relax_jobs(std::string_view manifest_filename);
+
+    // loads charts concurrently, runs optimizations of all jobs on one thread pool (most expensive first),
+    // exports each chart as soon as all its optimizations are done. Failed jobs are reported in RelaxJobResult::error.
+    std::vector<RelaxJobResult> relax_batch(const std::vector<RelaxJob>& jobs, int threads, std::string_view program_name);
+
+} // namespace acmacs::chart
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -1,3 +1,5 @@
+#include <charconv>
+
 #include "acmacs-base/log.hh"
 #include "acmacs-base/range.hh"
 #include "acmacs-chart-2/rjson-import.hh"
@@ -88,18 +90,7 @@ size_t acmacs::chart::RjsonTiters::number_of_non_dont_cares() const
 
 size_t acmacs::chart::RjsonTiters::titrations_for_antigen(size_t antigen_no) const
 {
-    size_t result = 0;
-    if (const auto& list = data_[keys_.list]; !list.is_null()) {
-        const rjson::value& row = list[antigen_no];
-        rjson::for_each(row, [&result](const rjson::value& titer) {
-            if (!Titer(titer.to<std::string_view>()).is_dont_care())
-                ++result;
-        });
-    }
-    else {
-        result += data_[keys_.dict][antigen_no].size();
-    }
-    return result;
+    return statistics()->titrations_for_antigen(antigen_no);
 
 } // acmacs::chart::RjsonTiters::titrations_for_antigen
 
@@ -107,20 +98,7 @@ size_t acmacs::chart::RjsonTiters::titrations_for_antigen(size_t antigen_no) con
 
 size_t acmacs::chart::RjsonTiters::titrations_for_serum(size_t serum_no) const
 {
-    size_t result = 0;
-    if (const auto& list = data_[keys_.list]; !list.is_null()) {
-        rjson::for_each(list, [&result, serum_no](const rjson::value& row) {
-            if (!Titer(row[serum_no].to<std::string_view>()).is_dont_care())
-                ++result;
-        });
-    }
-    else {
-        rjson::for_each(data_[keys_.dict], [&result, serum_no](const rjson::value& row) {
-            if (const auto& titer = row[serum_no]; !titer.is_null() && !Titer{titer.to<std::string_view>()}.is_dont_care())
-                ++result;
-        });
-    }
-    return result;
+    return statistics()->titrations_for_serum(serum_no);
 
 } // acmacs::chart::RjsonTiters::titrations_for_serum
 
@@ -240,6 +218,41 @@ namespace
 
 // ----------------------------------------------------------------------
 
+void acmacs::chart::RjsonTiters::for_each_titer_row(const titer_row_visitor_t& func) const
+{
+    titer_row_t row;
+    if (const auto& list = data_[keys_.list]; !list.is_null()) {
+        rjson::for_each(list, [&row, &func](const rjson::value& source, size_t antigen_no) {
+            row.clear();
+            rjson::for_each(source, [&row](const rjson::value& titer, size_t serum_no) {
+                if (const auto text = titer.to<std::string_view>(); text != "*")
+                    row.emplace_back(serum_no, text);
+            });
+            if (!row.empty())
+                func(antigen_no, row);
+        });
+    }
+    else {
+        rjson::for_each(data_[keys_.dict], [&row, &func](const rjson::value& source, size_t antigen_no) {
+            row.clear();
+            rjson::for_each(source, [&row](std::string_view field_name, const rjson::value& titer) {
+                if (const auto text = titer.to<std::string_view>(); text != "*") {
+                    size_t serum_no{0};
+                    if (const auto [end, ec] = std::from_chars(field_name.data(), field_name.data() + field_name.size(), serum_no); ec != std::errc{} || end != field_name.data() + field_name.size())
+                        throw invalid_data{AD_FORMAT("for_each_titer_row: invalid serum index \"{}\"", field_name)};
+                    row.emplace_back(serum_no, text);
+                }
+            });
+            std::sort(row.begin(), row.end(), [](const auto& e1, const auto& e2) { return e1.first < e2.first; });
+            if (!row.empty())
+                func(antigen_no, row);
+        });
+    }
+
+} // acmacs::chart::RjsonTiters::for_each_titer_row
+
+// ----------------------------------------------------------------------
+
 acmacs::chart::TiterIteratorMaker acmacs::chart::RjsonTiters::titers_existing() const
 {
     if (const auto& list = data_[keys_.list]; !list.is_null())
@@ -282,51 +295,6 @@ acmacs::chart::rjson_import::Layout::Layout(const rjson::value& aData) : acmacs:
 
 // ----------------------------------------------------------------------
 
-static void update_list(const rjson::value& data, acmacs::chart::TableDistances& table_distances, const acmacs::chart::ColumnBases& column_bases, const acmacs::chart::StressParameters& parameters, size_t number_of_points)
-{
-    const auto logged_adjusts = parameters.avidity_adjusts.logged(number_of_points);
-    for (auto p1 : acmacs::range(data.size())) {
-        if (!parameters.disconnected.contains(p1)) {
-            const auto& row = data[p1];
-            for (auto serum_no : acmacs::range(row.size())) {
-                const auto p2 = serum_no + data.size();
-                if (!parameters.disconnected.contains(p2)) {
-                    table_distances.update(acmacs::chart::Titer{row[serum_no].to<std::string_view>()}, p1, p2, column_bases.column_basis(serum_no), logged_adjusts[p1] + logged_adjusts[p2], parameters.mult);
-                }
-            }
-        }
-    }
-
-} // update_list
-
-static void update_dict(const rjson::value& data, acmacs::chart::TableDistances& table_distances, const acmacs::chart::ColumnBases& column_bases, const acmacs::chart::StressParameters& parameters, size_t number_of_points)
-{
-    const auto logged_adjusts = parameters.avidity_adjusts.logged(number_of_points);
-    for (auto p1 : acmacs::range(data.size())) {
-        if (!parameters.disconnected.contains(p1)) {
-            rjson::for_each(data[p1], [num_antigens=data.size(),p1,&parameters,&table_distances,&column_bases,&logged_adjusts](std::string_view field_name, const rjson::value& field_value) {
-                const auto serum_no = std::stoul(field_name);
-                const auto p2 = serum_no + num_antigens;
-                if (!parameters.disconnected.contains(p2))
-                    table_distances.update(acmacs::chart::Titer{field_value.to<std::string_view>()}, p1, p2, column_bases.column_basis(serum_no), logged_adjusts[p1] + logged_adjusts[p2], parameters.mult);
-            });
-        }
-    }
-
-} // update_dict
-
-void acmacs::chart::rjson_import::update(const rjson::value& data, std::string_view list_key, const std::string& dict_key, TableDistances& table_distances, const ColumnBases& column_bases, const StressParameters& parameters, size_t number_of_points)
-{
-    table_distances.dodgy_is_regular(parameters.dodgy_titer_is_regular);
-    if (const auto& list = data[list_key]; !list.is_null())
-        ::update_list(list, table_distances, column_bases, parameters, number_of_points);
-    else
-        ::update_dict(data[dict_key], table_distances, column_bases, parameters, number_of_points);
-
-} // acmacs::chart::rjson_import::update
-
-// ----------------------------------------------------------------------
-
 acmacs::chart::DisconnectedPoints acmacs::chart::RjsonProjection::disconnected() const
 {
     auto result = make_disconnected();
@@ -42,10 +42,6 @@ namespace acmacs::chart::rjson_import
 
     }; // class Layout
 
-// ----------------------------------------------------------------------
-
-    void update(const rjson::value& data, std::string_view list_key, const std::string& dict_key, TableDistances& table_distances, const ColumnBases& column_bases, const StressParameters& parameters, size_t number_of_points);
-
 } // namespace acmacs::chart::rjson
 
 // ----------------------------------------------------------------------
@@ -112,14 +108,7 @@ namespace acmacs::chart
                 throw data_not_available{"no \"" + keys_.layers + "\""};
         }
 
-        void update(TableDistances& table_distances, const ColumnBases& column_bases, const acmacs::chart::StressParameters& parameters) const override
-        {
-            if (number_of_sera())
-                rjson_import::update(data_, keys_.list, keys_.dict, table_distances, column_bases, parameters, number_of_antigens() + number_of_sera());
-            else
-                throw std::runtime_error(AD_FORMAT("genetic table support not implemented"));
-        }
-
+        void for_each_titer_row(const titer_row_visitor_t& func) const override;
         TiterIteratorMaker titers_existing() const override;
         TiterIteratorMaker titers_existing_from_layer(size_t layer_no) const override;
 
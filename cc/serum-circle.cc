@@ -75,14 +75,14 @@ const char* acmacs::chart::detail::SerumCirclePerAntigen::report_reason() const
 class TiterDistance
 {
   public:
-    TiterDistance(acmacs::chart::Titer aTiter, double aColumnBase, double aDistance)
+    TiterDistance(acmacs::chart::EncodedTiter aTiter, double aColumnBase, double aDistance)
         : titer(aTiter), similarity(aTiter.is_dont_care() ? 0.0 : aTiter.logged_for_column_bases()), final_similarity(std::min(aColumnBase, similarity)), distance(aDistance)
     {
     }
     TiterDistance() : similarity(0), final_similarity(0), distance(std::numeric_limits<double>::quiet_NaN()) {}
     operator bool() const { return !titer.is_dont_care() && !std::isnan(distance); }
 
-    acmacs::chart::Titer titer;
+    acmacs::chart::EncodedTiter titer;
     double similarity;
     double final_similarity;
     double distance;
@@ -137,10 +137,11 @@ void acmacs::chart::detail::serum_circle_empirical(const SerumCircle& circle_dat
         return;
     }
 
+    const auto encoded = titers.encoded();
     std::vector<TiterDistance> titers_and_distances(titers.number_of_antigens());
     size_t max_titer_for_serum_ag_no = 0;
     for (size_t ag_no = 0; ag_no < titers.number_of_antigens(); ++ag_no) {
-        const auto titer = titers.titer(ag_no, circle_data.serum_no());
+        const auto titer = encoded->titer(ag_no, circle_data.serum_no());
         if (!titer.is_dont_care()) {
             // TODO: antigensSeraTitersMultipliers (acmacs/plot/serum_circle.py:113)
             titers_and_distances[ag_no] = TiterDistance(titer, circle_data.column_basis(), layout.distance(ag_no, circle_data.serum_no() + titers.number_of_antigens()));
@@ -177,9 +178,9 @@ void acmacs::chart::detail::serum_circle_empirical(const SerumCircle& circle_dat
         fmt::print(stderr, "  AG    distance   titer   simil   fsimil\n");
         for (auto ag_no : antigens_by_distances) {
             if (titers_and_distances[ag_no])
-                fmt::print(stderr, " {:4d}   {:7.4f}  {:>6s}     {:4.2f}    {:4.2f}\n", ag_no, titers_and_distances[ag_no].distance, fmt::format("{}", titers_and_distances[ag_no].titer), titers_and_distances[ag_no].similarity, titers_and_distances[ag_no].final_similarity);
+                fmt::print(stderr, " {:4d}   {:7.4f}  {:>6s}     {:4.2f}    {:4.2f}\n", ag_no, titers_and_distances[ag_no].distance, fmt::format("{}", titers_and_distances[ag_no].titer.titer()), titers_and_distances[ag_no].similarity, titers_and_distances[ag_no].final_similarity);
             else if (!titers_and_distances[ag_no].titer.is_dont_care())
-                fmt::print(stderr, " {:4d}   disconn  {:>6s}     {:4.2f}    {:4.2f}\n", ag_no, fmt::format("{}", titers_and_distances[ag_no].titer), titers_and_distances[ag_no].similarity, titers_and_distances[ag_no].final_similarity);
+                fmt::print(stderr, " {:4d}   disconn  {:>6s}     {:4.2f}    {:4.2f}\n", ag_no, fmt::format("{}", titers_and_distances[ag_no].titer.titer()), titers_and_distances[ag_no].similarity, titers_and_distances[ag_no].final_similarity);
         }
     }
 
@@ -378,9 +379,10 @@ acmacs::chart::SerumCoverageIndexes acmacs::chart::serum_coverage(const Titers&
     if (titer_threshold <= 0)
         throw serum_coverage_error(fmt::format("homologous titer is too low: {}", *homologous_titer));
     SerumCoverageIndexes indexes;
+    const auto encoded = titers.encoded();
     // AD_DEBUG("titer_threshold {}", titer_threshold);
     for (size_t ag_no = 0; ag_no < titers.number_of_antigens(); ++ag_no) {
-        const Titer titer = titers.titer(ag_no, serum_no);
+        const auto titer = encoded->titer(ag_no, serum_no);
         const double value = titer.is_dont_care() ? -1 : titer.logged_for_column_bases();
         // AD_DEBUG("{} -> {}", titer, value);
         if (value >= titer_threshold)
@@ -0,0 +1,104 @@
+#include <random>
+#include <numeric>
+#include <algorithm>
+
+#include "acmacs-base/fmt.hh"
+#include "acmacs-chart-2/stochastic.hh"
+#include "acmacs-chart-2/alglib.hh"
+#include "acmacs-chart-2/optimize.hh"
+#include "acmacs-chart-2/stress.hh"
+
+// ----------------------------------------------------------------------
+
+namespace acmacs::chart::stochastic
+{
+    struct schedule_t
+    {
+        size_t max_epochs;
+        double relative_tolerance; // stop when epoch stress improves by less than this fraction
+    };
+
+    inline schedule_t schedule(acmacs::chart::optimization_precision precision)
+    {
+        switch (precision) {
+            case acmacs::chart::optimization_precision::very_rough:
+                return {10, 1e-2};
+            case acmacs::chart::optimization_precision::rough:
+                return {25, 1e-3};
+            case acmacs::chart::optimization_precision::fine:
+                return {50, 1e-4};
+        }
+        return {50, 1e-4};
+    }
+
+    constexpr const size_t batches_per_epoch{64};
+    constexpr const size_t min_batch_size{1024};
+    constexpr const size_t max_batch_size{65536};
+    constexpr const double learning_rate{0.1};      // in map units, decays linearly down to learning_rate * final_learning_rate_ratio
+    constexpr const double final_learning_rate_ratio{0.1};
+    constexpr const double beta1{0.9}, beta2{0.999}, epsilon{1e-8};
+    constexpr const std::mt19937::result_type shuffle_seed{20201019}; // results must be reproducible for the same starting layout
+
+} // namespace acmacs::chart::stochastic
+
+// ----------------------------------------------------------------------
+
+void acmacs::chart::stochastic::adam_lbfgs_optimize(acmacs::chart::optimization_status& status, acmacs::chart::OptimiserCallbackData& callback_data, double* arg_first, double* arg_last,
+                                                    acmacs::chart::optimization_precision precision)
+{
+    const auto& stress = callback_data.stress;
+    const auto number_of_entries = stress.number_of_entries();
+    const auto num_args = static_cast<size_t>(arg_last - arg_first);
+    size_t epochs{0}, steps{0};
+
+    if (number_of_entries >= min_batch_size * 4) {
+        const auto [max_epochs, relative_tolerance] = schedule(precision);
+        const auto batch_size = std::clamp(number_of_entries / batches_per_epoch, min_batch_size, max_batch_size);
+
+        std::vector<size_t> entries(number_of_entries);
+        std::iota(entries.begin(), entries.end(), 0UL);
+        std::vector<double> gradient(num_args), first_moment(num_args, 0.0), second_moment(num_args, 0.0);
+        std::mt19937 generator{shuffle_seed};
+        double beta1_power{1.0}, beta2_power{1.0};
+        double previous_epoch_stress{std::numeric_limits<double>::max()};
+
+        for (; epochs < max_epochs; ++epochs) {
+            std::shuffle(entries.begin(), entries.end(), generator);
+            const double rate = learning_rate * (1.0 - (1.0 - final_learning_rate_ratio) * static_cast<double>(epochs) / static_cast<double>(max_epochs));
+            double epoch_stress{0.0}; // estimate: each batch is evaluated at the layout current at the batch time
+            for (size_t batch_first = 0; batch_first < number_of_entries; batch_first += batch_size, ++steps) {
+                const auto batch_last = std::min(batch_first + batch_size, number_of_entries);
+                epoch_stress += stress.value_gradient_for_entries(arg_first, arg_last, gradient.data(), entries.data() + batch_first, entries.data() + batch_last);
+                beta1_power *= beta1;
+                beta2_power *= beta2;
+                for (size_t arg_no = 0; arg_no < num_args; ++arg_no) {
+                    first_moment[arg_no] = beta1 * first_moment[arg_no] + (1.0 - beta1) * gradient[arg_no];
+                    second_moment[arg_no] = beta2 * second_moment[arg_no] + (1.0 - beta2) * gradient[arg_no] * gradient[arg_no];
+                    arg_first[arg_no] -= rate * (first_moment[arg_no] / (1.0 - beta1_power)) / (std::sqrt(second_moment[arg_no] / (1.0 - beta2_power)) + epsilon);
+                }
+            }
+            if (callback_data.report_iterations()) {
+                callback_data.set_gradient_norm(gradient.data(), num_args); // of the last mini-batch
+                callback_data.iteration_done(arg_first, num_args, epoch_stress);
+            }
+            if ((previous_epoch_stress - epoch_stress) < (relative_tolerance * epoch_stress)) {
+                ++epochs;
+                break;
+            }
+            previous_epoch_stress = epoch_stress;
+        }
+    }
+
+    alglib::lbfgs_optimize(status, callback_data, arg_first, arg_last, precision);
+    if (epochs > 0) {
+        status.termination_report = fmt::format("adam: {} epochs, {} mini-batch steps; lbfgs: {}", epochs, steps, status.termination_report);
+        status.number_of_iterations += steps;
+        status.number_of_stress_calculations += epochs; // full pass equivalents
+    }
+
+} // acmacs::chart::stochastic::adam_lbfgs_optimize
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
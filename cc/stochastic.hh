@@ -0,0 +1,26 @@
+#pragma once
+
+#include "acmacs-chart-2/optimization-precision.hh"
+
+// ----------------------------------------------------------------------
+
+namespace acmacs::chart
+{
+    struct optimization_status;
+    struct OptimiserCallbackData;
+}
+
+// ----------------------------------------------------------------------
+
+namespace acmacs::chart::stochastic
+{
+    // mini-batch Adam over shuffled table distances entries followed by full-batch alglib lbfgs polishing
+    // charts with too few table distances are optimized by lbfgs only
+    void adam_lbfgs_optimize(acmacs::chart::optimization_status& status, acmacs::chart::OptimiserCallbackData& callback_data, double* arg_first, double* arg_last, acmacs::chart::optimization_precision precision);
+
+} // namespace acmacs::chart::stochastic
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
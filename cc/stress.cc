@@ -39,7 +39,7 @@ acmacs::chart::Stress acmacs::chart::stress_factory(const acmacs::chart::Project
     auto cb = projection.forced_column_bases();
     if (!cb)
         cb = projection.chart().column_bases(projection.minimum_column_basis());
-    projection.chart().titers()->update(stress.table_distances(), *cb, stress.parameters());
+    stress.set_table_distances(projection.chart().titers()->cached_table_distances(*cb, stress.parameters()));
     return stress;
 
 } // acmacs::chart::stress_factory
@@ -53,7 +53,7 @@ acmacs::chart::Stress acmacs::chart::stress_factory(const Projection& projection
     auto cb = projection.forced_column_bases();
     if (!cb)
         cb = projection.chart().column_bases(projection.minimum_column_basis());
-    projection.chart().titers()->update(stress.table_distances(), *cb, stress.parameters());
+    stress.set_table_distances(projection.chart().titers()->cached_table_distances(*cb, stress.parameters()));
     return stress;
 
 } // acmacs::chart::stress_factory
@@ -66,7 +66,7 @@ acmacs::chart::Stress acmacs::chart::stress_factory(const acmacs::chart::Chart&
     auto cb = chart.forced_column_bases(minimum_column_basis);
     if (!cb)
         cb = chart.column_bases(minimum_column_basis);
-    chart.titers()->update(stress.table_distances(), *cb, stress.parameters());
+    stress.set_table_distances(chart.titers()->cached_table_distances(*cb, stress.parameters()));
     return stress;
 
 } // acmacs::chart::stress_factory
@@ -79,7 +79,7 @@ acmacs::chart::TableDistances acmacs::chart::table_distances(const acmacs::chart
     auto cb = chart.forced_column_bases(minimum_column_basis);
     if (!cb)
         cb = chart.column_bases(minimum_column_basis);
-    return chart.titers()->table_distances(*cb, stress.parameters());
+    return *chart.titers()->cached_table_distances(*cb, stress.parameters());
 
 } // acmacs::chart::table_distances
 
@@ -136,6 +136,21 @@ acmacs::chart::Stress::Stress(number_of_dimensions_t number_of_dimensions, size_
 
 // ----------------------------------------------------------------------
 
+acmacs::chart::TableDistances& acmacs::chart::Stress::table_distances_modify()
+{
+    // table distances shared with the titers cache or stress copies are copied before modification
+    if (!owned_table_distances_) {
+        owned_table_distances_ = std::make_shared<TableDistances>(*table_distances_);
+        table_distances_.reset();
+    }
+    else if (owned_table_distances_.use_count() > 1)
+        owned_table_distances_ = std::make_shared<TableDistances>(*owned_table_distances_);
+    return *owned_table_distances_;
+
+} // acmacs::chart::Stress::table_distances_modify
+
+// ----------------------------------------------------------------------
+
 inline double contribution_regular(size_t point_1, size_t point_2, double table_distance, const double* first, acmacs::number_of_dimensions_t num_dim)
 {
     const double diff = table_distance - map_distance(first, point_1, point_2, num_dim);
@@ -181,6 +196,25 @@ double acmacs::chart::Stress::value(const acmacs::Layout& aLayout) const
 
 // ----------------------------------------------------------------------
 
+std::vector<double> acmacs::chart::Stress::contributions(const double* first) const
+{
+    std::vector<double> result(parameters_.number_of_points, 0.0);
+    for (const auto& entry : table_distances().regular()) {
+        const auto contribution = contribution_regular(entry.point_1, entry.point_2, entry.distance, first, number_of_dimensions_);
+        result[entry.point_1] += contribution;
+        result[entry.point_2] += contribution;
+    }
+    for (const auto& entry : table_distances().less_than()) {
+        const auto contribution = contribution_less_than(entry.point_1, entry.point_2, entry.distance, first, number_of_dimensions_);
+        result[entry.point_1] += contribution;
+        result[entry.point_2] += contribution;
+    }
+    return result;
+
+} // acmacs::chart::Stress::contributions
+
+// ----------------------------------------------------------------------
+
 double acmacs::chart::Stress::contribution(size_t point_no, const double* first) const
 {
     return std::transform_reduce(table_distances().begin_regular_for(point_no), table_distances().end_regular_for(point_no), double{0}, std::plus<>(),
@@ -345,6 +379,63 @@ void acmacs::chart::Stress::gradient_with_unmovable(const double* first, const d
 
 // ----------------------------------------------------------------------
 
+double acmacs::chart::Stress::value_gradient_for_entries(const double* first, const double* last, double* gradient_first, const size_t* entry_first, const size_t* entry_last) const
+{
+    std::for_each(gradient_first, gradient_first + (last - first), [](double& val) { val = 0; });
+
+    const auto num_dim = static_cast<size_t>(number_of_dimensions_);
+    auto update = [first, gradient_first, num_dim](const auto& entry, double inc_base) {
+        using diff_t = typename std::vector<double>::difference_type;
+        auto p1 = first + static_cast<diff_t>(entry.point_1 * num_dim), p2 = first + static_cast<diff_t>(entry.point_2 * num_dim);
+        auto r1 = gradient_first + static_cast<diff_t>(entry.point_1 * num_dim), r2 = gradient_first + static_cast<diff_t>(entry.point_2 * num_dim);
+        for (size_t dim = 0; dim < num_dim; ++dim, ++p1, ++p2, ++r1, ++r2) {
+            const double inc = inc_base * (*p1 - *p2);
+            *r1 -= inc;
+            *r2 += inc;
+        }
+    };
+
+    const auto& regular = table_distances().regular();
+    const auto& less_than = table_distances().less_than();
+    double value{0};
+    for (auto entry_no = entry_first; entry_no != entry_last; ++entry_no) {
+        if (*entry_no < regular.size()) {
+            const auto& entry = regular[*entry_no];
+            const double map_dist = ::map_distance(first, entry, number_of_dimensions_);
+            const double diff = entry.distance - map_dist;
+            value += diff * diff;
+            update(entry, diff * 2 / non_zero(map_dist));
+        }
+        else {
+            const auto& entry = less_than[*entry_no - regular.size()];
+            const double map_dist = ::map_distance(first, entry, number_of_dimensions_);
+            const double diff = entry.distance - map_dist + 1;
+            const double sigm = acmacs::sigmoid(diff * SigmoidMutiplier());
+            value += diff * diff * sigm;
+            update(entry, (diff * 2 * sigm + diff * diff * acmacs::d_sigmoid(diff * SigmoidMutiplier()) * SigmoidMutiplier()) / non_zero(map_dist));
+        }
+    }
+
+    if (!parameters_.unmovable->empty() || !parameters_.unmovable_in_the_last_dimension->empty())
+        reset_gradient_of_unmovable(gradient_first);
+    return value;
+
+} // acmacs::chart::Stress::value_gradient_for_entries
+
+// ----------------------------------------------------------------------
+
+void acmacs::chart::Stress::reset_gradient_of_unmovable(double* gradient_first) const
+{
+    const auto num_dim = static_cast<size_t>(number_of_dimensions_);
+    for (const auto p_no : parameters_.unmovable)
+        std::fill(gradient_first + p_no * num_dim, gradient_first + (p_no + 1) * num_dim, 0.0);
+    for (const auto p_no : parameters_.unmovable_in_the_last_dimension)
+        gradient_first[(p_no + 1) * num_dim - 1] = 0.0;
+
+} // acmacs::chart::Stress::reset_gradient_of_unmovable
+
+// ----------------------------------------------------------------------
+
 void acmacs::chart::Stress::set_coordinates_of_disconnected(double* first, [[maybe_unused]] size_t num_args, double value, number_of_dimensions_t number_of_dimensions) const
 {
     // do not use number_of_dimensions_! after pca its value is wrong!
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <memory>
+
 #include "acmacs-chart-2/optimize-options.hh"
 #include "acmacs-chart-2/table-distances.hh"
 #include "acmacs-chart-2/point-index-list.hh"
@@ -50,16 +52,21 @@ namespace acmacs::chart
         double contribution(size_t point_no, const acmacs::Layout& aLayout) const;
         double contribution(size_t point_no, const TableDistancesForPoint& table_distances_for_point, const double* first) const;
         double contribution(size_t point_no, const TableDistancesForPoint& table_distances_for_point, const acmacs::Layout& aLayout) const;
+        // contributions of all points in one pass over table distances, each entry is added to both its points
+        std::vector<double> contributions(const double* first) const;
         std::vector<double> gradient(const double* first, const double* last) const;
         void gradient(const double* first, const double* last, double* gradient_first) const;
         double value_gradient(const double* first, const double* last, double* gradient_first) const;
+        // stress and gradient contributed by a subset of table distances (mini-batch), entry index refers to regular() followed by less_than()
+        double value_gradient_for_entries(const double* first, const double* last, double* gradient_first, const size_t* entry_first, const size_t* entry_last) const;
+        size_t number_of_entries() const { return table_distances().regular().size() + table_distances().less_than().size(); }
         std::vector<double> gradient(const acmacs::Layout& aLayout) const;
         constexpr auto number_of_dimensions() const { return number_of_dimensions_; }
         void change_number_of_dimensions(number_of_dimensions_t num_dim) { number_of_dimensions_ = num_dim; }
 
-        constexpr const TableDistances& table_distances() const { return table_distances_; }
-        constexpr TableDistances& table_distances() { return table_distances_; }
-        TableDistancesForPoint table_distances_for(size_t point_no) const { return TableDistancesForPoint(point_no, table_distances_); }
+        const TableDistances& table_distances() const { return owned_table_distances_ ? *owned_table_distances_ : *table_distances_; }
+        TableDistances& table_distances_modify(); // table distances shared with stress copies and titers cache are copied first
+        TableDistancesForPoint table_distances_for(size_t point_no) const { return TableDistancesForPoint(point_no, table_distances()); }
         constexpr const StressParameters& parameters() const { return parameters_; }
         constexpr StressParameters& parameters() { return parameters_; }
         void set_disconnected(const DisconnectedPoints& to_disconnect) { parameters_.disconnected = to_disconnect; }
@@ -72,11 +79,19 @@ namespace acmacs::chart
 
      private:
         number_of_dimensions_t number_of_dimensions_;
-        TableDistances table_distances_;
+        std::shared_ptr<const TableDistances> table_distances_{std::make_shared<const TableDistances>()}; // shared with stress copies and titers cache, copying stress does not copy table distances
+        std::shared_ptr<TableDistances> owned_table_distances_; // made by table_distances_modify(), shared with stress copies made afterwards until they modify it
         StressParameters parameters_;
 
+        // table distances are shared with the titers cache, only stress factories set them
+        void set_table_distances(std::shared_ptr<const TableDistances> table_distances) { table_distances_ = std::move(table_distances); owned_table_distances_.reset(); }
+        friend Stress stress_factory(const Projection& projection, multiply_antigen_titer_until_column_adjust mult);
+        friend Stress stress_factory(const Chart& chart, number_of_dimensions_t number_of_dimensions, MinimumColumnBasis minimum_column_basis, multiply_antigen_titer_until_column_adjust mult, dodgy_titer_is_regular a_dodgy_titer_is_regular);
+        friend Stress stress_factory(const Projection& projection, size_t antigen_no, double logged_avidity_adjust, multiply_antigen_titer_until_column_adjust mult);
+
         void gradient_plain(const double* first, const double* last, double* gradient_first) const;
         void gradient_with_unmovable(const double* first, const double* last, double* gradient_first) const;
+        void reset_gradient_of_unmovable(double* gradient_first) const;
 
     }; // class Stress
 
@@ -93,15 +93,17 @@ namespace acmacs::chart
 
         void update(const acmacs::chart::Titer& titer, size_t p1, size_t p2, double column_basis, double adjust, multiply_antigen_titer_until_column_adjust mult)
         {
-            try {
-                auto distance = column_basis - titer.logged() - adjust;
-                if (distance < 0 && mult == multiply_antigen_titer_until_column_adjust::yes)
-                    distance = 0;
-                add_value(titer.type(), p1, p2, distance);
-            }
-            catch (acmacs::chart::invalid_titer&) {
-                // ignore dont-care
-            }
+            update(EncodedTiter{titer}, p1, p2, column_basis, adjust, mult);
+        }
+
+        void update(EncodedTiter titer, size_t p1, size_t p2, double column_basis, double adjust, multiply_antigen_titer_until_column_adjust mult)
+        {
+            if (!titer.has_value())
+                return; // ignore dont-care
+            auto distance = column_basis - titer.logged() - adjust;
+            if (distance < 0 && mult == multiply_antigen_titer_until_column_adjust::yes)
+                distance = 0;
+            add_value(titer.type(), p1, p2, distance);
         }
 
         // void report() const { std::cerr << "TableDistances regular: " << regular().size() << "  less-than: " << less_than().size() << '\n'; }
@@ -0,0 +1,163 @@
+#include <optional>
+
+#include "acmacs-base/fmt.hh"
+#include "acmacs-chart-2/factory-import.hh"
+#include "acmacs-chart-2/chart.hh"
+
+// EncodedTiter: exact text round trip and numeric parity with the string based Titer implementation it replaced
+
+using namespace acmacs::chart;
+
+static void test_titer(std::string_view source);
+static void test_rejected(std::string_view source);
+static std::optional<double> old_logged(const Titer& titer);
+static std::optional<double> old_logged_with_thresholded(const Titer& titer);
+static std::optional<double> old_logged_for_column_bases(const Titer& titer);
+static void check(bool condition, std::string_view titer, std::string_view message);
+
+// ----------------------------------------------------------------------
+
+int main(int argc, char* const argv[])
+{
+    int exit_code = 0;
+    try {
+        for (const auto* source : {"*", "0", "5", "10", "20", "40", "80", "160", "1280", "10240", "163840", "30", "50", "100", "113", "1000",
+                                   "<10", "<20", "<40", "<50", "<1", ">1280", ">10240", ">5000", "~40", "~80", "~100", "~7",
+                                   "040", "00", "<010", ">010240", "~00040", "000000080", "0000000"})
+            test_titer(source);
+        for (const auto* source : {"", "<", ">", "~", "00000000040", "<00000000010", "99999999999", "4x0", "<4a", "**", "a40"})
+            test_rejected(source);
+
+        for (int file_no = 1; file_no < argc; ++file_no) {
+            auto chart = import_from_file(argv[file_no]);
+            for (const auto& titer_data : chart->titers()->titers_existing())
+                test_titer(*titer_data.titer);
+        }
+    }
+    catch (std::exception& err) {
+        fmt::print(stderr, "ERROR: {}\n", err);
+        exit_code = 2;
+    }
+    return exit_code;
+}
+
+// ----------------------------------------------------------------------
+
+void check(bool condition, std::string_view titer, std::string_view message)
+{
+    if (!condition)
+        throw std::runtime_error(fmt::format("encoded titer \"{}\": {}", titer, message));
+
+} // check
+
+// ----------------------------------------------------------------------
+
+void test_titer(std::string_view source)
+{
+    const Titer titer{source};
+    const EncodedTiter encoded{titer};
+    check(encoded.type() == titer.type(), source, "type");
+    check(encoded.titer() == titer, source, fmt::format("round trip produced \"{}\"", *encoded.titer()));
+    check(EncodedTiter{source} == encoded, source, "encoding from string_view differs");
+
+    const auto compare = [source](std::string_view name, const std::optional<double>& expected, auto&& get) {
+        std::optional<double> result;
+        try {
+            result = get();
+        }
+        catch (invalid_titer&) {
+        }
+        if (expected.has_value())
+            check(result.has_value() && *result == *expected, source, fmt::format("{}: {} expected: {}", name, result ? fmt::format("{}", *result) : std::string{"throws"}, *expected));
+        else
+            check(!result.has_value(), source, fmt::format("{}: {} expected to throw", name, *result));
+    };
+    compare("logged", old_logged(titer), [&encoded] { return encoded.logged(); });
+    compare("logged_with_thresholded", old_logged_with_thresholded(titer), [&encoded] { return encoded.logged_with_thresholded(); });
+    compare("logged_for_column_bases", old_logged_for_column_bases(titer), [&encoded] { return encoded.logged_for_column_bases(); });
+    compare("Titer::logged", old_logged(titer), [&titer] { return titer.logged(); });
+    compare("Titer::logged_with_thresholded", old_logged_with_thresholded(titer), [&titer] { return titer.logged_with_thresholded(); });
+    compare("Titer::logged_for_column_bases", old_logged_for_column_bases(titer), [&titer] { return titer.logged_for_column_bases(); });
+
+} // test_titer
+
+// ----------------------------------------------------------------------
+
+void test_rejected(std::string_view source)
+{
+    bool rejected = false;
+    try {
+        EncodedTiter encoded{source};
+    }
+    catch (invalid_titer&) {
+        rejected = true;
+    }
+    check(rejected, source, "expected to be rejected");
+
+} // test_rejected
+
+// ----------------------------------------------------------------------
+
+// string based implementation of Titer::logged() replaced by EncodedTiter
+
+std::optional<double> old_logged(const Titer& titer)
+{
+    constexpr auto log_titer = [](std::string_view source) -> double { return std::log2(std::stod(std::string{source}) / 10.0); };
+
+    switch (titer.type()) {
+        case Titer::Regular:
+            return log_titer(titer);
+        case Titer::LessThan:
+        case Titer::MoreThan:
+        case Titer::Dodgy:
+            return log_titer(titer.get().substr(1));
+        case Titer::DontCare:
+        case Titer::Invalid:
+            break;
+    }
+    return std::nullopt;
+
+} // old_logged
+
+// ----------------------------------------------------------------------
+
+std::optional<double> old_logged_with_thresholded(const Titer& titer)
+{
+    const auto logged = old_logged(titer);
+    if (!logged.has_value())
+        return logged;
+    switch (titer.type()) {
+        case Titer::LessThan:
+            return *logged - 1;
+        case Titer::MoreThan:
+            return *logged + 1;
+        default:
+            return logged;
+    }
+
+} // old_logged_with_thresholded
+
+// ----------------------------------------------------------------------
+
+std::optional<double> old_logged_for_column_bases(const Titer& titer)
+{
+    switch (titer.type()) {
+        case Titer::Regular:
+        case Titer::LessThan:
+            return old_logged(titer);
+        case Titer::MoreThan:
+            return *old_logged(titer) + 1;
+        case Titer::DontCare:
+        case Titer::Dodgy:
+            return -1.0;
+        case Titer::Invalid:
+            break;
+    }
+    return std::nullopt;
+
+} // old_logged_for_column_bases
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
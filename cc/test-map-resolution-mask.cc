@@ -0,0 +1,106 @@
+#include <set>
+#include <cmath>
+
+#include "acmacs-base/fmt.hh"
+#include "acmacs-chart-2/factory-import.hh"
+#include "acmacs-chart-2/chart-modify.hh"
+#include "acmacs-chart-2/map-resolution-test.hh"
+
+// mask replicates of map resolution test: proportion of held out entries, held out entries are not used for relaxing
+
+using namespace acmacs::chart;
+
+static void test_mask(ChartModify& chart);
+static void check(bool condition, std::string_view message);
+
+// ----------------------------------------------------------------------
+
+int main(int argc, char* const argv[])
+{
+    int exit_code = 0;
+    try {
+        if (argc < 2)
+            throw std::runtime_error(std::string("usage: ") + argv[0] + " <chart-file> ...");
+
+        for (int file_no = 1; file_no < argc; ++file_no) {
+            ChartModify chart{import_from_file(argv[file_no])};
+            test_mask(chart);
+        }
+    }
+    catch (std::exception& err) {
+        fmt::print(stderr, "ERROR: {}\n", err);
+        exit_code = 2;
+    }
+    return exit_code;
+}
+
+// ----------------------------------------------------------------------
+
+void check(bool condition, std::string_view message)
+{
+    if (!condition)
+        throw std::runtime_error(fmt::format("map resolution test mask: {}", message));
+
+} // check
+
+// ----------------------------------------------------------------------
+
+void test_mask(ChartModify& chart)
+{
+    using namespace map_resolution_test_internal;
+
+    map_resolution_test_data::Parameters parameters;
+    parameters.number_of_optimizations = number_of_optimizations_t{3};
+    parameters.dont_care_replicates = map_resolution_test_data::dont_care_replicates::mask;
+    const MaskedReplicates replicates{chart, parameters};
+
+    const auto& master = replicates.master_stress().table_distances();
+    const auto number_of_entries = replicates.number_of_entries();
+    check(number_of_entries == (master.regular().size() + master.less_than().size()), "number of entries");
+    const auto entry_of = [&master](size_t entry_no) -> const auto& { return entry_no < master.regular().size() ? master.regular()[entry_no] : master.less_than()[entry_no - master.regular().size()]; };
+
+    std::mt19937 generator{17};
+    for (const double proportion : {0.1, 0.2, 0.3, 0.5}) {
+        const auto mask = replicates.make_mask(proportion, generator);
+        std::set<std::pair<size_t, size_t>> held_out;
+        std::vector<size_t> numeric_titers(chart.number_of_points(), 0);
+        for (size_t entry_no = 0; entry_no < number_of_entries; ++entry_no) {
+            const auto& entry = entry_of(entry_no);
+            if (MaskedReplicates::masked(mask, entry_no)) {
+                held_out.emplace(entry.point_1, entry.point_2);
+            }
+            else if (entry_no < master.regular().size()) {
+                ++numeric_titers[entry.point_1];
+                ++numeric_titers[entry.point_2];
+            }
+        }
+        check(held_out.size() == static_cast<size_t>(std::lround(static_cast<double>(number_of_entries) * proportion)), fmt::format("{} entries held out for proportion {} of {}", held_out.size(), proportion, number_of_entries));
+
+        const auto stress = replicates.make_stress(mask, acmacs::number_of_dimensions_t{2});
+        const auto& disconnected = stress.parameters().disconnected;
+        for (size_t point_no = 0; point_no < numeric_titers.size(); ++point_no)
+            check((numeric_titers[point_no] < 3) == disconnected.contains(point_no), fmt::format("point {} having {} numeric titers after masking is {}disconnected", point_no, numeric_titers[point_no], disconnected.contains(point_no) ? "" : "not "));
+
+        size_t expected_entries = 0;
+        for (size_t entry_no = 0; entry_no < number_of_entries; ++entry_no) {
+            if (const auto& entry = entry_of(entry_no); !MaskedReplicates::masked(mask, entry_no) && !disconnected.contains(entry.point_1) && !disconnected.contains(entry.point_2))
+                ++expected_entries;
+        }
+        const auto& table_distances = stress.table_distances();
+        check(stress.number_of_entries() == expected_entries, fmt::format("{} entries in replicate stress, expected {}", stress.number_of_entries(), expected_entries));
+        for (const auto* entries : {&table_distances.regular(), &table_distances.less_than()}) {
+            for (const auto& entry : *entries)
+                check(held_out.find({entry.point_1, entry.point_2}) == held_out.end(), fmt::format("held out entry {}-{} is used in replicate stress", entry.point_1, entry.point_2));
+        }
+    }
+    check(replicates.number_of_entries() == number_of_entries, "master table distances modified by replicates");
+
+    const auto predictions = replicates.run(acmacs::number_of_dimensions_t{2}, 0.1, 17);
+    check(predictions.number_of_samples > 0 && predictions.number_of_samples <= static_cast<size_t>(std::lround(static_cast<double>(number_of_entries) * 0.1)), fmt::format("number of predicted entries: {}", predictions.number_of_samples));
+
+} // test_mask
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,79 @@
+#include <random>
+
+#include "acmacs-base/fmt.hh"
+#include "acmacs-base/range.hh"
+#include "acmacs-chart-2/factory-import.hh"
+#include "acmacs-chart-2/chart.hh"
+#include "acmacs-chart-2/stress.hh"
+#include "acmacs-chart-2/optimize.hh"
+
+// mini-batch adam and block newton polishing must reach the stress of alglib lbfgs from the same starting layout
+// (stored projection with noise added, all methods are expected to end in the same basin)
+
+using namespace acmacs::chart;
+
+constexpr const double relative_stress_tolerance = 1e-3;
+
+static void test_methods(const Chart& chart);
+
+// ----------------------------------------------------------------------
+
+int main(int argc, char* const argv[])
+{
+    int exit_code = 0;
+    try {
+        if (argc < 2)
+            throw std::runtime_error(std::string("usage: ") + argv[0] + " <chart-file> ...");
+
+        for (int file_no = 1; file_no < argc; ++file_no)
+            test_methods(*import_from_file(argv[file_no]));
+    }
+    catch (std::exception& err) {
+        fmt::print(stderr, "ERROR: {}\n", err);
+        exit_code = 2;
+    }
+    return exit_code;
+}
+
+// ----------------------------------------------------------------------
+
+void test_methods(const Chart& chart)
+{
+    const auto projection = chart.projection(0);
+    const auto stress = stress_factory(*projection, multiply_antigen_titer_until_column_adjust::yes);
+    const auto layout = projection->layout();
+    const auto number_of_dimensions = layout->number_of_dimensions();
+
+    std::mt19937 generator{7};
+    std::normal_distribution<double> noise(0.0, 0.3);
+    std::vector<double> start(layout->number_of_points() * static_cast<size_t>(*number_of_dimensions));
+    for (size_t point_no = 0; point_no < layout->number_of_points(); ++point_no) {
+        for (auto dim : acmacs::range(number_of_dimensions)) {
+            const auto value = layout->coordinate(point_no, dim);
+            start[point_no * static_cast<size_t>(*number_of_dimensions) + *dim] = std::isnan(value) ? value : value + noise(generator);
+        }
+    }
+
+    const auto run = [&stress, &start](optimization_method method) {
+        auto arg = start;
+        return optimize(method, stress, arg.data(), arg.data() + arg.size(), optimization_precision::fine);
+    };
+
+    const auto lbfgs = run(optimization_method::alglib_lbfgs_pca);
+    for (const auto method : {optimization_method::sgd_adam_lbfgs_pca, optimization_method::newton_block_pca}) {
+        const auto status = run(method);
+        fmt::print(stderr, "{}: stress {} (lbfgs {}) iterations {} stress calculations {} ({})\n", method, status.final_stress, lbfgs.final_stress, status.number_of_iterations,
+                   status.number_of_stress_calculations, status.termination_report);
+        if (status.final_stress > lbfgs.final_stress * (1.0 + relative_stress_tolerance))
+            throw std::runtime_error(fmt::format("{}: final stress {} is worse than lbfgs stress {}", method, status.final_stress, lbfgs.final_stress));
+        // newton: every sweep evaluates stress and the per point gradients at least once, cg iterations evaluate stress at least once
+        if (method == optimization_method::newton_block_pca && status.number_of_stress_calculations <= status.number_of_iterations)
+            throw std::runtime_error(fmt::format("{}: {} stress calculations reported for {} iterations", method, status.number_of_stress_calculations, status.number_of_iterations));
+    }
+
+} // test_methods
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
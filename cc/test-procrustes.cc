@@ -0,0 +1,240 @@
+#include <random>
+#include <numeric>
+
+#include "acmacs-base/fmt.hh"
+#include "acmacs-base/range.hh"
+#include "acmacs-base/float.hh"
+#include "acmacs-chart-2/factory-import.hh"
+#include "acmacs-chart-2/chart.hh"
+#include "acmacs-chart-2/procrustes.hh"
+
+#pragma GCC diagnostic push
+#ifdef __clang__
+#pragma GCC diagnostic ignored "-Wreserved-id-macro"
+#pragma GCC diagnostic ignored "-Wsuggest-destructor-override"
+#endif
+#define AE_COMPILE_SVD
+#include "alglib-3.13.0/linalg.h"
+#undef AE_COMPILE_SVD
+
+#pragma GCC diagnostic pop
+
+// procrustes with explicitly centered coordinates must give the same transformation, scale and rms as the former implementation
+// multiplying by N x N centering matrix J (J = I - 1/N), within tolerance (summation order differs)
+
+using namespace acmacs::chart;
+
+constexpr const double tolerance = 1e-8;
+
+static void test_procrustes(const Chart& chart);
+static void compare(const ProcrustesData& result, const ProcrustesData& expected, std::string_view name);
+static ProcrustesData procrustes_j_matrix(const Projection& primary, const acmacs::Layout& secondary, const std::vector<CommonAntigensSera::common_t>& common, procrustes_scaling_t scaling);
+static std::shared_ptr<acmacs::Layout> distorted(const acmacs::Layout& source, std::mt19937& generator);
+
+// ----------------------------------------------------------------------
+
+int main(int argc, char* const argv[])
+{
+    int exit_code = 0;
+    try {
+        if (argc < 2)
+            throw std::runtime_error(std::string("usage: ") + argv[0] + " <chart-file> ...");
+
+        for (int file_no = 1; file_no < argc; ++file_no)
+            test_procrustes(*import_from_file(argv[file_no]));
+    }
+    catch (std::exception& err) {
+        fmt::print(stderr, "ERROR: {}\n", err);
+        exit_code = 2;
+    }
+    return exit_code;
+}
+
+// ----------------------------------------------------------------------
+
+void test_procrustes(const Chart& chart)
+{
+    const CommonAntigensSera common_antigens_sera(chart);
+    const auto common = common_antigens_sera.points();
+    auto projections = chart.projections();
+    std::mt19937 generator{11};
+
+    for (size_t primary_no = 0; primary_no < projections->size(); ++primary_no) {
+        const auto primary = (*projections)[primary_no];
+        // other projections of the chart and the primary layout rotated, scaled, moved, with noise and one disconnected point
+        std::vector<std::shared_ptr<acmacs::Layout>> secondaries;
+        for (size_t secondary_no = 0; secondary_no < projections->size(); ++secondary_no) {
+            if (const auto secondary = (*projections)[secondary_no]; secondary->number_of_dimensions() == primary->number_of_dimensions())
+                secondaries.push_back(secondary->layout());
+        }
+        secondaries.push_back(distorted(*primary->layout(), generator));
+
+        for (const auto scaling : {procrustes_scaling_t::no, procrustes_scaling_t::yes}) {
+            const auto batch = procrustes(*primary, secondaries, common, scaling);
+            for (size_t secondary_no = 0; secondary_no < secondaries.size(); ++secondary_no) {
+                const auto expected = procrustes_j_matrix(*primary, *secondaries[secondary_no], common, scaling);
+                const auto name = fmt::format("projection {} secondary {} scaling {}", primary_no, secondary_no, scaling == procrustes_scaling_t::yes);
+                compare(procrustes(*primary, *secondaries[secondary_no], common, scaling), expected, name);
+                compare(batch[secondary_no], expected, fmt::format("{} (batch)", name));
+            }
+        }
+    }
+
+} // test_procrustes
+
+// ----------------------------------------------------------------------
+
+void compare(const ProcrustesData& result, const ProcrustesData& expected, std::string_view name)
+{
+    const auto differ = [](double v1, double v2) { return std::abs(v1 - v2) > tolerance * std::max(1.0, std::abs(v2)); };
+    const auto number_of_dimensions = expected.transformation.number_of_dimensions;
+    bool same = !differ(result.rms, expected.rms) && !differ(result.scale, expected.scale);
+    for (auto row : acmacs::range(number_of_dimensions)) {
+        same &= !differ(result.transformation.translation(row), expected.transformation.translation(row));
+        for (auto col : acmacs::range(number_of_dimensions))
+            same &= !differ(result.transformation(row, col), expected.transformation(row, col));
+    }
+    if (!same) {
+        const auto transformation = [number_of_dimensions](const ProcrustesData& data) {
+            std::string text;
+            for (auto row : acmacs::range(number_of_dimensions)) {
+                for (auto col : acmacs::range(number_of_dimensions))
+                    text += fmt::format(" {}", data.transformation(row, col));
+                text += fmt::format(" [{}]", data.transformation.translation(row));
+            }
+            return text;
+        };
+        throw std::runtime_error(fmt::format("procrustes {}: rms {} scale {} transformation {}, expected rms {} scale {} transformation {}", name, result.rms, result.scale, transformation(result),
+                                             expected.rms, expected.scale, transformation(expected)));
+    }
+
+} // compare
+
+// ----------------------------------------------------------------------
+
+std::shared_ptr<acmacs::Layout> distorted(const acmacs::Layout& source, std::mt19937& generator)
+{
+    std::normal_distribution<double> noise(0.0, 0.05);
+    const auto number_of_dimensions = source.number_of_dimensions();
+    const double angle = 0.5, scale = 1.7, cos_a = std::cos(angle), sin_a = std::sin(angle);
+    auto result = std::make_shared<acmacs::Layout>(source.number_of_points(), number_of_dimensions);
+    for (size_t point_no = 0; point_no < source.number_of_points(); ++point_no) {
+        if (!source[point_no].exists()) {
+            result->set_nan(point_no);
+            continue;
+        }
+        for (auto dim : acmacs::range(number_of_dimensions))
+            result->coordinate(point_no, dim) = source.coordinate(point_no, dim) * scale + 3.0 + noise(generator);
+        // rotation in the plane of the first two dimensions
+        const auto x = result->coordinate(point_no, number_of_dimensions_t{0}), y = result->coordinate(point_no, number_of_dimensions_t{1});
+        result->coordinate(point_no, number_of_dimensions_t{0}) = x * cos_a - y * sin_a;
+        result->coordinate(point_no, number_of_dimensions_t{1}) = x * sin_a + y * cos_a;
+    }
+    result->set_nan(source.number_of_points() / 2);
+    return result;
+
+} // distorted
+
+// ----------------------------------------------------------------------
+
+// former implementation: x^T J y is computed by multiplying by N x N centering matrix
+
+ProcrustesData procrustes_j_matrix(const Projection& primary, const acmacs::Layout& secondary_layout, const std::vector<CommonAntigensSera::common_t>& common, procrustes_scaling_t scaling)
+{
+    auto primary_layout = primary.number_of_dimensions() == number_of_dimensions_t{2} ? primary.transformed_layout() : primary.layout();
+    const auto number_of_dimensions = primary_layout->number_of_dimensions();
+    const auto num_dim = static_cast<size_t>(*number_of_dimensions);
+
+    auto common_without_disconnected = common;
+    common_without_disconnected.erase(std::remove_if(std::begin(common_without_disconnected), std::end(common_without_disconnected),
+                                                     [&primary_layout, &secondary_layout](const auto& en) {
+                                                         return std::isnan(primary_layout->coordinate(en.primary, number_of_dimensions_t{0})) ||
+                                                                std::isnan(secondary_layout.coordinate(en.secondary, number_of_dimensions_t{0}));
+                                                     }),
+                                      std::end(common_without_disconnected));
+    const auto size = common_without_disconnected.size();
+
+    using matrix_t = std::vector<std::vector<double>>;
+    matrix_t x(size, std::vector<double>(num_dim)), y(size, std::vector<double>(num_dim));
+    for (size_t point_no = 0; point_no < size; ++point_no) {
+        for (auto dim : acmacs::range(number_of_dimensions)) {
+            x[point_no][*dim] = primary_layout->coordinate(common_without_disconnected[point_no].primary, dim);
+            y[point_no][*dim] = secondary_layout.coordinate(common_without_disconnected[point_no].secondary, dim);
+        }
+    }
+
+    const auto multiply = [](const matrix_t& left, const matrix_t& right) {
+        matrix_t result(left.size(), std::vector<double>(right.front().size(), 0.0));
+        for (size_t row = 0; row < left.size(); ++row)
+            for (size_t col = 0; col < right.front().size(); ++col)
+                for (size_t index = 0; index < right.size(); ++index)
+                    result[row][col] += left[row][index] * right[index][col];
+        return result;
+    };
+    const auto transpose = [](const matrix_t& source) {
+        matrix_t result(source.front().size(), std::vector<double>(source.size()));
+        for (size_t row = 0; row < source.size(); ++row)
+            for (size_t col = 0; col < source.front().size(); ++col)
+                result[col][row] = source[row][col];
+        return result;
+    };
+    const auto trace = [](const matrix_t& source) { double sum{0.0}; for (size_t index = 0; index < source.size(); ++index) sum += source[index][index]; return sum; };
+
+    matrix_t j(size, std::vector<double>(size, -1.0 / static_cast<double>(size)));
+    for (size_t index = 0; index < size; ++index)
+        j[index][index] += 1.0;
+    if (scaling == procrustes_scaling_t::yes)
+        j = multiply(transpose(j), j);
+
+    const auto jy = multiply(j, y);
+    const auto m2 = multiply(transpose(x), jy); // x^T J y
+    alglib::real_2d_array m, u, vt;
+    m.setlength(static_cast<alglib::ae_int_t>(num_dim), static_cast<alglib::ae_int_t>(num_dim));
+    for (size_t row = 0; row < num_dim; ++row)
+        for (size_t col = 0; col < num_dim; ++col)
+            m(static_cast<alglib::ae_int_t>(row), static_cast<alglib::ae_int_t>(col)) = m2[row][col];
+    alglib::real_1d_array w;
+    w.setlength(m.cols());
+    u.setlength(m.rows(), m.rows());
+    vt.setlength(m.cols(), m.cols());
+    alglib::rmatrixsvd(m, m.rows(), m.cols(), 2, 2, 2, w, u, vt);
+    matrix_t transformation(num_dim, std::vector<double>(num_dim, 0.0)); // vt^T u^T
+    for (size_t row = 0; row < num_dim; ++row)
+        for (size_t col = 0; col < num_dim; ++col)
+            for (size_t index = 0; index < num_dim; ++index)
+                transformation[row][col] += vt(static_cast<alglib::ae_int_t>(index), static_cast<alglib::ae_int_t>(row)) * u(static_cast<alglib::ae_int_t>(col), static_cast<alglib::ae_int_t>(index));
+
+    ProcrustesData result(number_of_dimensions);
+    if (scaling == procrustes_scaling_t::yes) {
+        result.scale = trace(multiply(transpose(x), multiply(j, multiply(y, transformation)))) / trace(multiply(transpose(y), jy));
+        for (auto& row : transformation)
+            for (auto& val : row)
+                val *= result.scale;
+    }
+    for (size_t row = 0; row < num_dim; ++row)
+        for (size_t col = 0; col < num_dim; ++col)
+            result.transformation(number_of_dimensions_t{row}, number_of_dimensions_t{col}) = transformation[row][col];
+
+    const auto yt = multiply(y, transformation);
+    for (auto dim : acmacs::range(number_of_dimensions)) {
+        double sum{0.0};
+        for (size_t point_no = 0; point_no < size; ++point_no)
+            sum += x[point_no][*dim] - yt[point_no][*dim];
+        result.transformation.translation(dim) = sum / static_cast<double>(size);
+    }
+
+    const auto transformed = result.apply(secondary_layout);
+    double sum_squares{0.0};
+    for (const auto& cp : common_without_disconnected) {
+        for (auto dim : acmacs::range(number_of_dimensions))
+            sum_squares += square(primary_layout->coordinate(cp.primary, dim) - transformed->coordinate(cp.secondary, dim));
+    }
+    result.rms = std::sqrt(sum_squares / static_cast<double>(size));
+    return result;
+
+} // procrustes_j_matrix
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,105 @@
+#include <array>
+#include <random>
+#include <numeric>
+#include <algorithm>
+
+#include "acmacs-base/fmt.hh"
+#include "acmacs-chart-2/chart-modify.hh"
+
+// SparseTiters filled titer by titer in random order, with overwrites and removals, must match dense reference table
+
+using namespace acmacs::chart;
+
+static void test_fill(size_t number_of_antigens, size_t number_of_sera, std::mt19937::result_type seed);
+static void check(bool condition, std::string_view message);
+
+// ----------------------------------------------------------------------
+
+int main()
+{
+    int exit_code = 0;
+    try {
+        test_fill(20, 7, 1);
+        test_fill(200, 50, 2);
+        test_fill(5000, 100, 3);
+    }
+    catch (std::exception& err) {
+        fmt::print(stderr, "ERROR: {}\n", err);
+        exit_code = 2;
+    }
+    return exit_code;
+}
+
+// ----------------------------------------------------------------------
+
+void check(bool condition, std::string_view message)
+{
+    if (!condition)
+        throw std::runtime_error(fmt::format("sparse titers: {}", message));
+
+} // check
+
+// ----------------------------------------------------------------------
+
+void test_fill(size_t number_of_antigens, size_t number_of_sera, std::mt19937::result_type seed)
+{
+    const std::array<Titer, 6> titers{Titer{"10"}, Titer{"<10"}, Titer{"40"}, Titer{">1280"}, Titer{"~80"}, Titer{"113"}};
+    std::mt19937 generator{seed};
+    std::uniform_int_distribution<size_t> titer_index(0, titers.size() - 1);
+
+    std::vector<size_t> cells(number_of_antigens * number_of_sera);
+    std::iota(cells.begin(), cells.end(), 0);
+    std::shuffle(cells.begin(), cells.end(), generator);
+
+    SparseTiters sparse(number_of_antigens);
+    std::vector<Titer> reference(cells.size());
+    const auto set = [&](size_t cell, const Titer& titer) {
+        sparse.set(cell / number_of_sera, cell % number_of_sera, titer);
+        reference[cell] = titer;
+    };
+
+    // fill about a third of the table, then overwrite and remove some of the titers
+    for (size_t cell_no = 0; cell_no < cells.size() / 3; ++cell_no) {
+        set(cells[cell_no], titers[titer_index(generator)]);
+        if (cell_no % 997 == 0)
+            check(sparse.titer(cells[cell_no] / number_of_sera, cells[cell_no] % number_of_sera) == reference[cells[cell_no]], "titer read during filling");
+    }
+    std::shuffle(cells.begin(), cells.end(), generator);
+    for (size_t cell_no = 0; cell_no < cells.size() / 5; ++cell_no) {
+        set(cells[cell_no], cell_no % 3 ? titers[titer_index(generator)] : Titer{});
+        if (cell_no % 2)
+            set(cells[cell_no], Titer{});
+    }
+
+    size_t non_dont_cares = 0;
+    std::vector<size_t> titrations_for_serum(number_of_sera, 0);
+    for (size_t antigen_no = 0; antigen_no < number_of_antigens; ++antigen_no) {
+        for (size_t serum_no = 0; serum_no < number_of_sera; ++serum_no) {
+            const auto& expected = reference[antigen_no * number_of_sera + serum_no];
+            check(sparse.titer(antigen_no, serum_no) == expected, fmt::format("titer {}:{}: \"{}\", expected \"{}\"", antigen_no, serum_no, *sparse.titer(antigen_no, serum_no), *expected));
+            if (!expected.is_dont_care()) {
+                ++non_dont_cares;
+                ++titrations_for_serum[serum_no];
+            }
+        }
+        const auto row = sparse.row(antigen_no);
+        check(std::is_sorted(row.begin(), row.end(), [](const auto& e1, const auto& e2) { return e1.first < e2.first; }), fmt::format("row {} is not ordered by serum", antigen_no));
+    }
+    check(sparse.number_of_entries() == non_dont_cares, fmt::format("number of entries: {}, expected {}", sparse.number_of_entries(), non_dont_cares));
+    for (size_t serum_no = 0; serum_no < number_of_sera; ++serum_no) {
+        check(sparse.titrations_for_serum(serum_no) == titrations_for_serum[serum_no], fmt::format("titrations for serum {}", serum_no));
+        sparse.for_each_in_column(serum_no, [&](size_t antigen_no, const Titer& titer) { check(titer == reference[antigen_no * number_of_sera + serum_no], fmt::format("column {} titer for antigen {}", serum_no, antigen_no)); });
+    }
+
+    // copy of titers with staged changes
+    const auto was_dont_care = reference[cells.back()].is_dont_care();
+    set(cells.back(), titers[2]);
+    const SparseTiters copy{sparse};
+    check(copy.number_of_entries() == (non_dont_cares + (was_dont_care ? 1 : 0)) && copy.titer(cells.back() / number_of_sera, cells.back() % number_of_sera) == titers[2], "copy of titers with staged changes");
+
+} // test_fill
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,115 @@
+#include <cmath>
+
+#include "acmacs-base/fmt.hh"
+#include "acmacs-chart-2/factory-import.hh"
+#include "acmacs-chart-2/chart-modify.hh"
+#include "acmacs-chart-2/stress.hh"
+
+// titer caches must be dropped when titers are modified
+
+using namespace acmacs::chart;
+
+static void test_cache(ChartP source);
+static void check(bool condition, std::string_view message);
+
+// ----------------------------------------------------------------------
+
+int main(int argc, char* const argv[])
+{
+    int exit_code = 0;
+    try {
+        if (argc < 2)
+            throw std::runtime_error(std::string("usage: ") + argv[0] + " <chart-file> ...");
+
+        for (int file_no = 1; file_no < argc; ++file_no)
+            test_cache(import_from_file(argv[file_no]));
+    }
+    catch (std::exception& err) {
+        fmt::print(stderr, "ERROR: {}\n", err);
+        exit_code = 2;
+    }
+    return exit_code;
+}
+
+// ----------------------------------------------------------------------
+
+void check(bool condition, std::string_view message)
+{
+    if (!condition)
+        throw std::runtime_error(fmt::format("titers cache: {}", message));
+
+} // check
+
+// ----------------------------------------------------------------------
+
+void test_cache(ChartP source)
+{
+    ChartModify chart{source};
+    auto& titers = chart.titers_modify();
+    titers.remove_layers(); // layered titers cannot be modified
+    const MinimumColumnBasis mcb{};
+
+    size_t ag_no = 0, sr_no = 0;
+    for (; ag_no < titers.number_of_antigens(); ++ag_no) {
+        for (sr_no = 0; sr_no < titers.number_of_sera() && !titers.titer(ag_no, sr_no).is_regular(); ++sr_no)
+            ;
+        if (sr_no < titers.number_of_sera())
+            break;
+    }
+    check(ag_no < titers.number_of_antigens(), "chart has no regular titers");
+
+    const auto encoded = titers.encoded();
+    const auto statistics = titers.statistics();
+    const auto stress = stress_factory(chart, acmacs::number_of_dimensions_t{2}, mcb, multiply_antigen_titer_until_column_adjust::yes);
+    const auto column_bases = chart.computed_column_bases(mcb);
+    const auto table_distances = titers.cached_table_distances(*column_bases, stress.parameters());
+    check(titers.encoded() == encoded, "encoded titers are not cached");
+    check(titers.statistics() == statistics, "titer statistics are not cached");
+    check(titers.cached_table_distances(*column_bases, stress.parameters()) == table_distances, "table distances are not cached");
+    check(&stress.table_distances() == table_distances.get(), "stress does not share cached table distances");
+
+    // modifying stress table distances does not change the cached ones nor table distances of stress copies
+    auto stress_copy = stress;
+    stress_copy.table_distances_modify().regular().clear();
+    check(stress_copy.number_of_entries() == table_distances->less_than().size(), "stress table distances not modified");
+    check(stress.number_of_entries() == (table_distances->regular().size() + table_distances->less_than().size()), "stress table distances modified via its copy");
+    check(titers.cached_table_distances(*column_bases, stress.parameters()) == table_distances && !table_distances->regular().empty(), "cached table distances modified via stress");
+    auto stress_copy_2 = stress_copy;
+    stress_copy.table_distances_modify().less_than().clear();
+    check(stress_copy.number_of_entries() == 0 && stress_copy_2.number_of_entries() == table_distances->less_than().size(), "stress copy shares table distances modified after copying");
+    for (size_t antigen_no = 0; antigen_no < titers.number_of_antigens(); ++antigen_no) {
+        for (size_t serum_no = 0; serum_no < titers.number_of_sera(); ++serum_no)
+            check(encoded->titer(antigen_no, serum_no).titer() == titers.titer(antigen_no, serum_no), fmt::format("encoded titer mismatch for {}:{}", antigen_no, serum_no));
+    }
+
+    // titer removal
+    titers.titer(ag_no, sr_no, Titer{});
+    check(titers.encoded() != encoded && titers.encoded()->titer(ag_no, sr_no).is_dont_care(), "encoded titers not updated after titer removal");
+    check(titers.statistics() != statistics, "titer statistics not updated after titer removal");
+    check(titers.statistics()->number_of_non_dont_cares() == (statistics->number_of_non_dont_cares() - 1), "number of non dont-cares not updated after titer removal");
+    check(titers.statistics()->titrations_for_antigen(ag_no) == (statistics->titrations_for_antigen(ag_no) - 1), "antigen titrations not updated after titer removal");
+    check(titers.statistics()->titrations_for_serum(sr_no) == (statistics->titrations_for_serum(sr_no) - 1), "serum titrations not updated after titer removal");
+    const auto table_distances_removed = titers.cached_table_distances(*column_bases, stress.parameters());
+    check(table_distances_removed != table_distances && table_distances_removed->regular().size() == (table_distances->regular().size() - 1), "table distances not updated after titer removal");
+    check(stress_factory(chart, acmacs::number_of_dimensions_t{2}, mcb, multiply_antigen_titer_until_column_adjust::yes).number_of_entries() == (stress.number_of_entries() - 1),
+          "stress table distances not updated after titer removal");
+
+    // the biggest titer of the serum defines its column basis
+    titers.titer(ag_no, sr_no, Titer{"163840"});
+    check(titers.encoded()->titer(ag_no, sr_no).value() == 163840, "encoded titers not updated after titer change");
+    check(std::abs(chart.computed_column_bases(mcb)->column_basis(sr_no) - 14.0) < 1e-8, "column bases not updated after titer change");
+    // computed column bases are a copy, the cached ones are not modified via it
+    if (auto computed = std::dynamic_pointer_cast<ColumnBasesData>(chart.computed_column_bases(mcb)); computed)
+        computed->set(sr_no, 0.0);
+    check(std::abs(chart.computed_column_bases(mcb)->column_basis(sr_no) - 14.0) < 1e-8, "cached column bases modified via computed_column_bases() result");
+
+    titers.dontcare_for_serum(sr_no);
+    check(titers.statistics()->titrations_for_serum(sr_no) == 0, "titer statistics not updated after dontcare_for_serum");
+    check(titers.encoded()->titer(ag_no, sr_no).is_dont_care(), "encoded titers not updated after dontcare_for_serum");
+
+} // test_cache
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
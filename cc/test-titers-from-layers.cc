@@ -0,0 +1,100 @@
+#include "acmacs-base/fmt.hh"
+#include "acmacs-chart-2/factory-import.hh"
+#include "acmacs-chart-2/chart-modify.hh"
+
+// titers merged from layers are stored dense or sparse depending on the number of merged titers,
+// both must give per cell TitersModify::merge_titers() of the layer titers
+
+using namespace acmacs::chart;
+
+static void test_from_layers(ChartP source, size_t antigen_step, bool expect_dense);
+
+// ----------------------------------------------------------------------
+
+int main(int argc, char* const argv[])
+{
+    int exit_code = 0;
+    try {
+        if (argc < 2)
+            throw std::runtime_error(std::string("usage: ") + argv[0] + " <chart-file> ...");
+
+        for (int file_no = 1; file_no < argc; ++file_no) {
+            auto source = import_from_file(argv[file_no]);
+            test_from_layers(source, 1, true);
+            test_from_layers(source, 4, false);
+        }
+    }
+    catch (std::exception& err) {
+        fmt::print(stderr, "ERROR: {}\n", err);
+        exit_code = 2;
+    }
+    return exit_code;
+}
+
+// ----------------------------------------------------------------------
+
+void test_from_layers(ChartP source, size_t antigen_step, bool expect_dense)
+{
+    auto source_titers = source->titers();
+    const auto number_of_antigens = source_titers->number_of_antigens(), number_of_sera = source_titers->number_of_sera();
+
+    ChartModify chart{source};
+    auto& titers = chart.titers_modify();
+    titers.remove_layers();
+    titers.create_layers(2, number_of_antigens);
+
+    // titers of every antigen_step-th antigen go to the first layer, some of them are repeated in the second layer,
+    // for the dense merge missing titers are filled in
+    std::vector<std::vector<Titer>> layer_titers(number_of_antigens * number_of_sera);
+    for (size_t ag_no = 0; ag_no < number_of_antigens; ag_no += antigen_step) {
+        for (size_t sr_no = 0; sr_no < number_of_sera; ++sr_no) {
+            auto titer = source_titers->titer(ag_no, sr_no);
+            if (titer.is_dont_care() || titer.type() == Titer::Dodgy) {
+                if (!expect_dense)
+                    continue;
+                titer = Titer{"40"};
+            }
+            titers.titer(ag_no, sr_no, 0, titer);
+            layer_titers[ag_no * number_of_sera + sr_no].push_back(titer);
+            if ((ag_no + sr_no) % 3) {
+                titers.titer(ag_no, sr_no, 1, titer);
+                layer_titers[ag_no * number_of_sera + sr_no].push_back(titer);
+            }
+        }
+    }
+
+    std::vector<Titer> expected(layer_titers.size());
+    size_t expected_non_dont_cares = 0;
+    for (size_t cell_no = 0; cell_no < layer_titers.size(); ++cell_no) {
+        if (!layer_titers[cell_no].empty()) {
+            expected[cell_no] = TitersModify::merge_titers(layer_titers[cell_no], TitersModify::more_than_thresholded::to_dont_care, 1.0).first;
+            if (!expected[cell_no].is_dont_care())
+                ++expected_non_dont_cares;
+        }
+    }
+    const auto dense = expected_non_dont_cares >= (number_of_antigens * number_of_sera / 2);
+    const auto representation = dense ? "dense" : "sparse";
+    if (dense != expect_dense)
+        throw std::runtime_error(fmt::format("chart is not suitable for testing {} merge: {} merged titers in {} cells", expect_dense ? "dense" : "sparse", expected_non_dont_cares, layer_titers.size()));
+
+    titers.set_from_layers(chart, TitersModify::make_merge_report::no);
+
+    if (titers.number_of_non_dont_cares() != expected_non_dont_cares)
+        throw std::runtime_error(fmt::format("{} merge: number_of_non_dont_cares mismatch: {} vs. expected {}", representation, titers.number_of_non_dont_cares(), expected_non_dont_cares));
+    const auto encoded = titers.encoded();
+    for (size_t ag_no = 0; ag_no < number_of_antigens; ++ag_no) {
+        for (size_t sr_no = 0; sr_no < number_of_sera; ++sr_no) {
+            const auto& expected_titer = expected[ag_no * number_of_sera + sr_no];
+            if (const auto titer = titers.titer(ag_no, sr_no); titer != expected_titer)
+                throw std::runtime_error(fmt::format("{} merge: titer mismatch for {}:{}: {} vs. expected {}", representation, ag_no, sr_no, *titer, *expected_titer));
+            if (encoded->titer(ag_no, sr_no) != EncodedTiter{expected_titer})
+                throw std::runtime_error(fmt::format("{} merge: encoded titer mismatch for {}:{}, expected {}", representation, ag_no, sr_no, *expected_titer));
+        }
+    }
+
+} // test_from_layers
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
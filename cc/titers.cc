@@ -1,7 +1,11 @@
 #include <algorithm>
 #include <cctype>
+#include <numeric>
+#include <limits>
+#include <iterator>
 
 #include "acmacs-base/log.hh"
+#include "acmacs-base/omp.hh"
 #include "acmacs-base/range.hh"
 #include "acmacs-base/enumerate.hh"
 #include "acmacs-chart-2/titers.hh"
@@ -70,18 +74,7 @@ std::string_view acmacs::chart::Titer::validate(std::string_view titer)
 
 double acmacs::chart::Titer::logged_with_thresholded() const
 {
-    switch (type()) {
-      case Invalid:
-      case Regular:
-      case DontCare:
-      case Dodgy:
-          return logged();
-      case LessThan:
-          return logged() - 1;
-      case MoreThan:
-          return logged() + 1;
-    }
-    throw invalid_titer(*this); // for gcc 7.2
+    return EncodedTiter{*this}.logged_with_thresholded();
 
 } // acmacs::chart::Titer::logged_with_thresholded
 
@@ -109,19 +102,7 @@ std::string acmacs::chart::Titer::logged_as_string() const
 
 double acmacs::chart::Titer::logged_for_column_bases() const
 {
-    switch (type()) {
-      case Invalid:
-          throw invalid_titer(*this);
-      case Regular:
-      case LessThan:
-          return logged();
-      case MoreThan:
-          return logged() + 1;
-      case DontCare:
-      case Dodgy:
-          return -1;
-    }
-    throw invalid_titer(*this); // for gcc 7.2
+    return EncodedTiter{*this}.logged_for_column_bases();
 
 } // acmacs::chart::Titer::logged_for_column_bases
 
@@ -129,20 +110,7 @@ double acmacs::chart::Titer::logged_for_column_bases() const
 
 size_t acmacs::chart::Titer::value_for_sorting() const
 {
-    switch (type()) {
-      case Invalid:
-      case DontCare:
-          return 0;
-      case Regular:
-          return std::stoul(*this);
-      case LessThan:
-          return std::stoul(get().substr(1)) - 1;
-      case MoreThan:
-          return std::stoul(get().substr(1)) + 1;
-      case Dodgy:
-          return std::stoul(get().substr(1));
-    }
-    return 0;
+    return EncodedTiter{*this}.value_for_sorting();
 
 } // acmacs::chart::Titer::value_for_sorting
 
@@ -150,18 +118,7 @@ size_t acmacs::chart::Titer::value_for_sorting() const
 
 size_t acmacs::chart::Titer::value() const
 {
-    switch (type()) {
-      case Invalid:
-      case DontCare:
-          return 0;
-      case Regular:
-          return std::stoul(get());
-      case LessThan:
-      case MoreThan:
-      case Dodgy:
-          return std::stoul(get().substr(1));
-    }
-    return 0;
+    return EncodedTiter{*this}.value();
 
 } // acmacs::chart::Titer::value
 
@@ -169,20 +126,7 @@ size_t acmacs::chart::Titer::value() const
 
 size_t acmacs::chart::Titer::value_with_thresholded() const
 {
-    switch (type()) {
-      case Invalid:
-      case DontCare:
-          return 0;
-      case Regular:
-          return std::stoul(*this);
-      case LessThan:
-          return std::stoul(get().substr(1)) / 2;
-      case MoreThan:
-          return std::stoul(get().substr(1)) * 2;
-      case Dodgy:
-          return std::stoul(get().substr(1));
-    }
-    return 0;
+    return EncodedTiter{*this}.value_with_thresholded();
 
 } // acmacs::chart::Titer::value_with_thresholded
 
@@ -208,41 +152,214 @@ acmacs::chart::Titer acmacs::chart::Titer::multiplied_by(double value) const //
 
 // ----------------------------------------------------------------------
 
-class ComputedColumnBases : public acmacs::chart::ColumnBasesData
+acmacs::chart::Titer acmacs::chart::EncodedTiter::titer() const
 {
- public:
-    ComputedColumnBases(size_t aNumberOfSera, double aMinimumColumnBasis) : ColumnBasesData(aNumberOfSera, aMinimumColumnBasis) {}
+    const auto digits = std::string(leading_zeros(), '0') + std::to_string(value());
+    switch (type()) {
+      case Titer::Regular:
+          return Titer{digits};
+      case Titer::LessThan:
+          return Titer{'<' + digits};
+      case Titer::MoreThan:
+          return Titer{'>' + digits};
+      case Titer::Dodgy:
+          return Titer{'~' + digits};
+      case Titer::DontCare:
+          return Titer{};
+      case Titer::Invalid:
+          break;
+    }
+    throw invalid_titer(std::string_view{"invalid encoded titer"});
 
-    void update(size_t aSerumNo, double aValue)
-        {
-            if (aValue > column_basis(aSerumNo))
-                set(aSerumNo, aValue);
+} // acmacs::chart::EncodedTiter::titer
+
+// ----------------------------------------------------------------------
+
+acmacs::chart::EncodedTiters::EncodedTiters(const Titers& titers)
+    : number_of_antigens_{titers.number_of_antigens()}, number_of_sera_{titers.number_of_sera()}
+{
+    if (titers.is_dense()) {
+        titers_.resize(number_of_antigens_ * number_of_sera_);
+        titers.for_each_titer_row([this](size_t antigen_no, const Titers::titer_row_t& row) {
+            auto* target = titers_.data() + antigen_no * number_of_sera_;
+            for (const auto& [serum_no, titer] : row)
+                target[serum_no] = EncodedTiter{titer};
+        });
+    }
+    else {
+        row_offsets_.assign(number_of_antigens_ + 1, 0);
+        titers_.reserve(titers.number_of_non_dont_cares());
+        sera_.reserve(titers_.capacity());
+        titers.for_each_titer_row([this](size_t antigen_no, const Titers::titer_row_t& row) {
+            for (const auto& [serum_no, titer] : row) {
+                sera_.push_back(static_cast<std::uint32_t>(serum_no));
+                titers_.emplace_back(titer);
+            }
+            row_offsets_[antigen_no + 1] = row.size();
+        });
+        std::partial_sum(row_offsets_.begin(), row_offsets_.end(), row_offsets_.begin());
+    }
+
+} // acmacs::chart::EncodedTiters::EncodedTiters
+
+// ----------------------------------------------------------------------
+
+void acmacs::chart::Titers::for_each_titer_row(const titer_row_visitor_t& func) const
+{
+    std::vector<Titer> storage(number_of_sera()); // row keeps string_views into storage
+    titer_row_t row;
+    for (size_t ag_no = 0; ag_no < number_of_antigens(); ++ag_no) {
+        row.clear();
+        for (size_t sr_no = 0; sr_no < storage.size(); ++sr_no) {
+            if (storage[sr_no] = titer(ag_no, sr_no); !storage[sr_no].is_dont_care())
+                row.emplace_back(sr_no, std::string_view{storage[sr_no]});
         }
+        if (!row.empty())
+            func(ag_no, row);
+    }
 
-}; // class ComputedColumnBases
+} // acmacs::chart::Titers::for_each_titer_row
 
-std::shared_ptr<acmacs::chart::ColumnBasesData> acmacs::chart::Titers::computed_column_bases(acmacs::chart::MinimumColumnBasis aMinimumColumnBasis) const
+// ----------------------------------------------------------------------
+
+std::shared_ptr<const acmacs::chart::EncodedTiters> acmacs::chart::Titers::encoded() const
+{
+    std::lock_guard<std::mutex> lock{encoded_access_};
+    if (!encoded_)
+        encoded_ = std::make_shared<const EncodedTiters>(*this);
+    return encoded_;
+
+} // acmacs::chart::Titers::encoded
+
+// ----------------------------------------------------------------------
+
+std::shared_ptr<const acmacs::chart::TiterStatistics> acmacs::chart::Titers::statistics() const
+{
+    std::lock_guard<std::mutex> lock{statistics_access_};
+    if (!statistics_)
+        statistics_ = std::make_shared<const TiterStatistics>(*encoded());
+    return statistics_;
+
+} // acmacs::chart::Titers::statistics
+
+// ----------------------------------------------------------------------
+
+void acmacs::chart::Titers::invalidate_encoded()
+{
+    {
+        std::lock_guard<std::mutex> lock{table_distances_access_};
+        table_distances_cache_.clear();
+        ++table_distances_generation_;
+    }
+    {
+        std::lock_guard<std::mutex> lock{statistics_access_};
+        statistics_.reset();
+    }
+    std::lock_guard<std::mutex> lock{encoded_access_};
+    encoded_.reset();
+
+} // acmacs::chart::Titers::invalidate_encoded
+
+// ----------------------------------------------------------------------
+
+acmacs::chart::TiterStatistics::TiterStatistics(const EncodedTiters& titers, int threads)
+    : titrations_for_antigen_(titers.number_of_antigens(), 0),
+      titrations_for_serum_(titers.number_of_sera(), 0),
+      numeric_titers_(titers.number_of_antigens() + titers.number_of_sera(), 0),
+      max_logged_for_column_bases_(titers.number_of_sera(), std::numeric_limits<double>::lowest()),
+      min_logged_with_thresholded_(titers.number_of_sera(), std::numeric_limits<double>::max())
+{
+#ifdef _OPENMP
+    // statistics may be requested from within a parallel region (e.g. replicate jobs), do not spawn a nested team then
+    const int num_threads = threads > 0 ? threads : (omp_in_parallel() ? 1 : omp_get_max_threads());
+#endif
+    const auto num_antigens = titers.number_of_antigens(), num_sera = titers.number_of_sera();
+
+    // antigen counts are written by the thread processing the row, per serum data is collected per thread and combined at the end
+#pragma omp parallel default(shared) num_threads(num_threads)
+    {
+        std::vector<size_t> titrations_for_serum(num_sera, 0), numeric_for_serum(num_sera, 0);
+        std::vector<double> max_logged_for_column_bases(num_sera, std::numeric_limits<double>::lowest()), min_logged_with_thresholded(num_sera, std::numeric_limits<double>::max());
+#pragma omp for schedule(dynamic, 64)
+        for (size_t ag_no = 0; ag_no < num_antigens; ++ag_no) {
+            titers.for_each_in_row(ag_no, [&, ag_no](size_t sr_no, EncodedTiter titer) {
+                ++titrations_for_antigen_[ag_no];
+                ++titrations_for_serum[sr_no];
+                if (titer.is_regular()) {
+                    ++numeric_titers_[ag_no];
+                    ++numeric_for_serum[sr_no];
+                }
+                if (const auto logged = titer.logged_for_column_bases(); logged > max_logged_for_column_bases[sr_no])
+                    max_logged_for_column_bases[sr_no] = logged;
+                if (const auto logged = titer.logged_with_thresholded(); logged < min_logged_with_thresholded[sr_no])
+                    min_logged_with_thresholded[sr_no] = logged;
+            });
+        }
+#pragma omp critical
+        for (size_t sr_no = 0; sr_no < num_sera; ++sr_no) {
+            titrations_for_serum_[sr_no] += titrations_for_serum[sr_no];
+            numeric_titers_[num_antigens + sr_no] += numeric_for_serum[sr_no];
+            max_logged_for_column_bases_[sr_no] = std::max(max_logged_for_column_bases_[sr_no], max_logged_for_column_bases[sr_no]);
+            min_logged_with_thresholded_[sr_no] = std::min(min_logged_with_thresholded_[sr_no], min_logged_with_thresholded[sr_no]);
+        }
+    }
+    number_of_non_dont_cares_ = std::accumulate(titrations_for_antigen_.begin(), titrations_for_antigen_.end(), size_t{0});
+
+} // acmacs::chart::TiterStatistics::TiterStatistics
+
+// ----------------------------------------------------------------------
+
+acmacs::chart::PointIndexList acmacs::chart::TiterStatistics::having_too_few_numeric_titers(size_t threshold) const
 {
-    // auto cb1 = std::make_shared<ComputedColumnBases>(number_of_sera, aMinimumColumnBasis);
-    // for (size_t ag_no = 0; ag_no < number_of_antigens; ++ag_no)
-    //     for (size_t sr_no = 0; sr_no < number_of_sera; ++sr_no)
-    //         cb1->update(sr_no, titer(ag_no, sr_no).logged_for_column_bases());
-    // // for (size_t sr_no = 0; sr_no < number_of_sera; ++sr_no)
-    // //     cb->update(sr_no, aMinimumColumnBasis);
+    PointIndexList result;
+    for (auto [point_no, num_numeric_titers] : acmacs::enumerate(numeric_titers_)) {
+        if (num_numeric_titers < threshold)
+            result.insert(point_no);
+    }
+    return result;
 
-    // std::cerr << "DEBUG: computed_column_bases_old: " << *cb1 << '\n';
+} // acmacs::chart::TiterStatistics::having_too_few_numeric_titers
 
-    auto cb = std::make_shared<ComputedColumnBases>(number_of_sera(), aMinimumColumnBasis);
+// ----------------------------------------------------------------------
 
-    for (const auto& titer_ref : titers_existing())
-        cb->update(titer_ref.serum, titer_ref.titer.logged_for_column_bases());
+std::shared_ptr<const acmacs::chart::ColumnBases> acmacs::chart::TiterStatistics::column_bases(MinimumColumnBasis aMinimumColumnBasis) const
+{
+    std::lock_guard<std::mutex> lock{column_bases_access_};
+    if (const auto found = std::find_if(column_bases_.begin(), column_bases_.end(), [&aMinimumColumnBasis](const auto& entry) { return entry.first == aMinimumColumnBasis; }); found != column_bases_.end())
+        return found->second;
+
+    auto cb = std::make_shared<ColumnBasesData>(number_of_sera(), aMinimumColumnBasis);
+    for (size_t sr_no = 0; sr_no < number_of_sera(); ++sr_no) {
+        if (max_logged_for_column_bases_[sr_no] > cb->column_basis(sr_no))
+            cb->set(sr_no, max_logged_for_column_bases_[sr_no]);
+    }
+    return column_bases_.emplace_back(aMinimumColumnBasis, std::move(cb)).second;
 
-    // for (const auto& t : *this)
-    //     if (t.serum == 30)
-    //         std::cerr << "DEBUG: " << t.antigen << ' ' << t.serum << ' ' << t.titer << '\n';
-    // std::cerr << "DEBUG: computed_column_bases_new: " << cb->column_basis(30) << '\n';
+} // acmacs::chart::TiterStatistics::column_bases
 
-    return cb;
+// ----------------------------------------------------------------------
+
+double acmacs::chart::TiterStatistics::max_distance(const ColumnBases& column_bases) const
+{
+    double max_distance = 0;
+    for (size_t sr_no = 0; sr_no < number_of_sera(); ++sr_no) {
+        if (titrations_for_serum_[sr_no] == 0)
+            continue;
+        max_distance = std::max(max_distance, column_bases.column_basis(sr_no) - min_logged_with_thresholded_[sr_no]);
+        if (std::isnan(max_distance) || std::isinf(max_distance))
+            throw std::runtime_error{fmt::format("TiterStatistics::max_distance invalid: {} for serum {} column_bases:{} @@ {}:{}: {}", max_distance, sr_no, column_bases,
+                                                 __builtin_FILE(), __builtin_LINE(), __builtin_FUNCTION())};
+    }
+    return max_distance;
+
+} // acmacs::chart::TiterStatistics::max_distance
+
+// ----------------------------------------------------------------------
+
+std::shared_ptr<acmacs::chart::ColumnBasesData> acmacs::chart::Titers::computed_column_bases(acmacs::chart::MinimumColumnBasis aMinimumColumnBasis) const
+{
+    // copy, cached column bases are shared
+    return std::make_shared<ColumnBasesData>(*statistics()->column_bases(aMinimumColumnBasis));
 
 } // acmacs::chart::Titers::computed_column_bases
 
@@ -255,10 +372,10 @@ void acmacs::chart::Titers::update(acmacs::chart::TableDistances& table_distance
     const auto logged_adjusts = parameters.avidity_adjusts.logged(number_of_points);
     table_distances.dodgy_is_regular(parameters.dodgy_titer_is_regular);
     if (number_of_sera()) {
-        for (const auto& titer_ref : titers_existing()) {
-            if (!parameters.disconnected.contains(titer_ref.antigen) && !parameters.disconnected.contains(titer_ref.serum + num_antigens))
-                table_distances.update(titer_ref.titer, titer_ref.antigen, titer_ref.serum + num_antigens, column_bases.column_basis(titer_ref.serum), logged_adjusts[titer_ref.antigen] + logged_adjusts[titer_ref.serum + num_antigens], parameters.mult);
-        }
+        encoded()->for_each([&](size_t antigen_no, size_t serum_no, EncodedTiter titer) {
+            if (!parameters.disconnected.contains(antigen_no) && !parameters.disconnected.contains(serum_no + num_antigens))
+                table_distances.update(titer, antigen_no, serum_no + num_antigens, column_bases.column_basis(serum_no), logged_adjusts[antigen_no] + logged_adjusts[serum_no + num_antigens], parameters.mult);
+        });
     }
     else {
         throw std::runtime_error(AD_FORMAT("genetic table support not implemented"));
@@ -277,6 +394,102 @@ acmacs::chart::TableDistances acmacs::chart::Titers::table_distances(const Colum
 
 // ----------------------------------------------------------------------
 
+namespace acmacs::chart::titers_internal
+{
+    // everything Titers::update() depends on besides titers, hash is compared first
+    // lookups compare stress parameters with the stored key in place, entry is made only when table distances are computed
+    struct TableDistancesCacheEntry
+    {
+        TableDistancesCacheEntry(size_t a_hash, const ColumnBases& a_column_bases, const StressParameters& parameters, std::shared_ptr<const TableDistances> a_table_distances)
+            : hash{a_hash}, column_bases{a_column_bases.data()}, disconnected(parameters.disconnected.begin(), parameters.disconnected.end()),
+              avidity_adjusts{parameters.avidity_adjusts.empty() ? std::vector<double>{} : std::vector<double>(parameters.avidity_adjusts.begin(), parameters.avidity_adjusts.end())},
+              number_of_points{parameters.number_of_points}, mult{parameters.mult}, dodgy{parameters.dodgy_titer_is_regular}, table_distances{std::move(a_table_distances)}
+        {
+        }
+
+        static size_t key_hash(const ColumnBases& column_bases, const StressParameters& parameters)
+        {
+            size_t hash{0};
+            const auto combine = [&hash](auto value) { hash ^= std::hash<decltype(value)>{}(value) + 0x9e3779b97f4a7c15UL + (hash << 6) + (hash >> 2); };
+            for (size_t serum_no = 0; serum_no < column_bases.size(); ++serum_no)
+                combine(column_bases.column_basis(serum_no));
+            std::for_each(parameters.disconnected.begin(), parameters.disconnected.end(), combine);
+            if (!parameters.avidity_adjusts.empty())
+                std::for_each(parameters.avidity_adjusts.begin(), parameters.avidity_adjusts.end(), combine);
+            combine(parameters.number_of_points);
+            combine(parameters.mult);
+            combine(parameters.dodgy_titer_is_regular);
+            return hash;
+        }
+
+        bool same_key(size_t a_hash, const ColumnBases& a_column_bases, const StressParameters& parameters) const
+        {
+            if (hash != a_hash || number_of_points != parameters.number_of_points || mult != parameters.mult || dodgy != parameters.dodgy_titer_is_regular || column_bases.size() != a_column_bases.size())
+                return false;
+            for (size_t serum_no = 0; serum_no < column_bases.size(); ++serum_no) {
+                if (column_bases[serum_no] != a_column_bases.column_basis(serum_no))
+                    return false;
+            }
+            if (!std::equal(disconnected.begin(), disconnected.end(), parameters.disconnected.begin(), parameters.disconnected.end()))
+                return false;
+            if (parameters.avidity_adjusts.empty())
+                return avidity_adjusts.empty();
+            return std::equal(avidity_adjusts.begin(), avidity_adjusts.end(), parameters.avidity_adjusts.begin(), parameters.avidity_adjusts.end());
+        }
+
+        const size_t hash;
+        const std::vector<double> column_bases;
+        const std::vector<size_t> disconnected;
+        const std::vector<double> avidity_adjusts; // empty if there are no adjusts
+        const size_t number_of_points;
+        const multiply_antigen_titer_until_column_adjust mult;
+        const dodgy_titer_is_regular dodgy;
+        const std::shared_ptr<const TableDistances> table_distances;
+    };
+
+} // namespace acmacs::chart::titers_internal
+
+// ----------------------------------------------------------------------
+
+std::shared_ptr<const acmacs::chart::TableDistances> acmacs::chart::Titers::cached_table_distances(const ColumnBases& column_bases, const StressParameters& parameters) const
+{
+    using entry_t = titers_internal::TableDistancesCacheEntry;
+    const auto hash = entry_t::key_hash(column_bases, parameters);
+    const auto find = [this, hash, &column_bases, &parameters]() -> std::shared_ptr<const TableDistances> {
+        if (auto found = std::find_if(table_distances_cache_.begin(), table_distances_cache_.end(), [&](const auto& cached) { return cached->same_key(hash, column_bases, parameters); });
+            found != table_distances_cache_.end()) {
+            std::rotate(found, std::next(found), table_distances_cache_.end()); // most recently used last
+            return table_distances_cache_.back()->table_distances;
+        }
+        return {};
+    };
+
+    size_t generation;
+    {
+        std::lock_guard<std::mutex> lock{table_distances_access_};
+        if (auto table_distances = find(); table_distances)
+            return table_distances;
+        generation = table_distances_generation_;
+    }
+
+    // computed without holding the lock, other lookups are not blocked
+    auto table_distances = std::make_shared<TableDistances>();
+    update(*table_distances, column_bases, parameters);
+
+    std::lock_guard<std::mutex> lock{table_distances_access_};
+    if (generation != table_distances_generation_) // titers modified during computation, do not cache
+        return table_distances;
+    if (auto cached = find(); cached) // computed concurrently by another thread, share it
+        return cached;
+    if (table_distances_cache_.size() >= table_distances_cache_size_)
+        table_distances_cache_.erase(table_distances_cache_.begin());
+    table_distances_cache_.push_back(std::make_shared<const entry_t>(hash, column_bases, parameters, table_distances));
+    return table_distances;
+
+} // acmacs::chart::Titers::cached_table_distances
+
+// ----------------------------------------------------------------------
+
 bool acmacs::chart::Titers::is_dense() const noexcept
 {
     try {
@@ -299,21 +512,9 @@ bool acmacs::chart::Titers::is_dense() const noexcept
 
 double acmacs::chart::Titers::max_distance(const acmacs::chart::ColumnBases& column_bases)
 {
-
-    double max_distance = 0;
-    if (number_of_sera()) {
-        for (const auto& titer_ref : titers_existing()) {
-            max_distance = std::max(max_distance, column_bases.column_basis(titer_ref.serum) - titer_ref.titer.logged_with_thresholded());
-            if (std::isnan(max_distance) || std::isinf(max_distance))
-                throw std::runtime_error{fmt::format("Titers::max_distance invalid: {} after titer [{}] column_bases:{} @@ {}:{}: {}", max_distance, titer_ref, column_bases, __builtin_FILE(),
-                                                     __builtin_LINE(), __builtin_FUNCTION())};
-        }
-    }
-    else {
+    if (number_of_sera() == 0)
         throw std::runtime_error(AD_FORMAT("genetic table support not implemented"));
-    }
-
-    return max_distance;
+    return statistics()->max_distance(column_bases);
 
 } // acmacs::chart::Titers::max_distance
 
@@ -397,19 +598,7 @@ acmacs::chart::PointIndexList acmacs::chart::Titers::having_titers_with(size_t p
 
 acmacs::chart::PointIndexList acmacs::chart::Titers::having_too_few_numeric_titers(size_t threshold) const
 {
-    std::vector<size_t> number_of_numeric_titers(number_of_antigens() + number_of_sera(), 0);
-    for (const auto& titer_ref : titers_existing()) {
-        if (titer_ref.titer.is_regular()) {
-            ++number_of_numeric_titers[titer_ref.antigen];
-            ++number_of_numeric_titers[titer_ref.serum + number_of_antigens()];
-        }
-    }
-    PointIndexList result;
-    for (auto [point_no, num_numeric_titers] : acmacs::enumerate(number_of_numeric_titers)) {
-        if (num_numeric_titers < threshold)
-            result.insert(point_no);
-    }
-    return result;
+    return statistics()->having_too_few_numeric_titers(threshold);
 
 } // acmacs::chart::Titers::having_too_few_numeric_titers
 
@@ -1,8 +1,13 @@
 #pragma once
 
 #include <memory>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <mutex>
 #include <cmath>
 #include <set>
+#include <cstdint>
 
 #include "acmacs-base/fmt.hh"
 #include "acmacs-base/rjson-forward.hh"
@@ -78,24 +83,169 @@ namespace acmacs::chart
 
       // inline std::ostream& operator<<(std::ostream& s, const Titer& aTiter) { return s << aTiter; }
 
-    inline double Titer::logged() const
+    // ----------------------------------------------------------------------
+
+    // Titer in 32 bits: type in the upper 3 bits, then log-index flag, number of leading zeros (up to 7) and either log-index (titer is 10*2^index) or integer value.
+    // EncodedTiter{titer}.titer() == titer for every titer accepted, titers without digits or with more than 7 leading zeros are rejected.
+    // Numeric accessors do not parse strings, logged() of 10*2^index titers is the index, other titers are logged arithmetically (same result as Titer::logged() before).
+    class EncodedTiter
     {
-        constexpr auto log_titer = [](std::string_view source) -> double { return std::log2(std::stod(std::string{source}) / 10.0); };
-
-        switch (type()) {
-            case Regular:
-                return log_titer(*this);
-            case LessThan:
-            case MoreThan:
-            case Dodgy:
-                return log_titer(get().substr(1));
-            case DontCare:
-            case Invalid:
-                throw invalid_titer(*this);
+      public:
+        using code_t = std::uint32_t;
+
+        EncodedTiter() : code_{make_code(Titer::DontCare, 0)} {}
+        explicit EncodedTiter(const Titer& titer) : code_{encode(std::string_view{titer})} {}
+        explicit EncodedTiter(std::string_view source) : code_{encode(source)} // validated while encoding
+        {
+            if (is_invalid())
+                throw invalid_titer(source);
         }
-        throw invalid_titer(*this); // for gcc 7.2
 
-    }
+        Titer::Type type() const { return static_cast<Titer::Type>(code_ >> type_shift); }
+        bool is_invalid() const { return type() == Titer::Invalid; }
+        bool is_dont_care() const { return type() == Titer::DontCare; }
+        bool is_regular() const { return type() == Titer::Regular; }
+        bool is_less_than() const { return type() == Titer::LessThan; }
+        bool is_more_than() const { return type() == Titer::MoreThan; }
+        bool is_dodgy() const { return type() == Titer::Dodgy; }
+        bool has_value() const { return !is_dont_care() && !is_invalid(); }
+        code_t code() const { return code_; }
+
+        bool operator==(EncodedTiter rhs) const { return code_ == rhs.code_; }
+        bool operator!=(EncodedTiter rhs) const { return code_ != rhs.code_; }
+
+        size_t value() const { return (code_ & log_index_flag) ? (size_t{10} << (code_ & value_mask)) : (code_ & value_mask); }
+        size_t leading_zeros() const { return (code_ >> leading_zeros_shift) & max_leading_zeros; }
+
+        double logged() const
+        {
+            if (!has_value())
+                throw invalid_titer(std::string_view{"dont-care or invalid titer has no logged value"});
+            return (code_ & log_index_flag) ? static_cast<double>(code_ & value_mask) : std::log2(static_cast<double>(code_ & value_mask) / 10.0);
+        }
+
+        double logged_with_thresholded() const
+        {
+            switch (type()) {
+                case Titer::LessThan:
+                    return logged() - 1;
+                case Titer::MoreThan:
+                    return logged() + 1;
+                default:
+                    return logged();
+            }
+        }
+
+        double logged_for_column_bases() const
+        {
+            switch (type()) {
+                case Titer::Regular:
+                case Titer::LessThan:
+                    return logged();
+                case Titer::MoreThan:
+                    return logged() + 1;
+                case Titer::DontCare:
+                case Titer::Dodgy:
+                    return -1;
+                case Titer::Invalid:
+                    break;
+            }
+            throw invalid_titer(std::string_view{"invalid titer has no logged value for column bases"});
+        }
+
+        size_t value_for_sorting() const
+        {
+            switch (type()) {
+                case Titer::Regular:
+                case Titer::Dodgy:
+                    return value();
+                case Titer::LessThan:
+                    return value() - 1;
+                case Titer::MoreThan:
+                    return value() + 1;
+                case Titer::Invalid:
+                case Titer::DontCare:
+                    break;
+            }
+            return 0;
+        }
+
+        size_t value_with_thresholded() const // returns 20 for <40, 20480 for >10240
+        {
+            switch (type()) {
+                case Titer::LessThan:
+                    return value() / 2;
+                case Titer::MoreThan:
+                    return value() * 2;
+                default:
+                    return value();
+            }
+        }
+
+        Titer titer() const;
+
+      private:
+        static constexpr const unsigned type_shift = 29;
+        static constexpr const code_t log_index_flag = code_t{1} << 28;
+        static constexpr const unsigned leading_zeros_shift = 25;
+        static constexpr const code_t max_leading_zeros = 7;
+        static constexpr const code_t value_mask = (code_t{1} << leading_zeros_shift) - 1;
+
+        code_t code_;
+
+        static code_t make_code(Titer::Type type, size_t value)
+        {
+            if (value >= 10 && (value % 10) == 0) {
+                if (const auto multiplier = value / 10; (multiplier & (multiplier - 1)) == 0)
+                    return (static_cast<code_t>(type) << type_shift) | log_index_flag | static_cast<code_t>(__builtin_ctzl(multiplier));
+            }
+            return (static_cast<code_t>(type) << type_shift) | static_cast<code_t>(value);
+        }
+
+        static code_t encode(std::string_view titer)
+        {
+            if (titer.empty())
+                return make_code(Titer::Invalid, 0);
+            switch (titer.front()) {
+                case '*':
+                    return make_code(titer.size() == 1 ? Titer::DontCare : Titer::Invalid, 0);
+                case '<':
+                    return digits(Titer::LessThan, titer.substr(1));
+                case '>':
+                    return digits(Titer::MoreThan, titer.substr(1));
+                case '~':
+                    return digits(Titer::Dodgy, titer.substr(1));
+                case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
+                    return digits(Titer::Regular, titer);
+                default:
+                    return make_code(Titer::Invalid, 0);
+            }
+        }
+
+        // leading zeros are kept to restore the original text
+        static code_t digits(Titer::Type type, std::string_view source)
+        {
+            if (source.empty())
+                throw invalid_titer(std::string_view{"no digits in titer"});
+            size_t zeros{0};
+            while (zeros < (source.size() - 1) && source[zeros] == '0')
+                ++zeros;
+            if (zeros > max_leading_zeros)
+                throw invalid_titer(fmt::format("{}: too many leading zeros", source));
+            size_t value{0};
+            for (const char digit : source.substr(zeros)) {
+                if (digit < '0' || digit > '9')
+                    throw invalid_titer(source);
+                value = value * 10 + static_cast<size_t>(digit - '0');
+                if (value > value_mask)
+                    throw invalid_titer(fmt::format("{}: value is too big", source));
+            }
+            return make_code(type, value) | (static_cast<code_t>(zeros) << leading_zeros_shift);
+        }
+
+    }; // class EncodedTiter
+
+    inline double Titer::logged() const { return EncodedTiter{*this}.logged(); }
 
       // ----------------------------------------------------------------------
 
@@ -164,6 +314,13 @@ namespace acmacs::chart
     class AvidityAdjusts;
     struct StressParameters;
     class ChartModify;
+    class EncodedTiters;
+    class TiterStatistics;
+
+    namespace titers_internal
+    {
+        struct TableDistancesCacheEntry;
+    }
 
     class Titers
     {
@@ -195,10 +352,19 @@ namespace acmacs::chart
         virtual const rjson::value& rjson_list_dict() const { throw data_not_available{"rjson_list_dict titers are not available"}; }
         virtual const rjson::value& rjson_layers() const { throw data_not_available{"rjson_list_dict titers are not available"}; }
 
+        // immutable numeric copy of the table built on the first call and kept until the titers are modified, thread safe
+        std::shared_ptr<const EncodedTiters> encoded() const;
+        // counts and column basis data collected in one pass over encoded(), kept until the titers are modified, thread safe
+        std::shared_ptr<const TiterStatistics> statistics() const;
+
         std::shared_ptr<ColumnBasesData> computed_column_bases(MinimumColumnBasis aMinimumColumnBasis) const;
 
         TableDistances table_distances(const ColumnBases& column_bases, const StressParameters& parameters);
         virtual void update(TableDistances& table_distances, const ColumnBases& column_bases, const StressParameters& parameters) const;
+        // memoized table distances for the column bases, disconnected points, avidity adjusts, mult and dodgy_titer_is_regular of parameters,
+        // a few most recently used are kept until the titers are modified, thread safe
+        // result is shared with the cache and other stresses, Stress copies it before modification (see Stress::table_distances_modify())
+        std::shared_ptr<const TableDistances> cached_table_distances(const ColumnBases& column_bases, const StressParameters& parameters) const;
         virtual double max_distance(const ColumnBases& column_bases);
 
         class TiterGetterExisting : public TiterIterator::TiterGetter
@@ -248,6 +414,23 @@ namespace acmacs::chart
 
         };
 
+        // non-dont-care titers of an antigen ordered by serum: serum_no and titer text, text is valid until the callback returns
+        using titer_row_t = std::vector<std::pair<size_t, std::string_view>>;
+        using titer_row_visitor_t = std::function<void(size_t antigen_no, const titer_row_t& row)>;
+
+        // bulk traversal for the numeric consumers, func is called for each antigen having titers in antigen order,
+        // derived classes walk their storage directly (no per titer virtual call and no Titer copy)
+        virtual void for_each_titer_row(const titer_row_visitor_t& func) const;
+
+        // func(size_t antigen_no, size_t serum_no, EncodedTiter titer) for each non-dont-care titer
+        template <typename F> void for_each_titer(F&& func) const
+        {
+            for_each_titer_row([&func](size_t antigen_no, const titer_row_t& row) {
+                for (const auto& [serum_no, titer] : row)
+                    func(antigen_no, serum_no, EncodedTiter{titer});
+            });
+        }
+
         virtual TiterIteratorMaker titers_existing() const { return TiterIteratorMaker(std::make_shared<TiterGetterExisting>([this](size_t ag, size_t sr) { return this->titer(ag, sr); }, number_of_antigens(), number_of_sera())); }
         virtual TiterIteratorMaker titers_regular() const { return TiterIteratorMaker(std::make_shared<TiterGetterRegular>([this](size_t ag, size_t sr) { return this->titer(ag, sr); }, number_of_antigens(), number_of_sera())); }
         virtual TiterIteratorMaker titers_existing_from_layer(size_t layer_no) const { return TiterIteratorMaker(std::make_shared<TiterGetterExisting>([this,layer_no](size_t ag, size_t sr) { return this->titer_of_layer(layer_no, ag, sr); }, number_of_antigens(), number_of_sera())); }
@@ -256,14 +439,114 @@ namespace acmacs::chart
         std::pair<PointIndexList, PointIndexList> antigens_sera_in_multiple_layers() const;
         bool has_morethan_in_layers() const;
 
-        PointIndexList having_titers_with(size_t point_no, bool return_point_no = true) const;
+        virtual PointIndexList having_titers_with(size_t point_no, bool return_point_no = true) const;
           // returns list of points having less than threshold numeric titers
         PointIndexList having_too_few_numeric_titers(size_t threshold = 3) const;
 
         std::string print() const;
 
+      protected:
+        void invalidate_encoded();
+
+      private:
+        mutable std::mutex encoded_access_;
+        mutable std::shared_ptr<const EncodedTiters> encoded_;
+        mutable std::mutex statistics_access_;
+        mutable std::shared_ptr<const TiterStatistics> statistics_;
+        static constexpr size_t table_distances_cache_size_ = 8;
+        mutable std::mutex table_distances_access_;
+        mutable std::vector<std::shared_ptr<const titers_internal::TableDistancesCacheEntry>> table_distances_cache_; // most recently used last
+        size_t table_distances_generation_{0}; // incremented when titers are modified, table distances computed for older titers are not cached
+
     }; // class Titers
 
+    // ----------------------------------------------------------------------
+
+    // Titers without string parsing for the numeric consumers (table distances, column bases, serum circles),
+    // dense table is stored row major, sparse table in CSR form (non-dont-care titers of each antigen ordered by serum).
+    class EncodedTiters
+    {
+      public:
+        explicit EncodedTiters(const Titers& titers);
+
+        size_t number_of_antigens() const { return number_of_antigens_; }
+        size_t number_of_sera() const { return number_of_sera_; }
+        bool is_dense() const { return row_offsets_.empty(); }
+
+        EncodedTiter titer(size_t antigen_no, size_t serum_no) const
+        {
+            if (is_dense())
+                return titers_[antigen_no * number_of_sera_ + serum_no];
+            const auto first = sera_.begin() + static_cast<std::ptrdiff_t>(row_offsets_[antigen_no]), last = sera_.begin() + static_cast<std::ptrdiff_t>(row_offsets_[antigen_no + 1]);
+            if (const auto found = std::lower_bound(first, last, serum_no); found != last && *found == serum_no)
+                return titers_[static_cast<size_t>(found - sera_.begin())];
+            return {};
+        }
+
+        // func(size_t antigen_no, size_t serum_no, EncodedTiter titer) is called for non-dont-care titers in antigen then serum order
+        template <typename F> void for_each(F&& func) const
+        {
+            for (size_t ag_no = 0; ag_no < number_of_antigens_; ++ag_no)
+                for_each_in_row(ag_no, [&func, ag_no](size_t sr_no, EncodedTiter titer) { func(ag_no, sr_no, titer); });
+        }
+
+        // func(size_t serum_no, EncodedTiter titer) is called for non-dont-care titers of the antigen in serum order
+        template <typename F> void for_each_in_row(size_t antigen_no, F&& func) const
+        {
+            if (is_dense()) {
+                for (size_t sr_no = 0, index = antigen_no * number_of_sera_; sr_no < number_of_sera_; ++sr_no, ++index) {
+                    if (!titers_[index].is_dont_care())
+                        func(sr_no, titers_[index]);
+                }
+            }
+            else {
+                for (auto index = row_offsets_[antigen_no]; index < row_offsets_[antigen_no + 1]; ++index)
+                    func(static_cast<size_t>(sera_[index]), titers_[index]);
+            }
+        }
+
+      private:
+        const size_t number_of_antigens_;
+        const size_t number_of_sera_;
+        std::vector<EncodedTiter> titers_;
+        std::vector<size_t> row_offsets_;  // sparse only: titers of antigen ag_no are in [row_offsets_[ag_no], row_offsets_[ag_no + 1])
+        std::vector<std::uint32_t> sera_; // sparse only: serum of each entry in titers_
+
+    }; // class EncodedTiters
+
+    // ----------------------------------------------------------------------
+
+    // Titer counts and per serum data for column bases and max distance collected in one pass (parallel over antigens) over the encoded table.
+    // Computed column bases are cached per minimum column basis.
+    class TiterStatistics
+    {
+      public:
+        explicit TiterStatistics(const EncodedTiters& titers, int threads = 0);
+
+        size_t number_of_antigens() const { return titrations_for_antigen_.size(); }
+        size_t number_of_sera() const { return titrations_for_serum_.size(); }
+        size_t number_of_non_dont_cares() const { return number_of_non_dont_cares_; }
+        double percent_of_non_dont_cares() const { return static_cast<double>(number_of_non_dont_cares_) / static_cast<double>(number_of_antigens() * number_of_sera()); }
+        size_t titrations_for_antigen(size_t antigen_no) const { return titrations_for_antigen_[antigen_no]; }
+        size_t titrations_for_serum(size_t serum_no) const { return titrations_for_serum_[serum_no]; }
+        size_t number_of_numeric_titers(size_t point_no) const { return numeric_titers_[point_no]; } // point_no: antigens then sera
+
+        PointIndexList having_too_few_numeric_titers(size_t threshold) const;
+        std::shared_ptr<const ColumnBases> column_bases(MinimumColumnBasis aMinimumColumnBasis) const; // cached, shared by all users of the statistics
+        double max_distance(const ColumnBases& column_bases) const;
+
+      private:
+        size_t number_of_non_dont_cares_{0};
+        std::vector<size_t> titrations_for_antigen_;
+        std::vector<size_t> titrations_for_serum_;
+        std::vector<size_t> numeric_titers_;
+        std::vector<double> max_logged_for_column_bases_; // per serum
+        std::vector<double> min_logged_with_thresholded_; // per serum
+        mutable std::mutex column_bases_access_;
+        mutable std::vector<std::pair<MinimumColumnBasis, std::shared_ptr<const ColumnBases>>> column_bases_;
+
+    }; // class TiterStatistics
+
     bool equal(const Titers& t1, const Titers& t2, bool verbose = false);
 
 } // namespace acmacs::chart